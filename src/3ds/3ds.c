@@ -7,9 +7,19 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <fcntl.h> /* for open */
+#include <unistd.h> /* for close */
+#include <sys/mman.h> /* for mmap and munmap */
+#include <sys/stat.h> /* for fstat */
 #include "3ds.h"
 
+#if defined(__SSE2__) && !defined(A3DS_NO_SIMD)
+#include <emmintrin.h>
+#define A3DS_SSE 1
+#endif
+
 #define A3DS_OUT "3ds: "
+#define A3DS_NORMAL_BATCH 4096 /* faces or vertices per normal job */
 
 #define MAIN3DS                         0x4D4D
 #define EDIT3DS                         0x3D3D
@@ -19,255 +29,484 @@
 #define	EDIT3DS_OBJECT_TRIMESH_FACEL    0x4120
 #define	EDIT3DS_OBJECT_TRIMESH_MATRIX   0x4160
 
+/* the file is mapped and walked in place, chunks are little endian and packed */
 typedef struct A3DSchk_s {
 	unsigned short id;
-	unsigned int size;
+	unsigned int size; /* including the 6 byte header */
 } A3DSchk;
 
-static int a3dsReadShort(FILE* f, unsigned short* us) {
-	return fread(us, 2, 1, f) == 1;
-}
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define A3DS_LITTLE_ENDIAN 1
+#endif
 
-static int a3dsReadInt(FILE* f, unsigned int* l) {
-	return fread(l, 4, 1, f) == 1;
+static unsigned short a3dsGetShort(const unsigned char* p) {
+	return (unsigned short) (p[0] | p[1] << 8);
 }
 
-static int a3dsReadFloat(FILE* f, float* fl) {
-	return fread(fl, 4, 1, f) == 1;
+static unsigned int a3dsGetInt(const unsigned char* p) {
+	return (unsigned int) p[0] | (unsigned int) p[1] << 8 | (unsigned int) p[2] << 16 | (unsigned int) p[3] << 24;
 }
 
-static int a3dsReadChar(FILE* f, char* c) {
-	return fread(c, 1, 1, f) == 1;
+/* reads the header at p, the chunk must lie within end */
+static int a3dsGetChunk(const unsigned char* p, const unsigned char* end, A3DSchk* chunk) {
+	if (end - p < 6) {
+		return 0;
+	}
+	chunk->id = a3dsGetShort(p);
+	chunk->size = a3dsGetInt(p + 2);
+	return chunk->size >= 6 && chunk->size <= (size_t) (end - p);
 }
 
-static int a3dsReadString(FILE* f, char* str, size_t maxlen) {
-	char ch;
-	int i = 0;
-	do {
-		if (!a3dsReadChar(f, &ch)) {
-			return 0;
-		}
-		if (i < maxlen) {
-			str[i++] = ch;
+/* vertex list: a count and three floats per vertex */
+static int a3dsGetVertices(A3DS* a3ds, int object, const unsigned char* p, const unsigned char* end) {
+	unsigned short len;
+
+	if (end - p < 2) {
+		return 0;
+	}
+	len = a3dsGetShort(p);
+	p += 2;
+	if ((size_t) (end - p) < (size_t) len * 12) {
+		return 0;
+	}
+	printf(A3DS_OUT " vertices: %d\n", (int) len);
+
+	free(a3ds->vertices[object]);
+	a3ds->vertices[object] = malloc(sizeof(float) * 3 * (len ? len : 1));
+	if (a3ds->vertices[object] == NULL) {
+		fprintf(stderr, A3DS_OUT "Unable to allocate memory");
+		return 0;
+	}
+#if A3DS_LITTLE_ENDIAN
+	memcpy(a3ds->vertices[object], p, (size_t) len * 12);
+#else
+	{
+		unsigned int i, bits;
+		for (i = 0; i < len * 3u; i++) {
+			bits = a3dsGetInt(p + i * 4);
+			memcpy(&a3ds->vertices[object][i], &bits, sizeof(float));
 		}
-	} while (ch != '\0');
-#ifndef NDEBUG
-	printf(A3DS_OUT " Reading string: '%s' (len: %d)\n", str, i - 1);
+	}
 #endif
+	a3ds->num_vertices[object] = len;
 	return 1;
 }
 
-static int a3dsReadChunk(FILE* f, A3DSchk* chunk) {
-	if (!a3dsReadShort(f, &chunk->id)) {
+/* face list: a count and three indices plus flags per face, sub chunks like materials follow and are skipped */
+static int a3dsGetFaces(A3DS* a3ds, int object, const unsigned char* p, const unsigned char* end) {
+	unsigned short* indices;
+	unsigned int i;
+	unsigned short len;
+
+	if (end - p < 2) {
 		return 0;
 	}
-	if (!a3dsReadInt(f, &chunk->size)) {
+	len = a3dsGetShort(p);
+	p += 2;
+	if ((size_t) (end - p) < (size_t) len * 8) {
 		return 0;
 	}
-#ifndef NDEBUG
-	printf(A3DS_OUT " Reading chunk: 0x%x size: %d\n", chunk->id, chunk->size);
+	printf(A3DS_OUT " faces: %d\n", (int) len);
+
+	free(a3ds->indices[object]);
+	a3ds->indices[object] = indices = malloc(sizeof(unsigned short) * 3 * (len ? len : 1));
+	if (indices == NULL) {
+		fprintf(stderr, A3DS_OUT "Unable to allocate memory");
+		return 0;
+	}
+	for (i = 0; i < len; i++, p += 8) {
+#if A3DS_LITTLE_ENDIAN
+		memcpy(&indices[i * 3], p, 6); /* drops the flags */
+#else
+		indices[i * 3 + 0] = a3dsGetShort(p + 0);
+		indices[i * 3 + 1] = a3dsGetShort(p + 2);
+		indices[i * 3 + 2] = a3dsGetShort(p + 4);
 #endif
+	}
+	a3ds->num_indices[object] = len * 3;
 	return 1;
 }
 
-static int a3dsSkipChunk(FILE* f, unsigned int skip) {
-#ifndef NDEBUG
-	printf(A3DS_OUT " Skipping chunk ...\n");
+/* the face normals are computed in batches of faces, then every vertex gathers the normals of its faces */
+typedef struct A3DSnormaljob_s {
+	A3DS* a3ds;
+	unsigned int object;
+	A3DSnormals weighting;
+	float* faces; /* 4 floats per face, the weighted normal and padding */
+	float* weights; /* per corner, the face's angle at the vertex, NULL unless angle weighted */
+	unsigned int* offsets; /* the corners of vertex v are corners[offsets[v]] to corners[offsets[v + 1] - 1] */
+	unsigned int* corners; /* index positions in face order */
+} A3DSnormaljob;
+
+typedef struct A3DSloadjob_s {
+	A3DS* a3ds;
+	const char* filename;
+	A3DSnormals weighting;
+	LGLjobsystem* jobs;
+	int failed;
+} A3DSloadjob;
+
+/* runs proc(data, 0) to proc(data, count - 1) on jobs, or on this thread without a job system */
+static void a3dsRun(LGLjobsystem* jobs, LGLjobproc proc, void* data, unsigned int count) {
+	LGLjobgroup group = { 0 };
+	unsigned int i;
+
+	if (jobs == NULL) {
+		for (i = 0; i < count; i++) {
+			proc(data, i);
+		}
+		return;
+	}
+	lglRunJobs(jobs, &group, proc, data, count);
+	lglWaitJobs(jobs, &group);
+}
+
+/* angle between u and v, atan2 stays accurate for angles near 0 and pi where acos does not */
+static float a3dsAngle(float ux, float uy, float uz, float vx, float vy, float vz) {
+	const float cx = uy * vz - uz * vy;
+	const float cy = uz * vx - ux * vz;
+	const float cz = ux * vy - uy * vx;
+	return atan2(sqrt(cx * cx + cy * cy + cz * cz), ux * vx + uy * vy + uz * vz);
+}
+
+static void a3dsFaceNormalsJob(void* data, LGLuint batch) {
+	const A3DSnormaljob* job = data;
+	const float* v = job->a3ds->vertices[job->object];
+	const unsigned short* indices = job->a3ds->indices[job->object];
+	const unsigned int num_faces = job->a3ds->num_indices[job->object] / 3;
+	const unsigned int last = batch * A3DS_NORMAL_BATCH + A3DS_NORMAL_BATCH < num_faces ?
+			batch * A3DS_NORMAL_BATCH + A3DS_NORMAL_BATCH : num_faces;
+	const int normalize = job->weighting != A3DS_NORMALS_AREA;
+	unsigned int j = batch * A3DS_NORMAL_BATCH;
+
+#if A3DS_SSE
+	/* four faces per iteration, the lanes hold one face each */
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; j + 4 <= last; j += 4) {
+		const unsigned short* t = &indices[j * 3];
+		const __m128 ax = _mm_setr_ps(v[t[0] * 3 + 0], v[t[3] * 3 + 0], v[t[6] * 3 + 0], v[t[9] * 3 + 0]);
+		const __m128 ay = _mm_setr_ps(v[t[0] * 3 + 1], v[t[3] * 3 + 1], v[t[6] * 3 + 1], v[t[9] * 3 + 1]);
+		const __m128 az = _mm_setr_ps(v[t[0] * 3 + 2], v[t[3] * 3 + 2], v[t[6] * 3 + 2], v[t[9] * 3 + 2]);
+		const __m128 e1x = _mm_sub_ps(_mm_setr_ps(v[t[1] * 3 + 0], v[t[4] * 3 + 0], v[t[7] * 3 + 0], v[t[10] * 3 + 0]), ax);
+		const __m128 e1y = _mm_sub_ps(_mm_setr_ps(v[t[1] * 3 + 1], v[t[4] * 3 + 1], v[t[7] * 3 + 1], v[t[10] * 3 + 1]), ay);
+		const __m128 e1z = _mm_sub_ps(_mm_setr_ps(v[t[1] * 3 + 2], v[t[4] * 3 + 2], v[t[7] * 3 + 2], v[t[10] * 3 + 2]), az);
+		const __m128 e2x = _mm_sub_ps(_mm_setr_ps(v[t[2] * 3 + 0], v[t[5] * 3 + 0], v[t[8] * 3 + 0], v[t[11] * 3 + 0]), ax);
+		const __m128 e2y = _mm_sub_ps(_mm_setr_ps(v[t[2] * 3 + 1], v[t[5] * 3 + 1], v[t[8] * 3 + 1], v[t[11] * 3 + 1]), ay);
+		const __m128 e2z = _mm_sub_ps(_mm_setr_ps(v[t[2] * 3 + 2], v[t[5] * 3 + 2], v[t[8] * 3 + 2], v[t[11] * 3 + 2]), az);
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+		__m128 w = zero;
+
+		if (normalize) {
+			/* 1 / sqrt in double like the scalar path, zero for degenerate faces */
+			const __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+			__m128 f = _mm_movelh_ps(_mm_cvtpd_ps(_mm_div_pd(one, _mm_sqrt_pd(_mm_cvtps_pd(p)))),
+					_mm_cvtpd_ps(_mm_div_pd(one, _mm_sqrt_pd(_mm_cvtps_pd(_mm_movehl_ps(p, p))))));
+			f = _mm_and_ps(f, _mm_cmpgt_ps(p, zero));
+			nx = _mm_mul_ps(nx, f);
+			ny = _mm_mul_ps(ny, f);
+			nz = _mm_mul_ps(nz, f);
+		}
+		_MM_TRANSPOSE4_PS(nx, ny, nz, w);
+		_mm_storeu_ps(&job->faces[j * 4 + 0], nx);
+		_mm_storeu_ps(&job->faces[j * 4 + 4], ny);
+		_mm_storeu_ps(&job->faces[j * 4 + 8], nz);
+		_mm_storeu_ps(&job->faces[j * 4 + 12], w);
+	}
 #endif
-	return fseek(f, skip - (sizeof(unsigned short) + sizeof(unsigned int)), SEEK_CUR);
+	for (; j < last; j++) {
+		const float* a = &v[indices[j * 3 + 0] * 3];
+		const float* b = &v[indices[j * 3 + 1] * 3];
+		const float* c = &v[indices[j * 3 + 2] * 3];
+		const float e1x = b[0] - a[0], e1y = b[1] - a[1], e1z = b[2] - a[2];
+		const float e2x = c[0] - a[0], e2y = c[1] - a[1], e2z = c[2] - a[2];
+		float nx = e1y * e2z - e1z * e2y;
+		float ny = e1z * e2x - e1x * e2z;
+		float nz = e1x * e2y - e1y * e2x;
+
+		if (normalize) {
+			const float p = nx * nx + ny * ny + nz * nz;
+			const float ilen = p > 0.0f ? 1.0f / sqrt(p) : 0.0f;
+			nx *= ilen;
+			ny *= ilen;
+			nz *= ilen;
+		}
+		job->faces[j * 4 + 0] = nx;
+		job->faces[j * 4 + 1] = ny;
+		job->faces[j * 4 + 2] = nz;
+		job->faces[j * 4 + 3] = 0.0f;
+	}
+
+	if (job->weights != NULL) {
+		for (j = batch * A3DS_NORMAL_BATCH; j < last; j++) {
+			const float* a = &v[indices[j * 3 + 0] * 3];
+			const float* b = &v[indices[j * 3 + 1] * 3];
+			const float* c = &v[indices[j * 3 + 2] * 3];
+			job->weights[j * 3 + 0] = a3dsAngle(b[0] - a[0], b[1] - a[1], b[2] - a[2], c[0] - a[0], c[1] - a[1], c[2] - a[2]);
+			job->weights[j * 3 + 1] = a3dsAngle(c[0] - b[0], c[1] - b[1], c[2] - b[2], a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+			job->weights[j * 3 + 2] = a3dsAngle(a[0] - c[0], a[1] - c[1], a[2] - c[2], b[0] - c[0], b[1] - c[1], b[2] - c[2]);
+		}
+	}
 }
 
-static void a3dsCalcNormals(A3DS *a3ds, unsigned int i) {
+/* sums in face order, the same order a serial accumulation would use, so the result is independent of the batches */
+static void a3dsVertexNormalsJob(void* data, LGLuint batch) {
+	const A3DSnormaljob* job = data;
+	const unsigned int num_vertices = job->a3ds->num_vertices[job->object];
+	const unsigned int last = batch * A3DS_NORMAL_BATCH + A3DS_NORMAL_BATCH < num_vertices ?
+			batch * A3DS_NORMAL_BATCH + A3DS_NORMAL_BATCH : num_vertices;
+	float* normals = job->a3ds->normals[job->object];
+	unsigned int j, k;
+
+	for (j = batch * A3DS_NORMAL_BATCH; j < last; j++) {
+		float nx = normals[j * 3 + 0], ny = normals[j * 3 + 1], nz = normals[j * 3 + 2], p, ilen;
+
+		for (k = job->offsets != NULL ? job->offsets[j] : 0; job->offsets != NULL && k < job->offsets[j + 1]; k++) {
+			const unsigned int corner = job->corners[k];
+			const float* n = &job->faces[corner / 3 * 4];
+			if (job->weights != NULL) {
+				nx += n[0] * job->weights[corner];
+				ny += n[1] * job->weights[corner];
+				nz += n[2] * job->weights[corner];
+			} else {
+				nx += n[0];
+				ny += n[1];
+				nz += n[2];
+			}
+		}
+
+		/* flipped, the files wind their faces clockwise */
+		p = nx * nx + ny * ny + nz * nz;
+		ilen = p > 0.0f ? 1.0f / sqrt(p) : 0.0f;
+		normals[j * 3 + 0] = nx * -ilen;
+		normals[j * 3 + 1] = ny * -ilen;
+		normals[j * 3 + 2] = nz * -ilen;
+	}
+}
+
+/* with a single thread the faces add their normals to their vertices directly, sorting the corners would cost more */
+static void a3dsScatterNormals(const A3DSnormaljob* job) {
+	const unsigned short* indices = job->a3ds->indices[job->object];
+	const unsigned int num_indices = job->a3ds->num_indices[job->object];
+	float* normals = job->a3ds->normals[job->object];
+	unsigned int j, k;
+
+	for (j = 0; j < num_indices; j += 3) {
+		const float* n = &job->faces[j / 3 * 4];
+		for (k = 0; k < 3; k++) {
+			float* d = &normals[indices[j + k] * 3];
+			if (job->weights != NULL) {
+				d[0] += n[0] * job->weights[j + k];
+				d[1] += n[1] * job->weights[j + k];
+				d[2] += n[2] * job->weights[j + k];
+			} else {
+				d[0] += n[0];
+				d[1] += n[1];
+				d[2] += n[2];
+			}
+		}
+	}
+}
+
+static int a3dsCalcNormals(A3DS *a3ds, unsigned int i, A3DSnormals weighting, LGLjobsystem* jobs) {
+	const unsigned int num_vertices = a3ds->num_vertices[i];
+	const unsigned int num_indices = a3ds->num_indices[i];
+	const int gather = jobs != NULL && lglGetJobWorkers(jobs) > 1;
+	A3DSnormaljob job;
 	unsigned int j;
-	unsigned int a, b, c;
-	float ax, ay, az;
-	float bx, by, bz;
-	float cx, cy, cz;
-	float e1x, e1y, e1z;
-	float e2x, e2y, e2z;
-	float nx, ny, nz;
-	float ilen;
+	int ok;
+
+	job.a3ds = a3ds;
+	job.object = i;
+	job.weighting = weighting;
+	job.faces = malloc(sizeof(float) * 4 * (num_indices / 3 + 1));
+	job.weights = weighting == A3DS_NORMALS_ANGLE ? malloc(sizeof(float) * (num_indices + 1)) : NULL;
+	job.offsets = gather ? calloc(num_vertices + 1, sizeof(unsigned int)) : NULL;
+	job.corners = gather ? malloc(sizeof(unsigned int) * (num_indices + 1)) : NULL;
+	a3ds->normals[i] = calloc(num_vertices + 1, sizeof(float) * 3);
+
+	ok = job.faces != NULL && a3ds->normals[i] != NULL && (job.weights != NULL || weighting != A3DS_NORMALS_ANGLE)
+			&& (!gather || (job.offsets != NULL && job.corners != NULL));
+	if (ok) {
+		a3dsRun(jobs, a3dsFaceNormalsJob, &job, (num_indices / 3 + A3DS_NORMAL_BATCH - 1) / A3DS_NORMAL_BATCH);
+		if (gather) {
+			/* counting sort of the corners by vertex, stable so every vertex lists its faces in order */
+			for (j = 0; j < num_indices; j++) {
+				job.offsets[a3ds->indices[i][j] + 1]++;
+			}
+			for (j = 0; j < num_vertices; j++) {
+				job.offsets[j + 1] += job.offsets[j];
+			}
+			for (j = 0; j < num_indices; j++) {
+				job.corners[job.offsets[a3ds->indices[i][j]]++] = j;
+			}
+			for (j = num_vertices; j > 0; j--) {
+				job.offsets[j] = job.offsets[j - 1];
+			}
+			job.offsets[0] = 0;
+		} else {
+			a3dsScatterNormals(&job);
+		}
+		a3dsRun(jobs, a3dsVertexNormalsJob, &job, (num_vertices + A3DS_NORMAL_BATCH - 1) / A3DS_NORMAL_BATCH);
+	}
+
+	free(job.faces);
+	free(job.weights);
+	free(job.offsets);
+	free(job.corners);
+	return ok;
+}
 
-	a3ds->normals[i] = malloc(a3ds->num_vertices[i] * 3 * sizeof(float));
+static void a3dsCalcBounds(A3DS *a3ds, unsigned int i) {
+	unsigned int j, k;
+	float d, r2 = 0.0f;
+	const float* v;
 
+	for (k = 0; k < 3; k++) {
+		a3ds->bbox_min[i][k] = a3ds->num_vertices[i] ? a3ds->vertices[i][k] : 0.0f;
+		a3ds->bbox_max[i][k] = a3ds->bbox_min[i][k];
+	}
 	for (j = 0; j < a3ds->num_vertices[i]; j++) {
-		a3ds->normals[i][j * 3 + 0] = 0.0f;
-		a3ds->normals[i][j * 3 + 1] = 0.0f;
-		a3ds->normals[i][j * 3 + 2] = 0.0f;
+		v = &a3ds->vertices[i][j * 3];
+		for (k = 0; k < 3; k++) {
+			if (v[k] < a3ds->bbox_min[i][k])
+				a3ds->bbox_min[i][k] = v[k];
+			if (v[k] > a3ds->bbox_max[i][k])
+				a3ds->bbox_max[i][k] = v[k];
+		}
 	}
 
-	for (j = 0; j < a3ds->num_indices[i]; j += 3) {
-		a = a3ds->indices[i][j + 0];
-		b = a3ds->indices[i][j + 1];
-		c = a3ds->indices[i][j + 2];
-
-		/* get triangle vertices */
-		ax = a3ds->vertices[i][a * 3 + 0];
-		ay = a3ds->vertices[i][a * 3 + 1];
-		az = a3ds->vertices[i][a * 3 + 2];
-		bx = a3ds->vertices[i][b * 3 + 0];
-		by = a3ds->vertices[i][b * 3 + 1];
-		bz = a3ds->vertices[i][b * 3 + 2];
-		cx = a3ds->vertices[i][c * 3 + 0];
-		cy = a3ds->vertices[i][c * 3 + 1];
-		cz = a3ds->vertices[i][c * 3 + 2];
-
-		/* edge 1 */
-		e1x = bx - ax;
-		e1y = by - ay;
-		e1z = bz - az;
-
-		/* edge 2 */
-		e2x = cx - ax;
-		e2y = cy - ay;
-		e2z = cz - az;
-
-		/* calculate face normal */
-		nx = e1y * e2z - e1z * e2y;
-		ny = e1z * e2x - e1x * e2z;
-		nz = e1x * e2y - e1y * e2x;
-
-		ilen = 1.0f / sqrt(nx * nx + ny * ny + nz * nz);
-		nx *= ilen;
-		ny *= ilen;
-		nz *= ilen;
-
-		/* accumulate normals */
-		a3ds->normals[i][a * 3 + 0] += nx;
-		a3ds->normals[i][a * 3 + 1] += ny;
-		a3ds->normals[i][a * 3 + 2] += nz;
-		a3ds->normals[i][b * 3 + 0] += nx;
-		a3ds->normals[i][b * 3 + 1] += ny;
-		a3ds->normals[i][b * 3 + 2] += nz;
-		a3ds->normals[i][c * 3 + 0] += nx;
-		a3ds->normals[i][c * 3 + 1] += ny;
-		a3ds->normals[i][c * 3 + 2] += nz;
+	/* centered on the box, the radius reaches the furthest vertex */
+	for (k = 0; k < 3; k++) {
+		a3ds->sphere[i][k] = (a3ds->bbox_min[i][k] + a3ds->bbox_max[i][k]) * 0.5f;
 	}
-
-	/* normalize */
 	for (j = 0; j < a3ds->num_vertices[i]; j++) {
-		nx = a3ds->normals[i][j * 3 + 0];
-		ny = a3ds->normals[i][j * 3 + 1];
-		nz = a3ds->normals[i][j * 3 + 2];
+		v = &a3ds->vertices[i][j * 3];
+		d = (v[0] - a3ds->sphere[i][0]) * (v[0] - a3ds->sphere[i][0])
+				+ (v[1] - a3ds->sphere[i][1]) * (v[1] - a3ds->sphere[i][1])
+				+ (v[2] - a3ds->sphere[i][2]) * (v[2] - a3ds->sphere[i][2]);
+		if (d > r2)
+			r2 = d;
+	}
+	a3ds->sphere[i][3] = sqrt(r2);
+}
 
-		ilen = 1.0f / sqrt(nx * nx + ny * ny + nz * nz);
+/* objects missing a list or indexing past their vertices are dropped as empty */
+static void a3dsObjectJob(void* data, LGLuint i) {
+	A3DSloadjob* load = data;
+	A3DS* a3ds = load->a3ds;
+	unsigned int j;
 
-		a3ds->normals[i][j * 3 + 0] *= -ilen;
-		a3ds->normals[i][j * 3 + 1] *= -ilen;
-		a3ds->normals[i][j * 3 + 2] *= -ilen;
+	for (j = 0; j < a3ds->num_indices[i] && a3ds->indices[i][j] < a3ds->num_vertices[i]; j++)
+		;
+	if (a3ds->vertices[i] == NULL || a3ds->indices[i] == NULL || j < a3ds->num_indices[i]) {
+		fprintf(stderr, A3DS_OUT "Invalid object %u in: '%s'\n", i, load->filename);
+		a3ds->num_indices[i] = 0;
 	}
+	if (!a3dsCalcNormals(a3ds, i, load->weighting, load->jobs)) {
+		__atomic_store_n(&load->failed, 1, __ATOMIC_RELAXED);
+	}
+	a3dsCalcBounds(a3ds, i);
 }
 
-A3DS* a3dsLoad(const char* filename) {
+A3DS* a3dsLoad(const char* filename, A3DSnormals weighting, LGLjobsystem* jobs) {
 	A3DS* a3ds;
-	FILE* file;
+	A3DSloadjob load;
 	A3DSchk chunk;
-	char str[256];
-	int done = 0;
+	struct stat info;
+	const unsigned char *data, *p, *end;
+	int fd, done = 0;
 	int object_index = -1;
-	unsigned short us, len;
-
-	int i, j;
-	float v;
 
-	file = fopen(filename, "rb");
-	if (file == NULL) {
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
 		fprintf(stderr, A3DS_OUT "Unable to load 3DS file: '%s'\n", filename);
 		return NULL;
 	}
-
-	a3ds = malloc(sizeof(A3DS));
-	if (a3ds == NULL) {
-		fclose(file);
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		fprintf(stderr, A3DS_OUT "Unable to read 3DS file: '%s'\n", filename);
+		close(fd);
 		return NULL;
 	}
-
-	memset(a3ds, 0, sizeof(A3DS));
-
-	printf(A3DS_OUT "Loading %s ...\n", filename);
-
-	if (!a3dsReadChunk(file, &chunk)) {
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); /* the mapping stays valid */
+	if (data == MAP_FAILED) {
 		fprintf(stderr, A3DS_OUT "Unable to read 3DS file: '%s'\n", filename);
-		free(a3ds);
-		fclose(file);
 		return NULL;
 	}
-	if (chunk.id != MAIN3DS) {
+	end = data + info.st_size;
+
+	if (!a3dsGetChunk(data, end, &chunk) || chunk.id != MAIN3DS) {
 		fprintf(stderr, A3DS_OUT "Invalid 3DS file: '%s'\n", filename);
-		free(a3ds);
-		fclose(file);
+		munmap((void*) data, info.st_size);
+		return NULL;
+	}
+	end = data + chunk.size;
+
+	a3ds = calloc(1, sizeof(A3DS));
+	if (a3ds == NULL) {
+		munmap((void*) data, info.st_size);
 		return NULL;
 	}
 
-	while (a3dsReadChunk(file, &chunk) && !done) {
+	printf(A3DS_OUT "Loading %s ...\n", filename);
+
+	/* containers are entered by stepping over their header only, other chunks are skipped whole */
+	for (p = data + 6; !done && a3dsGetChunk(p, end, &chunk); ) {
 		switch (chunk.id) {
 		case EDIT3DS:
-			break;
-		case EDIT3DS_OBJECT:
-			a3dsReadString(file, str, sizeof(str));
-			break;
 		case EDIT3DS_OBJECT_TRIMESH:
-			object_index++;
-			if (object_index == A3DS_MAX_OBJECTS) { /* max objects reached -> we are done */
+			if (chunk.id == EDIT3DS_OBJECT_TRIMESH && ++object_index == A3DS_MAX_OBJECTS) {
+				object_index--; /* max objects reached -> we are done */
 				done = 1;
+				break;
+			}
+			p += 6;
+			break;
+		case EDIT3DS_OBJECT:
+			/* the name, the object's chunks follow it */
+			for (p += 6; p < end && *p != '\0'; p++)
+				;
+			if (p < end) {
+				p++;
 			}
 			break;
 		case EDIT3DS_OBJECT_TRIMESH_VERTEXL:
-			a3dsReadShort(file, &len);
-			printf(A3DS_OUT " vertices: %d\n", (int) len);
-			a3ds->vertices[object_index] = malloc(sizeof(float) * 3 * len);
-			if (a3ds->vertices[object_index] == NULL) {
-				fprintf(stderr, A3DS_OUT "Unable to allocate memory");
+			if (object_index < 0 || !a3dsGetVertices(a3ds, object_index, p + 6, p + chunk.size)) {
 				done = 1;
 			}
-			for (i = 0, j = 0; i < len; i++) {
-				a3dsReadFloat(file, &v);
-				a3ds->vertices[object_index][j++] = v;
-				a3dsReadFloat(file, &v);
-				a3ds->vertices[object_index][j++] = v;
-				a3dsReadFloat(file, &v);
-				a3ds->vertices[object_index][j++] = v;
-			}
-			a3ds->num_vertices[object_index] = len;
+			p += chunk.size;
 			break;
 		case EDIT3DS_OBJECT_TRIMESH_FACEL:
-			a3dsReadShort(file, &len);
-			printf(A3DS_OUT " faces: %d\n", (int) len);
-			a3ds->indices[object_index] = malloc(sizeof(unsigned int) * 3 * len);
-			if (a3ds->indices[object_index] == NULL) {
-				fprintf(stderr, A3DS_OUT "Unable to allocate memory");
-				done = 1;
-			}
-			for (i = 0, j = 0; i < len; i++) {
-				a3dsReadShort(file, &us);
-				a3ds->indices[object_index][j++] = us;
-				a3dsReadShort(file, &us);
-				a3ds->indices[object_index][j++] = us;
-				a3dsReadShort(file, &us);
-				a3ds->indices[object_index][j++] = us;
-				a3dsReadShort(file, &us);
-			}
-			a3ds->num_indices[object_index] = len * 3;
-			/* bytes read = face data size + size of chunk (6 bytes) + number of faces field (2 bytes) */
-			if (((len * 2 * 4) + (4 + 2) + 2) != chunk.size) {
-				fprintf(stderr, A3DS_OUT "Extra Face attributes not supported: '%s'\n", filename);
+			if (object_index < 0 || !a3dsGetFaces(a3ds, object_index, p + 6, p + chunk.size)) {
 				done = 1;
 			}
+			p += chunk.size;
 			break;
 		default:
-			if (a3dsSkipChunk(file, chunk.size)) {
-				done = 1;
-			}
+			p += chunk.size;
 		}
 	}
+	munmap((void*) data, info.st_size);
 
 	a3ds->num_objects = object_index + 1;
 
-	for (i = 0; i < a3ds->num_objects; i++) {
-		a3dsCalcNormals(a3ds, i);
+	/* the objects are finished in parallel, each splits its normals into jobs again */
+	load.a3ds = a3ds;
+	load.filename = filename;
+	load.weighting = weighting;
+	load.jobs = jobs;
+	load.failed = 0;
+	a3dsRun(jobs, a3dsObjectJob, &load, a3ds->num_objects);
+	if (load.failed) {
+		fprintf(stderr, A3DS_OUT "Unable to allocate memory\n");
+		a3dsUnload(a3ds);
+		return NULL;
 	}
 
-	fclose(file);
 	return a3ds;
 }
 
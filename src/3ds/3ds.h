@@ -5,19 +5,32 @@
 #ifndef A3DS_H_INCLUDED
 #define A3DS_H_INCLUDED
 
+#include "../LGL/lgljob.h"
+
 #define A3DS_MAX_OBJECTS 16
 
+/* how the normals of the faces around a vertex are weighted */
+typedef enum A3DSnormals_e {
+	A3DS_NORMALS_FACE,  /* every face counts the same */
+	A3DS_NORMALS_AREA,  /* by face area, slivers barely count */
+	A3DS_NORMALS_ANGLE  /* by the face's angle at the vertex, independent of how a surface is split */
+} A3DSnormals;
+
 typedef struct A3DS_s {
-	unsigned int  num_objects;
-	float*        vertices[A3DS_MAX_OBJECTS];
-	float*        normals[A3DS_MAX_OBJECTS];
-	float*        texcoords[A3DS_MAX_OBJECTS];
-	unsigned int* indices[A3DS_MAX_OBJECTS];
-	unsigned int  num_vertices[A3DS_MAX_OBJECTS];
-	unsigned int  num_indices[A3DS_MAX_OBJECTS];
+	unsigned int    num_objects;
+	float*          vertices[A3DS_MAX_OBJECTS];
+	float*          normals[A3DS_MAX_OBJECTS];
+	float*          texcoords[A3DS_MAX_OBJECTS];
+	unsigned short* indices[A3DS_MAX_OBJECTS];
+	unsigned int    num_vertices[A3DS_MAX_OBJECTS];
+	unsigned int    num_indices[A3DS_MAX_OBJECTS];
+	float           bbox_min[A3DS_MAX_OBJECTS][3];
+	float           bbox_max[A3DS_MAX_OBJECTS][3];
+	float           sphere[A3DS_MAX_OBJECTS][4]; /* center and radius, contains all vertices */
 }A3DS;
 
-A3DS* a3dsLoad(const char* file);
+/* objects and their normals are processed on jobs, NULL runs everything on the calling thread */
+A3DS* a3dsLoad(const char* file, A3DSnormals normals, LGLjobsystem* jobs);
 void  a3dsUnload(A3DS* rawdata);
 
 #endif
@@ -9,73 +9,514 @@
 #include <stdlib.h> /* for malloc and free */
 #include <string.h> /* for memset and memcpy */
 #include <assert.h>
+#include <pthread.h>
 #include "lgl.h"
+#include "lgljob.h"
+
+#if defined(__SSE2__) && !defined(LGL_NO_SIMD)
+#include <emmintrin.h>
+#define ILGL_SSE 1
+#endif
+
+/*
+ * Binding blocks hold the state shaders read through LGLvsin and LGLfsin.
+ * Draws only reference them, every modification bumps the block version.
+ * Recorded commands keep a reference to the blocks they were recorded with,
+ * a setter copies a block that is still referenced before modifying it.
+ */
+
+typedef struct ILGLblock_s {
+	LGLuint refs; /* the context plus every pending command */
+	LGLuint version;
+} ILGLblock;
+
+typedef struct LGLtextureblock_s {
+	ILGLblock block;
+	LGLtexture textures[LGL_MAX_TEXTURES];
+} LGLtextureblock;
+
+typedef struct LGLuniformblock_s {
+	ILGLblock block;
+	LGLuniform uniforms[LGL_MAX_UNIFORMS];
+} LGLuniformblock;
+
+typedef struct LGLattributeblock_s {
+	ILGLblock block;
+	LGLattribute attributes[LGL_MAX_ATTRIBUTES];
+	LGLsize num_attributes[LGL_MAX_ATTRIBUTES];
+	LGLuint divisors[LGL_MAX_ATTRIBUTES];
+} LGLattributeblock;
+
+/* samples counted by the commands recorded between lglBeginQuery and lglEndQuery */
+struct LGLquery_s {
+	LGLuint samples;
+	LGLfence fence; /* signaled once samples is final */
+};
+
+typedef struct ILGLcommand_s ILGLcommand;
+
+/* clears and draws of the last frame rendered incrementally into a buffer, see ilglExecuteFrame */
+typedef struct ILGLhistory_s {
+	struct ILGLdrawkey_s* keys;
+	struct ILGLrect_s* bounds;
+	LGLsize num_items;
+	LGLint valid;
+} ILGLhistory;
+
+/* commands handed to the render thread by one flush */
+typedef struct ILGLbatch_s {
+	ILGLcommand* commands;
+	LGLsize num_commands;
+	LGLfence fence;
+	ILGLhistory* history; /* of the buffer the commands render into */
+	LGLint incremental;
+	struct ILGLbatch_s* next;
+} ILGLbatch;
 
 typedef struct LGLcontext_s {
-	LGLFramebufferinfo fbinfo;
+	LGLFramebufferinfo buffers[LGL_MAX_BUFFERS];
+	LGLfence buffer_fences[LGL_MAX_BUFFERS];
+	LGLuint num_buffers;
+	LGLuint back_buffer, pending_buffer, front_buffer;
+	LGLint owns_buffers;
+
+	/* incremental frames, the history is only accessed by the render thread */
+	ILGLhistory history[LGL_MAX_BUFFERS];
+	LGLuint invalid_buffers; /* one bit per buffer to render in full next time */
+	LGLint frame_split; /* commands of the current frame were flushed before lglSwapBuffers */
 
 	LGLint vport_x, vport_y;
 	LGLsize vport_width, vport_height;
 
+	LGLint scissor_x, scissor_y;
+	LGLsize scissor_width, scissor_height;
+
+	LGLint has_bounds;
+	LGLm4x4f bounds_transform;
+	LGLv3f bounds_min, bounds_max;
+
+	LGLstate state;
+
 	LGLvertexshader vertex_shader;
 	LGLfragmentshader fragment_shader;
+	LGLvaryinglayout varying_layout;
 
 	LGLv3f* vertex_stream;
 	LGLsize vertex_stream_elements;
-	LGLuint* index_stream;
+	LGLdata index_stream;
+	LGLindextype index_type;
 	LGLsize index_stream_elements;
 
-	LGLtexture textures[LGL_MAX_TEXTURES];
-	LGLuniform uniforms[LGL_MAX_UNIFORMS];
-	LGLattribute attributes[LGL_MAX_ATTRIBUTES];
-	LGLsize num_attributes[LGL_MAX_ATTRIBUTES];
+	LGLtextureblock* texture_block;
+	LGLuniformblock* uniform_block;
+	LGLattributeblock* attribute_block;
+
+	LGLjobsystem* jobs;
+
+	LGLquery* query;
+	LGLquery* condition;
+
+	/* commands recorded since the last flush */
+	ILGLcommand* commands;
+	LGLsize num_commands, max_commands;
+
+	/* render thread, buffered contexts only */
+	LGLint threaded;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t submitted_cond, completed_cond;
+	ILGLbatch* queue_head;
+	ILGLbatch* queue_tail;
+	LGLfence submitted, completed;
+	LGLint quit;
 } LGLcontext_t;
 
+static void ilglExecuteBatch(ILGLbatch* batch);
+static void ilglExecuteCommands(ILGLcommand* commands, LGLsize count);
+static void ilglFreeHistory(ILGLhistory* history);
+
+/*
+ *  Binding block functions
+ */
+
+static void ilglAcquireBlock(ILGLblock* block) {
+	__atomic_add_fetch(&block->refs, 1, __ATOMIC_RELAXED);
+}
+
+/* the release orders every read of the block by a command before the context's next write */
+static void ilglReleaseBlock(ILGLblock* block) {
+	if (__atomic_sub_fetch(&block->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(block);
+	}
+}
+
+/* returns the block in *current ready for modification, copying it first if a pending command references it */
+static ILGLblock* ilglWriteBlock(LGLcontext* context, ILGLblock** current, size_t size) {
+	ILGLblock* block = *current;
+	if (__atomic_load_n(&block->refs, __ATOMIC_ACQUIRE) != 1) {
+		ILGLblock* copy = malloc(size);
+		if (copy == NULL) { /* out of memory, wait until no command needs the block anymore */
+			lglFinish(context);
+		} else {
+			memcpy(copy + 1, block + 1, size - sizeof(ILGLblock)); /* refs may change concurrently */
+			copy->refs = 1;
+			copy->version = block->version;
+			ilglReleaseBlock(block);
+			*current = block = copy;
+		}
+	}
+	block->version++;
+	return block;
+}
+
+static LGLtextureblock* ilglWriteTextureBlock(LGLcontext* context) {
+	return (LGLtextureblock*) ilglWriteBlock(context, (ILGLblock**) &context->texture_block, sizeof(LGLtextureblock));
+}
+
+static LGLuniformblock* ilglWriteUniformBlock(LGLcontext* context) {
+	return (LGLuniformblock*) ilglWriteBlock(context, (ILGLblock**) &context->uniform_block, sizeof(LGLuniformblock));
+}
+
+static LGLattributeblock* ilglWriteAttributeBlock(LGLcontext* context) {
+	return (LGLattributeblock*) ilglWriteBlock(context, (ILGLblock**) &context->attribute_block,
+			sizeof(LGLattributeblock));
+}
+
+/*
+ *  Render thread
+ */
+
+/* wrap around safe fence comparison */
+static LGLint ilglFenceReached(LGLfence completed, LGLfence fence) {
+	return (LGLint) (completed - fence) >= 0;
+}
+
+static void* ilglRenderThread(void* arg) {
+	LGLcontext* context = arg;
+	ILGLbatch* batch;
+
+	pthread_mutex_lock(&context->mutex);
+	for (;;) {
+		while (context->queue_head == NULL && !context->quit) {
+			pthread_cond_wait(&context->submitted_cond, &context->mutex);
+		}
+		if (context->queue_head == NULL) {
+			break;
+		}
+		batch = context->queue_head;
+		context->queue_head = batch->next;
+		if (context->queue_head == NULL) {
+			context->queue_tail = NULL;
+		}
+		pthread_mutex_unlock(&context->mutex);
+
+		ilglExecuteBatch(batch);
+		free(batch->commands);
+
+		pthread_mutex_lock(&context->mutex);
+		context->completed = batch->fence;
+		pthread_cond_broadcast(&context->completed_cond);
+		free(batch);
+	}
+	pthread_mutex_unlock(&context->mutex);
+	return NULL;
+}
+
+/* runs the recorded commands on the calling thread, the render thread must be idle */
+static void ilglExecuteRecorded(LGLcontext* context) {
+	context->invalid_buffers |= 1 << context->back_buffer;
+	ilglExecuteCommands(context->commands, context->num_commands);
+	context->num_commands = 0;
+}
+
 /*
  *  Context functions
  */
 
-LGLcontext* lglCreateContext(const LGLFramebufferinfo* fbinfo) {
+static LGLcontext* ilglCreateContext(const LGLFramebufferinfo* fbinfo) {
 	LGLcontext* context;
+	LGLuint i;
 
-	context = malloc(sizeof(LGLcontext));
+	context = calloc(1, sizeof(LGLcontext));
 	if (context == NULL) {
 		return NULL;
 	}
 
+	context->texture_block = calloc(1, sizeof(LGLtextureblock));
+	context->uniform_block = calloc(1, sizeof(LGLuniformblock));
+	context->attribute_block = calloc(1, sizeof(LGLattributeblock));
+	if (context->texture_block == NULL || context->uniform_block == NULL || context->attribute_block == NULL) {
+		free(context->texture_block);
+		free(context->uniform_block);
+		free(context->attribute_block);
+		free(context);
+		return NULL;
+	}
+	context->texture_block->block.refs = 1;
+	context->uniform_block->block.refs = 1;
+	context->attribute_block->block.refs = 1;
+
 	context->vport_x = 0;
 	context->vport_y = 0;
 	context->vport_width = fbinfo->width;
 	context->vport_height = fbinfo->height;
 
-	context->fbinfo = *fbinfo;
+	context->scissor_x = 0;
+	context->scissor_y = 0;
+	context->scissor_width = fbinfo->width;
+	context->scissor_height = fbinfo->height;
+
+	context->buffers[0] = *fbinfo;
+	context->num_buffers = 1;
+
+	context->state = LGL_STATE_DEPTH_TEST | LGL_STATE_DEPTH_WRITE;
 
 	context->vertex_stream = NULL;
 	context->vertex_stream_elements = 0;
 	context->index_stream = NULL;
+	context->index_type = LGL_INDEX_TYPE_UINT;
 	context->index_stream_elements = 0;
 
 	context->fragment_shader = NULL;
 	context->vertex_shader = NULL;
 
-	memset(context->textures, 0, sizeof(context->textures));
-	memset(context->uniforms, 0, sizeof(context->uniforms));
-	memset(context->attributes, 0, sizeof(context->attributes));
-	memset(context->num_attributes, 0, sizeof(context->num_attributes));
+	context->varying_layout.num_varyings = LGL_MAX_VARYINGS;
+	for (i = 0; i < LGL_MAX_VARYINGS; i++) {
+		context->varying_layout.components[i] = 4;
+	}
+
+	return context;
+}
+
+LGLcontext* lglCreateContext(const LGLFramebufferinfo* fbinfo) {
+	assert(fbinfo != NULL);
+	return ilglCreateContext(fbinfo);
+}
+
+LGLcontext* lglCreateBufferedContext(const LGLFramebufferinfo* fbinfo, LGLuint buffers) {
+	LGLcontext* context;
+	LGLuint i;
+
+	assert(fbinfo != NULL);
+	assert(buffers >= 1 && buffers <= LGL_MAX_BUFFERS);
+
+	context = ilglCreateContext(fbinfo);
+	if (context == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&context->mutex, NULL);
+	pthread_cond_init(&context->submitted_cond, NULL);
+	pthread_cond_init(&context->completed_cond, NULL);
+
+	context->owns_buffers = 1;
+	context->num_buffers = buffers;
+	for (i = 0; i < buffers; i++) {
+		context->buffers[i] = *fbinfo;
+		context->buffers[i].framebuffer = calloc(fbinfo->width * fbinfo->height, sizeof(unsigned int));
+		context->buffers[i].zbuffer = malloc(fbinfo->width * fbinfo->height * sizeof(unsigned short));
+		if (context->buffers[i].framebuffer == NULL || context->buffers[i].zbuffer == NULL) {
+			lglDestroyContext(context);
+			return NULL;
+		}
+	}
+	context->pending_buffer = context->front_buffer = buffers - 1;
+
+	if (pthread_create(&context->thread, NULL, ilglRenderThread, context) != 0) {
+		lglDestroyContext(context);
+		return NULL;
+	}
+	context->threaded = 1;
 
 	return context;
 }
 
 LGLFramebufferinfo* lglGetFBInfo(LGLcontext* context) {
 	assert(context != NULL);
-	return &context->fbinfo;
+	return &context->buffers[context->back_buffer];
 }
 
 void lglDestroyContext(LGLcontext* context) {
+	LGLuint i;
 	assert(context != NULL);
+	if (context->threaded) {
+		lglFinish(context);
+		pthread_mutex_lock(&context->mutex);
+		context->quit = 1;
+		pthread_cond_signal(&context->submitted_cond);
+		pthread_mutex_unlock(&context->mutex);
+		pthread_join(context->thread, NULL);
+	}
+	if (context->owns_buffers) {
+		pthread_mutex_destroy(&context->mutex);
+		pthread_cond_destroy(&context->submitted_cond);
+		pthread_cond_destroy(&context->completed_cond);
+		for (i = 0; i < context->num_buffers; i++) {
+			free(context->buffers[i].framebuffer);
+			free(context->buffers[i].zbuffer);
+		}
+	}
+	for (i = 0; i < LGL_MAX_BUFFERS; i++) {
+		ilglFreeHistory(&context->history[i]);
+	}
+	free(context->commands);
+	ilglReleaseBlock(&context->texture_block->block);
+	ilglReleaseBlock(&context->uniform_block->block);
+	ilglReleaseBlock(&context->attribute_block->block);
 	free(context);
 }
 
+/*
+ *  Job system functions
+ */
+
+void lglSetJobSystem(LGLcontext* context, LGLjobsystem* jobs) {
+	assert(context != NULL);
+	lglFinish(context); /* pending commands may still run on the previous job system */
+	context->jobs = jobs;
+}
+
+LGLjobsystem* lglGetJobSystem(LGLcontext* context) {
+	assert(context != NULL);
+	return context->jobs;
+}
+
+/*
+ *  Synchronization functions
+ */
+
+/* end_of_frame is set by lglSwapBuffers, a frame flushed at once may be rendered incrementally */
+static void ilglFlush(LGLcontext* context, LGLint end_of_frame) {
+	const LGLuint buffer_bit = 1 << context->back_buffer;
+	ILGLbatch* batch;
+
+	if (context->num_commands == 0) {
+		if (end_of_frame) {
+			context->frame_split = 0;
+		}
+		return;
+	}
+	if (!context->threaded) {
+		ilglExecuteRecorded(context);
+		return;
+	}
+
+	batch = malloc(sizeof(ILGLbatch));
+	if (batch == NULL) { /* out of memory, wait for the render thread and execute on this thread */
+		lglFinish(context);
+		ilglExecuteRecorded(context);
+		return;
+	}
+	batch->commands = context->commands;
+	batch->num_commands = context->num_commands;
+	batch->history = &context->history[context->back_buffer];
+	batch->incremental = end_of_frame && !context->frame_split && !(context->invalid_buffers & buffer_bit)
+			&& (context->state & LGL_STATE_INCREMENTAL);
+	batch->next = NULL;
+	if (end_of_frame) {
+		context->frame_split = 0;
+		context->invalid_buffers &= ~buffer_bit;
+	} else {
+		context->frame_split = 1;
+	}
+	context->commands = NULL;
+	context->num_commands = 0;
+	context->max_commands = 0;
+
+	pthread_mutex_lock(&context->mutex);
+	batch->fence = ++context->submitted;
+	if (context->queue_tail != NULL) {
+		context->queue_tail->next = batch;
+	} else {
+		context->queue_head = batch;
+	}
+	context->queue_tail = batch;
+	pthread_cond_signal(&context->submitted_cond);
+	pthread_mutex_unlock(&context->mutex);
+}
+
+void lglFlush(LGLcontext* context) {
+	assert(context != NULL);
+	ilglFlush(context, 0);
+}
+
+void lglFinish(LGLcontext* context) {
+	assert(context != NULL);
+	lglWaitFence(context, lglFence(context));
+}
+
+LGLfence lglFence(LGLcontext* context) {
+	assert(context != NULL);
+	lglFlush(context);
+	return context->submitted;
+}
+
+LGLint lglFenceSignaled(LGLcontext* context, LGLfence fence) {
+	LGLint signaled;
+	assert(context != NULL);
+	if (!context->threaded) {
+		return 1;
+	}
+	pthread_mutex_lock(&context->mutex);
+	signaled = ilglFenceReached(context->completed, fence);
+	pthread_mutex_unlock(&context->mutex);
+	return signaled;
+}
+
+void lglWaitFence(LGLcontext* context, LGLfence fence) {
+	assert(context != NULL);
+	if (!context->threaded) {
+		return;
+	}
+	pthread_mutex_lock(&context->mutex);
+	while (!ilglFenceReached(context->completed, fence)) {
+		pthread_cond_wait(&context->completed_cond, &context->mutex);
+	}
+	pthread_mutex_unlock(&context->mutex);
+}
+
+/*
+ *  Buffer functions
+ */
+
+LGLfence lglSwapBuffers(LGLcontext* context) {
+	LGLfence fence;
+	assert(context != NULL);
+
+	ilglFlush(context, 1);
+	fence = context->submitted;
+	context->buffer_fences[context->back_buffer] = fence;
+	context->front_buffer = context->pending_buffer;
+	context->pending_buffer = context->back_buffer;
+	context->back_buffer = (context->back_buffer + 1) % context->num_buffers;
+	return fence;
+}
+
+const LGLFramebufferinfo* lglGetFrontBuffer(LGLcontext* context) {
+	assert(context != NULL);
+	lglWaitFence(context, context->buffer_fences[context->front_buffer]);
+	return &context->buffers[context->front_buffer];
+}
+
+void lglInvalidateBuffers(LGLcontext* context) {
+	assert(context != NULL);
+	context->invalid_buffers = (1 << LGL_MAX_BUFFERS) - 1;
+}
+
+/*
+ *  State functions
+ */
+
+void lglEnable(LGLcontext* context, LGLstate state) {
+	assert(context != NULL);
+	context->state |= state;
+}
+
+void lglDisable(LGLcontext* context, LGLstate state) {
+	assert(context != NULL);
+	context->state &= ~state;
+}
+
 /*
  *  Texture functions
  */
@@ -84,18 +525,20 @@ void lglSetTextureData2d(LGLcontext* context, LGLuint index, LGLtexel* data, LGL
 	assert(context != NULL);
 	assert(index < LGL_MAX_TEXTURES);
 	assert(data != NULL);
-	context->textures[index].t2d.data = data;
-	context->textures[index].t2d.width = width;
-	context->textures[index].t2d.height = height;
+	LGLtexture* texture = &ilglWriteTextureBlock(context)->textures[index];
+	texture->t2d.data = data;
+	texture->t2d.width = width;
+	texture->t2d.height = height;
 }
 
 LGLtexel lglGetTex2d(const LGLcontext* context, LGLuint index, const LGLv2f* v) {
 	assert(context);
 	assert(index < LGL_MAX_TEXTURES);
 	assert(v != NULL);
-	const LGLtexel* data = context->textures[index].t2d.data;
-	const LGLuint width = context->textures[index].t2d.width;
-	const LGLuint height = context->textures[index].t2d.height;
+	const LGLtexture* texture = &context->texture_block->textures[index];
+	const LGLtexel* data = texture->t2d.data;
+	const LGLuint width = texture->t2d.width;
+	const LGLuint height = texture->t2d.height;
 	const LGLfloat x = (v->x - (LGLint) v->x) * width;
 	const LGLfloat y = (v->y - (LGLint) v->y) * height;
 	assert(x < width);
@@ -108,31 +551,31 @@ LGLtexel lglGetTex2d(const LGLcontext* context, LGLuint index, const LGLv2f* v)
 void lglSetUniformf(LGLcontext* context, LGLuint index, LGLfloat v) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_UNIFORMS);
-	context->uniforms[index].f = v;
+	ilglWriteUniformBlock(context)->uniforms[index].f = v;
 }
 
 void lglSetUniformv2f(LGLcontext* context, LGLuint index, const LGLv2f* v) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_UNIFORMS);
-	context->uniforms[index].v2 = *v;
+	ilglWriteUniformBlock(context)->uniforms[index].v2 = *v;
 }
 
 void lglSetUniformv3f(LGLcontext* context, LGLuint index, const LGLv3f* v) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_UNIFORMS);
-	context->uniforms[index].v3 = *v;
+	ilglWriteUniformBlock(context)->uniforms[index].v3 = *v;
 }
 
 void lglSetUniformv4f(LGLcontext* context, LGLuint index, const LGLv4f* v) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_UNIFORMS);
-	context->uniforms[index].v4 = *v;
+	ilglWriteUniformBlock(context)->uniforms[index].v4 = *v;
 }
 
 void lglSetUniformm4x4f(LGLcontext* context, LGLuint index, const LGLm4x4f* v) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_UNIFORMS);
-	context->uniforms[index].m4x4 = *v;
+	ilglWriteUniformBlock(context)->uniforms[index].m4x4 = *v;
 }
 
 /* Vertex/index buffer functions */
@@ -146,6 +589,14 @@ void lglSetVertexStream(LGLcontext* context, LGLv3f vertices[], LGLsize elems) {
 void lglSetIndexStream(LGLcontext* context, LGLuint indices[], LGLsize elems) {
 	assert(context != NULL);
 	context->index_stream = indices;
+	context->index_type = LGL_INDEX_TYPE_UINT;
+	context->index_stream_elements = elems;
+}
+
+void lglSetIndexStreamus(LGLcontext* context, LGLushort indices[], LGLsize elems) {
+	assert(context != NULL);
+	context->index_stream = indices;
+	context->index_type = LGL_INDEX_TYPE_USHORT;
 	context->index_stream_elements = elems;
 }
 
@@ -154,29 +605,47 @@ void lglSetIndexStream(LGLcontext* context, LGLuint indices[], LGLsize elems) {
 void lglSetVertexAttribsf(LGLcontext* context, LGLuint index, LGLfloat* v, LGLsize elems) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_ATTRIBUTES);
-	context->attributes[index].f = v;
-	context->num_attributes[index] = elems;
+	LGLattributeblock* block = ilglWriteAttributeBlock(context);
+	block->attributes[index].f = v;
+	block->num_attributes[index] = elems;
 }
 
 void lglSetVertexAttribsv2f(LGLcontext* context, LGLuint index, LGLv2f* v, LGLsize elems) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_ATTRIBUTES);
-	context->attributes[index].v2 = v;
-	context->num_attributes[index] = elems;
+	LGLattributeblock* block = ilglWriteAttributeBlock(context);
+	block->attributes[index].v2 = v;
+	block->num_attributes[index] = elems;
 }
 
 void lglSetVertexAttribsv3f(LGLcontext* context, LGLuint index, LGLv3f* v, LGLsize elems) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_ATTRIBUTES);
-	context->attributes[index].v3 = v;
-	context->num_attributes[index] = elems;
+	LGLattributeblock* block = ilglWriteAttributeBlock(context);
+	block->attributes[index].v3 = v;
+	block->num_attributes[index] = elems;
 }
 
 void lglSetVertexAttribsv4f(LGLcontext* context, LGLuint index, LGLv4f* v, LGLsize elems) {
 	assert(context != NULL);
 	assert(index < LGL_MAX_ATTRIBUTES);
-	context->attributes[index].v4 = v;
-	context->num_attributes[index] = elems;
+	LGLattributeblock* block = ilglWriteAttributeBlock(context);
+	block->attributes[index].v4 = v;
+	block->num_attributes[index] = elems;
+}
+
+void lglSetVertexAttribsm4x4f(LGLcontext* context, LGLuint index, LGLm4x4f* v, LGLsize elems) {
+	assert(context != NULL);
+	assert(index < LGL_MAX_ATTRIBUTES);
+	LGLattributeblock* block = ilglWriteAttributeBlock(context);
+	block->attributes[index].m4x4 = v;
+	block->num_attributes[index] = elems;
+}
+
+void lglSetVertexAttribDivisor(LGLcontext* context, LGLuint index, LGLuint divisor) {
+	assert(context != NULL);
+	assert(index < LGL_MAX_ATTRIBUTES);
+	ilglWriteAttributeBlock(context)->divisors[index] = divisor;
 }
 
 /* Shader functions */
@@ -193,34 +662,15 @@ void lglSetFragmentShader(LGLcontext* context, LGLfragmentshader fshader) {
 	context->fragment_shader = fshader;
 }
 
-/*  Drawing functions  */
-
-void lglViewport(const LGLcontext* context, LGLint x, LGLint y, LGLsize width, LGLsize height) {
-	assert(context != NULL);
-
-}
-
-void lglClear(const LGLcontext* context, LGLclear clear/*, LGLpixel pixel*/) {
-	int i;
+void lglSetVaryingLayout(LGLcontext* context, const LGLvaryinglayout* layout) {
+	LGLuint i;
 	assert(context != NULL);
-	if (clear & LGL_CLEAR_FRAMEBUFFER) {
-		// TODO: clear color
-		memset(context->fbinfo.framebuffer, 0, context->fbinfo.width * context->fbinfo.height * sizeof(unsigned int));
-	}
-	if (clear & LGL_CLEAR_ZBUFFER) {
-		// TODO: clear depth
-		memset(context->fbinfo.zbuffer, 0xff, context->fbinfo.width * context->fbinfo.height * sizeof(unsigned short));
+	assert(layout != NULL);
+	assert(layout->num_varyings <= LGL_MAX_VARYINGS);
+	for (i = 0; i < layout->num_varyings; i++) {
+		assert(layout->components[i] >= 1 && layout->components[i] <= 4);
 	}
-}
-
-static void ilglSetPixel(const LGLcontext* context, LGLsize offset, const LGLcolor* color) {
-	unsigned char r, g, b;
-	unsigned int c;
-	r = (unsigned int) (color->r * 255.0f) & 0xff;
-	g = (unsigned int) (color->g * 255.0f) & 0xff;
-	b = (unsigned int) (color->b * 255.0f) & 0xff;
-	c = r << context->fbinfo.rshift | g << context->fbinfo.gshift | b << context->fbinfo.bshift;
-	((unsigned int*) context->fbinfo.framebuffer)[offset] = c;
+	context->varying_layout = *layout;
 }
 
 static LGLint ilglMax2(LGLint a, LGLint b) {
@@ -263,137 +713,1632 @@ static LGLint ilglMin3(LGLint a, LGLint b, LGLint c) {
 	return b;
 }
 
-static void ilglRasterTriangle(const LGLcontext* context, LGLfsin* fsin, LGLint p1x, LGLint p1y, LGLfloat p1z,
-		LGLint p2x, LGLint p2y, LGLfloat p2z, LGLint p3x, LGLint p3y, LGLfloat p3z) {
-	LGLfsout fsout;
-	LGLint x, y;
-
-	assert(context != NULL);
-	assert(fsin != NULL);
+/*
+ *  Draw state
+ */
 
-	LGLint bminx = ilglMin3(p1x, p2x, p3x);
-	LGLint bminy = ilglMin3(p1y, p2y, p3y);
-	LGLint bmaxx = ilglMax3(p1x, p2x, p3x);
-	LGLint bmaxy = ilglMax3(p1y, p2y, p3y);
+/* everything a command needs from the context, captured when the command is recorded */
+typedef struct ILGLdrawstate_s {
+	const LGLFramebufferinfo* fbinfo;
+	LGLint vport_x, vport_y;
+	LGLsize vport_width, vport_height;
+	LGLint scissor_x, scissor_y;
+	LGLsize scissor_width, scissor_height;
+	LGLstate state;
+	LGLvertexshader vertex_shader;
+	LGLfragmentshader fragment_shader;
+	LGLvaryinglayout varying_layout;
+	LGLv3f* vertex_stream;
+	LGLsize vertex_stream_elements;
+	LGLdata index_stream;
+	LGLindextype index_type;
+	LGLsize index_stream_elements;
+	LGLtextureblock* texture_block;
+	LGLuniformblock* uniform_block;
+	LGLattributeblock* attribute_block;
+	LGLjobsystem* jobs;
+	LGLquery* query;
+	LGLquery* condition;
+	const LGLbyte* mask; /* incremental frames only: tiles that may be written, NULL for all */
+	const struct ILGLrect_s* bounds; /* incremental frames only: pixels written per draw or record */
+} ILGLdrawstate;
+
+typedef struct ILGLrect_s {
+	LGLint minx, miny, maxx, maxy; /* inclusive, empty if min > max */
+} ILGLrect;
+
+static void ilglEmptyRect(ILGLrect* rect) {
+	rect->minx = rect->miny = 0;
+	rect->maxx = rect->maxy = -1;
+}
 
-	// clip non visible triangles
-	if (bmaxx < context->vport_x)
-		return;
-	if (bminx >= context->vport_x + (LGLint) context->vport_width)
+static void ilglUnionRect(ILGLrect* rect, const ILGLrect* other) {
+	if (other->minx > other->maxx || other->miny > other->maxy) {
 		return;
-	if (bmaxy < context->vport_y)
-		return;
-	if (bminy >= context->vport_y + (LGLint) context->vport_height)
+	}
+	if (rect->minx > rect->maxx || rect->miny > rect->maxy) {
+		*rect = *other;
 		return;
+	}
+	rect->minx = ilglMin2(rect->minx, other->minx);
+	rect->miny = ilglMin2(rect->miny, other->miny);
+	rect->maxx = ilglMax2(rect->maxx, other->maxx);
+	rect->maxy = ilglMax2(rect->maxy, other->maxy);
+}
+
+static void ilglIntersectRect(ILGLrect* rect, LGLint x, LGLint y, LGLsize width, LGLsize height) {
+	rect->minx = ilglMax2(rect->minx, x);
+	rect->miny = ilglMax2(rect->miny, y);
+	rect->maxx = ilglMin2(rect->maxx, x + (LGLint) width - 1);
+	rect->maxy = ilglMin2(rect->maxy, y + (LGLint) height - 1);
+}
+
+/* framebuffer pixels a clear may write */
+static void ilglScissorRect(const ILGLdrawstate* state, ILGLrect* rect) {
+	rect->minx = 0;
+	rect->miny = 0;
+	rect->maxx = state->fbinfo->width - 1;
+	rect->maxy = state->fbinfo->height - 1;
+	if (state->state & LGL_STATE_SCISSOR_TEST) {
+		ilglIntersectRect(rect, state->scissor_x, state->scissor_y, state->scissor_width, state->scissor_height);
+	}
+}
+
+/* framebuffer pixels a draw may write */
+static void ilglClipRect(const ILGLdrawstate* state, ILGLrect* rect) {
+	ilglScissorRect(state, rect);
+	ilglIntersectRect(rect, state->vport_x, state->vport_y, state->vport_width, state->vport_height);
+}
+
+typedef struct ILGLdraw_s ILGLdraw;
+typedef struct ILGLchunk_s ILGLchunk;
 
-	bmaxx = ilglMin2(context->vport_x + context->vport_width - 1, bmaxx);
-	bmaxy = ilglMin2(context->vport_y + context->vport_height - 1, bmaxy);
-	bminx = ilglMax2(context->vport_x, bminx);
-	bminy = ilglMax2(context->vport_y, bminy);
+typedef LGLuint (*ILGLrasterproc)(const ILGLdraw* draw, LGLfsin* fsin, const ILGLrect* clip, LGLint p1x, LGLint p1y,
+		LGLfloat p1z, LGLint p2x, LGLint p2y, LGLfloat p2z, LGLint p3x, LGLint p3y, LGLfloat p3z);
 
-	const LGLint dx13 = p1x - p3x;
-	const LGLint dy13 = p1y - p3y;
-	const LGLint dx23 = p2x - p3x;
-	const LGLint dy23 = p2y - p3y;
+/* state shared by every triangle of a draw call */
+struct ILGLdraw_s {
+	const ILGLdrawstate* state;
+	LGLvertexshader vertex_shader;
+	LGLfragmentshader fragment_shader;
+	const LGLvaryinglayout* varying_layout;
+	LGLvsin vsin;
+	LGLfsin fsin;
+	ILGLrasterproc raster;
+	LGLsize first_index;
+	LGLsize index_count;
+	LGLuint restart_index;
+	LGLint restart;
+	ILGLrect clip; /* see ilglClipRect */
+	ILGLchunk* chunk; /* set by vertex jobs, triangles are binned instead of rasterized */
+	LGLuint samples; /* passed the depth test, rasterized without binning */
+	ILGLrect* bounds; /* set while measuring a draw, triangles extend it instead of being rasterized */
+};
 
-	const float idett = 1.0f / ((dx13 * dy23 - dx23 * dy13));
+/*
+ *  Raster variants, one per combination of depth test, depth write and framebuffer format
+ */
 
-	// culling
-	if (idett < 0.0) {
-		//return;
+#define ILGL_FORMAT_GENERIC   0 /* any 32 bit layout, channels placed with the fbinfo shifts */
+#define ILGL_FORMAT_XRGB8888  1 /* rshift 16, gshift 8, bshift 0 */
+#define ILGL_FORMAT_NONE      2 /* no shading and no color writes */
+
+#define LGL_RASTER_NAME ilglRasterTriangle_Generic
+#define LGL_RASTER_DEPTH_TEST 0
+#define LGL_RASTER_DEPTH_WRITE 0
+#define LGL_RASTER_FORMAT ILGL_FORMAT_GENERIC
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_Generic_DW
+#define LGL_RASTER_DEPTH_TEST 0
+#define LGL_RASTER_DEPTH_WRITE 1
+#define LGL_RASTER_FORMAT ILGL_FORMAT_GENERIC
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_Generic_DT
+#define LGL_RASTER_DEPTH_TEST 1
+#define LGL_RASTER_DEPTH_WRITE 0
+#define LGL_RASTER_FORMAT ILGL_FORMAT_GENERIC
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_Generic_DT_DW
+#define LGL_RASTER_DEPTH_TEST 1
+#define LGL_RASTER_DEPTH_WRITE 1
+#define LGL_RASTER_FORMAT ILGL_FORMAT_GENERIC
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_XRGB8888
+#define LGL_RASTER_DEPTH_TEST 0
+#define LGL_RASTER_DEPTH_WRITE 0
+#define LGL_RASTER_FORMAT ILGL_FORMAT_XRGB8888
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_XRGB8888_DW
+#define LGL_RASTER_DEPTH_TEST 0
+#define LGL_RASTER_DEPTH_WRITE 1
+#define LGL_RASTER_FORMAT ILGL_FORMAT_XRGB8888
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_XRGB8888_DT
+#define LGL_RASTER_DEPTH_TEST 1
+#define LGL_RASTER_DEPTH_WRITE 0
+#define LGL_RASTER_FORMAT ILGL_FORMAT_XRGB8888
+#include "lglraster.h"
+
+#define LGL_RASTER_NAME ilglRasterTriangle_XRGB8888_DT_DW
+#define LGL_RASTER_DEPTH_TEST 1
+#define LGL_RASTER_DEPTH_WRITE 1
+#define LGL_RASTER_FORMAT ILGL_FORMAT_XRGB8888
+#include "lglraster.h"
+
+/* depth only, for bounding box queries */
+#define LGL_RASTER_NAME ilglRasterTriangle_None_DT
+#define LGL_RASTER_DEPTH_TEST 1
+#define LGL_RASTER_DEPTH_WRITE 0
+#define LGL_RASTER_FORMAT ILGL_FORMAT_NONE
+#include "lglraster.h"
+
+/* indexed by [format][depth test][depth write] */
+static const ILGLrasterproc ilglRasterVariants[2][2][2] = {
+	{
+		{ ilglRasterTriangle_Generic, ilglRasterTriangle_Generic_DW },
+		{ ilglRasterTriangle_Generic_DT, ilglRasterTriangle_Generic_DT_DW }
+	},
+	{
+		{ ilglRasterTriangle_XRGB8888, ilglRasterTriangle_XRGB8888_DW },
+		{ ilglRasterTriangle_XRGB8888_DT, ilglRasterTriangle_XRGB8888_DT_DW }
 	}
+};
+
+static ILGLrasterproc ilglSelectRasterVariant(const ILGLdrawstate* state) {
+	const LGLFramebufferinfo* fbinfo = state->fbinfo;
+	const LGLuint format = (fbinfo->rshift == 16 && fbinfo->gshift == 8 && fbinfo->bshift == 0) ?
+			ILGL_FORMAT_XRGB8888 : ILGL_FORMAT_GENERIC;
+	return ilglRasterVariants[format][(state->state & LGL_STATE_DEPTH_TEST) != 0][(state->state
+			& LGL_STATE_DEPTH_WRITE) != 0];
+}
 
-	for (y = bminy; y <= bmaxy; y++) {
-		const LGLint dy2 = y - p3y;
-		const LGLint dx02_dy2 = dx13 * dy2;
-		const LGLint dx12_dy2 = dx23 * dy2;
+/* copies only the slots and components declared by the varying layout */
+static void ilglCopyVaryings(const LGLvaryinglayout* layout, LGLvarying* d, const LGLvarying* s) {
+	LGLuint i;
+	for (i = 0; i < layout->num_varyings; i++) {
+		switch (layout->components[i]) {
+		case 1:
+			d[i].f = s[i].f;
+			break;
+		case 2:
+			d[i].v2 = s[i].v2;
+			break;
+		case 3:
+			d[i].v3 = s[i].v3;
+			break;
+		default:
+			d[i].v4 = s[i].v4;
+		}
+	}
+}
 
-		for (x = bminx; x <= bmaxx; x++) {
-			const LGLint dx2 = x - p3x;
+typedef struct ILGLvertex_s {
+	LGLvsout out;
+	LGLint x, y;
+} ILGLvertex;
 
-			const float l1 = (dy23 * dx2 - dx12_dy2) * idett;
-			if (l1 > 1.0f || l1 < 0.0f)
-				continue;
+/*
+ *  Binning
+ *
+ *  With a job system, draws shade their vertices in chunks, one vertex job per chunk. Every chunk sorts
+ *  its triangles into one bin per tile. A tile job then rasterizes the bins of all chunks in submission
+ *  order, so every pixel sees its triangles in the same order as without binning.
+ *
+ *  A chunk shades its vertices straight into its vertex array and its triangles refer to them by index, a
+ *  vertex shared by several triangles of the chunk is stored once and never copied.
+ */
 
-			const float l2 = (dx02_dy2 - dy13 * dx2) * idett;
-			if (l2 > 1.0f || l2 < 0.0f)
-				continue;
+#define ILGL_TILE_SIZE      64
+#define ILGL_CHUNK_INDICES  768 /* indices per chunk of a triangle list, a multiple of 3 */
+
+typedef struct ILGLtriangle_s {
+	LGLuint v[3]; /* into the chunk's vertices */
+	ILGLrect tiles; /* tiles overlapped by the clipped bounding box */
+} ILGLtriangle;
+
+struct ILGLchunk_s {
+	const ILGLdraw* draw;
+	LGLdrawtype type;
+	LGLuint instance;
+	LGLsize first_index, index_count;
+	ILGLvertex* vertices; /* shaded by the chunk, at most one per index */
+	LGLsize num_vertices;
+	ILGLtriangle* triangles;
+	LGLsize num_triangles, max_triangles;
+	LGLuint* bin_offsets; /* bin t holds bin_triangles[bin_offsets[t]] to bin_triangles[bin_offsets[t + 1] - 1] */
+	LGLuint* bin_triangles;
+	LGLint failed;
+};
+
+/* bounding box of a triangle clipped to clip, returns 0 if empty */
+static LGLint ilglTriangleRect(const ILGLrect* clip, const ILGLvertex* v1, const ILGLvertex* v2,
+		const ILGLvertex* v3, ILGLrect* rect) {
+	rect->minx = ilglMax2(ilglMin3(v1->x, v2->x, v3->x), clip->minx);
+	rect->miny = ilglMax2(ilglMin3(v1->y, v2->y, v3->y), clip->miny);
+	rect->maxx = ilglMin2(ilglMax3(v1->x, v2->x, v3->x), clip->maxx);
+	rect->maxy = ilglMin2(ilglMax3(v1->y, v2->y, v3->y), clip->maxy);
+	return rect->minx <= rect->maxx && rect->miny <= rect->maxy;
+}
 
-			const float l3 = 1.0f - l1 - l2;
-			if (l3 > 1.0f || l3 < 0.0f)
-				continue;
+static void ilglBinTriangle(ILGLchunk* chunk, const ILGLvertex* v1, const ILGLvertex* v2, const ILGLvertex* v3) {
+	ILGLtriangle* triangle;
+	ILGLrect rect;
 
-			const LGLfloat z = l1 * p1z + l2 * p2z + l3 * p3z;
-			if(z < -1.0 || z > 1.0) /* z clipping */
-				continue;
+	if (!ilglTriangleRect(&chunk->draw->clip, v1, v2, v3, &rect)) {
+		return;
+	}
 
-			const LGLint zdepth = (LGLint)(((z + 1.0f) * 0.5f) * 0xfffe);
-			const LGLsize offset = context->fbinfo.width * y + x;
+	assert(chunk->num_triangles < chunk->max_triangles);
+	triangle = &chunk->triangles[chunk->num_triangles++];
+	triangle->v[0] = v1 - chunk->vertices;
+	triangle->v[1] = v2 - chunk->vertices;
+	triangle->v[2] = v3 - chunk->vertices;
+	triangle->tiles.minx = rect.minx / ILGL_TILE_SIZE;
+	triangle->tiles.miny = rect.miny / ILGL_TILE_SIZE;
+	triangle->tiles.maxx = rect.maxx / ILGL_TILE_SIZE;
+	triangle->tiles.maxy = rect.maxy / ILGL_TILE_SIZE;
+}
+
+/* counting sort of the chunk's triangles into bins, triangles keep their order within a bin */
+static LGLint ilglSortBins(ILGLchunk* chunk, LGLuint tiles_x, LGLuint num_tiles) {
+	LGLuint i, t;
+	LGLint x, y;
+
+	chunk->bin_offsets = calloc(num_tiles + 1, sizeof(LGLuint));
+	if (chunk->bin_offsets == NULL) {
+		return 0;
+	}
+	for (i = 0; i < chunk->num_triangles; i++) {
+		const ILGLrect* tiles = &chunk->triangles[i].tiles;
+		for (y = tiles->miny; y <= tiles->maxy; y++) {
+			for (x = tiles->minx; x <= tiles->maxx; x++) {
+				chunk->bin_offsets[y * tiles_x + x + 1]++;
+			}
+		}
+	}
+	for (t = 0; t < num_tiles; t++) {
+		chunk->bin_offsets[t + 1] += chunk->bin_offsets[t];
+	}
+	if (chunk->bin_offsets[num_tiles] == 0) {
+		return 1;
+	}
 
-			if (zdepth < ((unsigned short*)context->fbinfo.zbuffer)[offset]) {
-				((unsigned short*)context->fbinfo.zbuffer)[offset] = zdepth;
-				fsin->a = l1;
-				fsin->b = l2;
-				fsin->c = l3;
-				context->fragment_shader(&fsout, fsin);
-				ilglSetPixel(context, offset, &fsout.color);
+	chunk->bin_triangles = malloc(sizeof(LGLuint) * chunk->bin_offsets[num_tiles]);
+	if (chunk->bin_triangles == NULL) {
+		return 0;
+	}
+	/* bin_offsets[t] advances to the end of bin t while it is filled, then every offset moves up one bin */
+	for (i = 0; i < chunk->num_triangles; i++) {
+		const ILGLrect* tiles = &chunk->triangles[i].tiles;
+		for (y = tiles->miny; y <= tiles->maxy; y++) {
+			for (x = tiles->minx; x <= tiles->maxx; x++) {
+				chunk->bin_triangles[chunk->bin_offsets[y * tiles_x + x]++] = i;
 			}
 		}
 	}
+	for (t = num_tiles; t > 0; t--) {
+		chunk->bin_offsets[t] = chunk->bin_offsets[t - 1];
+	}
+	chunk->bin_offsets[0] = 0;
+	return 1;
 }
 
-void lglDrawIndexed(const LGLcontext* context, LGLdrawtype type) {
-	LGLvsin vsin;
-	LGLvsout vsout;
-	LGLfsin fsin;
-	LGLuint* face;
-	LGLint p1x, p1y, p2x, p2y, p3x, p3y;
-	LGLfloat p1z, p2z, p3z;
+/*
+ *  Primitive assembly
+ */
 
-	assert(context != NULL);
-	assert(type == LGL_DRAW_TYPE_TRIANGLE_LIST); /* the only type we support right now */
-	assert(context->vertex_stream != NULL);
-	assert(context->index_stream != NULL);
-	assert(context->vertex_shader != NULL);
-	assert(context->fragment_shader != NULL);
+static void ilglProjectVertex(const ILGLdrawstate* state, ILGLvertex* v) {
+	v->x = (LGLint) ((v->out.position.x + 1.0) * ((float) state->vport_width / 2.0) + state->vport_x);
+	v->y = (LGLint) ((v->out.position.y + 1.0) * ((float) state->vport_height / 2.0) + state->vport_y);
+}
+
+static LGLuint ilglFetchIndex(const ILGLdraw* draw, LGLuint i) {
+	if (draw->vsin.index_type == LGL_INDEX_TYPE_USHORT) {
+		return ((const LGLushort*) draw->vsin.index_stream)[i];
+	}
+	return ((const LGLuint*) draw->vsin.index_stream)[i];
+}
+
+/* shades into the chunk's next vertex when binning and into local otherwise, returns the shaded vertex */
+static ILGLvertex* ilglShadeVertex(ILGLdraw* draw, LGLuint index, ILGLvertex* local) {
+	ILGLvertex* v = local;
+
+	assert(index < draw->vsin.vertex_stream_elements);
+	if (draw->chunk != NULL) {
+		assert(draw->chunk->num_vertices < draw->chunk->index_count);
+		v = &draw->chunk->vertices[draw->chunk->num_vertices++];
+	}
+	draw->vsin.index = index;
+	draw->vertex_shader(&v->out, &draw->vsin);
+	ilglProjectVertex(draw->state, v);
+	return v;
+}
+
+static LGLuint ilglRasterTriangle(const ILGLdraw* draw, LGLfsin* fsin, const ILGLrect* clip, const ILGLvertex* v1,
+		const ILGLvertex* v2, const ILGLvertex* v3) {
+	ilglCopyVaryings(draw->varying_layout, fsin->varyings[0], v1->out.varyings);
+	ilglCopyVaryings(draw->varying_layout, fsin->varyings[1], v2->out.varyings);
+	ilglCopyVaryings(draw->varying_layout, fsin->varyings[2], v3->out.varyings);
+	return draw->raster(draw, fsin, clip, v1->x, v1->y, v1->out.position.z, v2->x, v2->y, v2->out.position.z, v3->x,
+			v3->y, v3->out.position.z);
+}
+
+static void ilglRasterVertices(ILGLdraw* draw, const ILGLvertex* v1, const ILGLvertex* v2, const ILGLvertex* v3) {
+	ILGLrect rect;
 
-	vsin.vertex_stream = context->vertex_stream;
-	vsin.vertex_stream_elements = context->vertex_stream_elements;
-	vsin.index_stream = context->index_stream;
-	vsin.index_stream_elements = context->index_stream_elements;
-	memcpy(vsin.textures, context->textures, sizeof(context->textures));
-	memcpy(vsin.uniforms, context->uniforms, sizeof(context->uniforms));
-	memcpy(vsin.attributes, context->attributes, sizeof(context->attributes));
-	memcpy(vsin.num_attributes, context->num_attributes, sizeof(context->num_attributes));
-	memcpy(fsin.textures, context->textures, sizeof(context->textures));
-	memcpy(fsin.uniforms, context->textures, sizeof(context->uniforms));
-
-	for (face = context->index_stream; face != context->index_stream + context->index_stream_elements; face += 3) {
-		assert(face[0] < context->vertex_stream_elements);
-		assert(face[1] < context->vertex_stream_elements);
-		assert(face[2] < context->vertex_stream_elements);
-
-		vsin.index = face[0];
-		context->vertex_shader(&vsout, &vsin);
-		memcpy(&fsin.varyings[0], vsout.varyings, sizeof(vsout.varyings));
-		p1x = (LGLint) ((vsout.position.x + 1.0) * ((float) context->vport_width / 2.0) + context->vport_x);
-		p1y = (LGLint) ((vsout.position.y + 1.0) * ((float) context->vport_height / 2.0) + context->vport_y);
-		p1z = vsout.position.z;
-
-		vsin.index = face[1];
-		context->vertex_shader(&vsout, &vsin);
-		memcpy(&fsin.varyings[1], &vsout.varyings, sizeof(vsout.varyings));
-		p2x = (LGLint) ((vsout.position.x + 1.0) * ((float) context->vport_width / 2.0) + context->vport_x);
-		p2y = (LGLint) ((vsout.position.y + 1.0) * ((float) context->vport_height / 2.0) + context->vport_y);
-		p2z = vsout.position.z;
-
-		vsin.index = face[2];
-		context->vertex_shader(&vsout, &vsin);
-		memcpy(&fsin.varyings[2], &vsout.varyings, sizeof(vsout.varyings));
-		p3x = (LGLint) ((vsout.position.x + 1.0) * ((float) context->vport_width / 2.0) + context->vport_x);
-		p3y = (LGLint) ((vsout.position.y + 1.0) * ((float) context->vport_height / 2.0) + context->vport_y);
-		p3z = vsout.position.z;
-
-		ilglRasterTriangle(context, &fsin, p1x, p1y, p1z, p2x, p2y, p2z, p3x, p3y, p3z);
+	if (draw->chunk != NULL) {
+		ilglBinTriangle(draw->chunk, v1, v2, v3);
+		return;
+	}
+	if (draw->bounds != NULL) {
+		if (ilglTriangleRect(&draw->clip, v1, v2, v3, &rect)) {
+			ilglUnionRect(draw->bounds, &rect);
+		}
+		return;
+	}
+	draw->samples += ilglRasterTriangle(draw, &draw->fsin, &draw->clip, v1, v2, v3);
+}
+
+/*
+ * Shaded vertices of the last 32 misses, first in first out, the cache lgluOptimizeVertexCache orders triangles
+ * for (LGLU_VERTEX_CACHE_SIZE). Vertices are shaded into a ring of two more entries than the cache holds, so
+ * the misses of a triangle never overwrite a vertex it already hit.
+ */
+#define ILGL_VERTEX_CACHE_SIZE 32
+
+/* slot holding index, ILGL_VERTEX_CACHE_SIZE if none does */
+static LGLuint ilglFindCached(const LGLuint* tags, LGLuint index) {
+	LGLuint slot;
+#if ILGL_SSE
+	/* 16 tags per step, the compare masks are packed down to one bit each */
+	const __m128i key = _mm_set1_epi32((int) index);
+	for (slot = 0; slot < ILGL_VERTEX_CACHE_SIZE; slot += 16) {
+		const __m128i* t = (const __m128i*) &tags[slot];
+		const __m128i a = _mm_packs_epi32(_mm_cmpeq_epi32(_mm_loadu_si128(t + 0), key),
+				_mm_cmpeq_epi32(_mm_loadu_si128(t + 1), key));
+		const __m128i b = _mm_packs_epi32(_mm_cmpeq_epi32(_mm_loadu_si128(t + 2), key),
+				_mm_cmpeq_epi32(_mm_loadu_si128(t + 3), key));
+		const LGLuint mask = (LGLuint) _mm_movemask_epi8(_mm_packs_epi16(a, b));
+		if (mask != 0) {
+			return slot + __builtin_ctz(mask);
+		}
+	}
+#else
+	for (slot = 0; slot < ILGL_VERTEX_CACHE_SIZE && tags[slot] != index; slot++) {
+	}
+#endif
+	return slot;
+}
+
+static void ilglAssembleList(ILGLdraw* draw) {
+	ILGLvertex storage[ILGL_VERTEX_CACHE_SIZE + 2];
+	const ILGLvertex* cache[ILGL_VERTEX_CACHE_SIZE];
+	LGLuint tags[ILGL_VERTEX_CACHE_SIZE];
+	const ILGLvertex* v[3];
+	LGLuint i, index, slot, next = 0, stored = 0, count = 0;
+
+	for (i = 0; i < ILGL_VERTEX_CACHE_SIZE; i++) {
+		tags[i] = ~0u; /* never a valid index, vertex_stream_elements is below it */
+	}
+
+	for (i = draw->first_index; i < draw->first_index + draw->index_count; i++) {
+		index = ilglFetchIndex(draw, i);
+		if (draw->restart && index == draw->restart_index) {
+			count = 0;
+			continue;
+		}
+		slot = ilglFindCached(tags, index);
+		if (slot == ILGL_VERTEX_CACHE_SIZE) {
+			slot = next;
+			next = (next + 1) % ILGL_VERTEX_CACHE_SIZE;
+			cache[slot] = ilglShadeVertex(draw, index, &storage[stored]);
+			stored = (stored + 1) % (ILGL_VERTEX_CACHE_SIZE + 2);
+			tags[slot] = index;
+		}
+		v[count] = cache[slot];
+		if (++count == 3) {
+			ilglRasterVertices(draw, v[0], v[1], v[2]);
+			count = 0;
+		}
+	}
+}
+
+/* every vertex after the second one forms a triangle with the two shaded before it */
+static void ilglAssembleStrip(ILGLdraw* draw) {
+	ILGLvertex storage[3];
+	const ILGLvertex* v[3];
+	LGLuint i, index, count = 0;
+
+	for (i = draw->first_index; i < draw->first_index + draw->index_count; i++) {
+		index = ilglFetchIndex(draw, i);
+		if (draw->restart && index == draw->restart_index) {
+			count = 0;
+			continue;
+		}
+		v[count % 3] = ilglShadeVertex(draw, index, &storage[count % 3]);
+		if (++count >= 3) {
+			const ILGLvertex* a = v[(count - 3) % 3];
+			const ILGLvertex* b = v[(count - 2) % 3];
+			const ILGLvertex* c = v[(count - 1) % 3];
+			if ((count - 3) & 1) { /* odd triangles swap two vertices to keep the winding */
+				ilglRasterVertices(draw, b, a, c);
+			} else {
+				ilglRasterVertices(draw, a, b, c);
+			}
+		}
+	}
+}
+
+/* v[0] holds the center of the fan, v[1] and v[2] take turns holding the rim vertices */
+static void ilglAssembleFan(ILGLdraw* draw) {
+	ILGLvertex storage[3];
+	const ILGLvertex* v[3];
+	LGLuint i, index, k, count = 0;
+
+	for (i = draw->first_index; i < draw->first_index + draw->index_count; i++) {
+		index = ilglFetchIndex(draw, i);
+		if (draw->restart && index == draw->restart_index) {
+			count = 0;
+			continue;
+		}
+		k = count == 0 ? 0 : 1 + ((count - 1) & 1);
+		v[k] = ilglShadeVertex(draw, index, &storage[k]);
+		if (++count >= 3) {
+			ilglRasterVertices(draw, v[0], v[1 + ((count - 1) & 1)], v[1 + (count & 1)]);
+		}
+	}
+}
+
+static void ilglAssemble(ILGLdraw* draw, LGLdrawtype type) {
+	switch (type) {
+	case LGL_DRAW_TYPE_TRIANGLE_LIST:
+		ilglAssembleList(draw);
+		break;
+	case LGL_DRAW_TYPE_TRIANGLE_STRIP:
+		ilglAssembleStrip(draw);
+		break;
+	case LGL_DRAW_TYPE_TRIANGLE_FAN:
+		ilglAssembleFan(draw);
+		break;
+	default:
+		assert(!"unknown draw type");
+	}
+}
+
+static void ilglSetDrawIndexStream(ILGLdraw* draw, LGLdata indices, LGLindextype type, LGLsize elems) {
+	draw->vsin.index_stream = indices;
+	draw->vsin.index_type = type;
+	draw->vsin.index_stream_elements = elems;
+	draw->restart_index = type == LGL_INDEX_TYPE_USHORT ? 0xffff : 0xffffffff;
+}
+
+/* binds the captured state, done once per draw call */
+static void ilglBeginDraw(ILGLdraw* draw, const ILGLdrawstate* state) {
+	draw->state = state;
+	draw->vertex_shader = state->vertex_shader;
+	draw->fragment_shader = state->fragment_shader;
+	draw->varying_layout = &state->varying_layout;
+	draw->vsin.instance = 0;
+	draw->vsin.vertex_stream = state->vertex_stream;
+	draw->vsin.vertex_stream_elements = state->vertex_stream_elements;
+	draw->vsin.textures = state->texture_block->textures;
+	draw->vsin.uniforms = state->uniform_block->uniforms;
+	draw->vsin.attributes = state->attribute_block->attributes;
+	draw->vsin.num_attributes = state->attribute_block->num_attributes;
+	draw->vsin.divisors = state->attribute_block->divisors;
+	draw->fsin.textures = state->texture_block->textures;
+	draw->fsin.uniforms = state->uniform_block->uniforms;
+	draw->raster = ilglSelectRasterVariant(state);
+	draw->restart = (state->state & LGL_STATE_PRIMITIVE_RESTART) != 0;
+	ilglSetDrawIndexStream(draw, state->index_stream, state->index_type, state->index_stream_elements);
+	draw->first_index = 0;
+	draw->index_count = state->index_stream_elements;
+	ilglClipRect(state, &draw->clip);
+	draw->chunk = NULL;
+	draw->samples = 0;
+	draw->bounds = NULL;
+}
+
+/* records have no per instance streams */
+static const LGLuint ilglNoDivisors[LGL_MAX_ATTRIBUTES];
+
+/* overrides the bindings of the draw with the ones of the record */
+static void ilglBeginRecord(ILGLdraw* draw, const ILGLdrawstate* state, const LGLdrawrecord* record) {
+	assert(record->vertex_shader != NULL);
+	assert(record->fragment_shader != NULL);
+	assert(record->vertex_stream != NULL);
+	assert(record->index_stream != NULL);
+
+	draw->vertex_shader = record->vertex_shader;
+	draw->fragment_shader = record->fragment_shader;
+	draw->varying_layout = record->varying_layout != NULL ? record->varying_layout : &state->varying_layout;
+	draw->vsin.vertex_stream = record->vertex_stream;
+	draw->vsin.vertex_stream_elements = record->vertex_stream_elements;
+	draw->vsin.attributes = record->attributes;
+	draw->vsin.num_attributes = record->num_attributes;
+	draw->vsin.textures = draw->fsin.textures = record->textures != NULL ? record->textures
+			: state->texture_block->textures;
+	draw->vsin.uniforms = draw->fsin.uniforms = record->uniforms != NULL ? record->uniforms
+			: state->uniform_block->uniforms;
+	ilglSetDrawIndexStream(draw, record->index_stream, record->index_type, record->first_index + record->index_count);
+	draw->first_index = record->first_index;
+	draw->index_count = record->index_count;
+}
+
+static void ilglCountSamples(const ILGLdrawstate* state, LGLuint samples) {
+	if (state->query != NULL && samples != 0) {
+		__atomic_add_fetch(&state->query->samples, samples, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ *  Jobs
+ */
+
+/* one draw or multi draw command split into chunks and tiles */
+typedef struct ILGLbinner_s {
+	const ILGLdrawstate* state;
+	LGLuint tiles_x, tiles_y;
+	ILGLrect tiles; /* tiles overlapping the clip rectangle, only these get tile jobs */
+	ILGLchunk* chunks;
+	LGLsize num_chunks, max_chunks;
+} ILGLbinner;
+
+/* pixels of a tile, clipped to rect */
+static void ilglTileRect(const ILGLrect* rect, LGLuint tiles_x, LGLuint tile, ILGLrect* pixels) {
+	pixels->minx = ilglMax2((tile % tiles_x) * ILGL_TILE_SIZE, rect->minx);
+	pixels->miny = ilglMax2((tile / tiles_x) * ILGL_TILE_SIZE, rect->miny);
+	pixels->maxx = ilglMin2((tile % tiles_x + 1) * ILGL_TILE_SIZE - 1, rect->maxx);
+	pixels->maxy = ilglMin2((tile / tiles_x + 1) * ILGL_TILE_SIZE - 1, rect->maxy);
+}
+
+/* tiles overlapping rect */
+static void ilglTileRange(const ILGLrect* rect, ILGLrect* tiles) {
+	if (rect->minx > rect->maxx || rect->miny > rect->maxy) {
+		ilglEmptyRect(tiles);
+		return;
+	}
+	tiles->minx = rect->minx / ILGL_TILE_SIZE;
+	tiles->miny = rect->miny / ILGL_TILE_SIZE;
+	tiles->maxx = rect->maxx / ILGL_TILE_SIZE;
+	tiles->maxy = rect->maxy / ILGL_TILE_SIZE;
+}
+
+static LGLuint ilglTileCount(const ILGLrect* tiles) {
+	if (tiles->minx > tiles->maxx) {
+		return 0;
+	}
+	return (tiles->maxx - tiles->minx + 1) * (tiles->maxy - tiles->miny + 1);
+}
+
+/* the tile of job index of a job per tile of the range */
+static LGLuint ilglTileIndex(const ILGLrect* tiles, LGLuint tiles_x, LGLuint index) {
+	const LGLuint range_x = tiles->maxx - tiles->minx + 1;
+	return (tiles->miny + index / range_x) * tiles_x + tiles->minx + index % range_x;
+}
+
+/* returns 1 if a tile of the rectangle may be written */
+static LGLint ilglTouchesMask(const ILGLdrawstate* state, const ILGLrect* rect) {
+	const LGLuint tiles_x = (state->fbinfo->width + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+	ILGLrect tiles;
+	LGLint x, y;
+
+	if (state->mask == NULL) {
+		return 1;
+	}
+	ilglTileRange(rect, &tiles);
+	for (y = tiles.miny; y <= tiles.maxy; y++) {
+		for (x = tiles.minx; x <= tiles.maxx; x++) {
+			if (state->mask[y * tiles_x + x]) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/* runs proc for 0 to count - 1 on the job system, without one on the calling thread */
+static void ilglRunJobs(LGLjobsystem* jobs, LGLjobproc proc, void* data, LGLuint count) {
+	LGLjobgroup group = { 0 };
+	LGLuint i;
+
+	if (jobs == NULL) {
+		for (i = 0; i < count; i++) {
+			proc(data, i);
+		}
+		return;
+	}
+	lglRunJobs(jobs, &group, proc, data, count);
+	lglWaitJobs(jobs, &group);
+}
+
+static void ilglInitBinner(ILGLbinner* binner, const ILGLdrawstate* state) {
+	ILGLrect clip;
+	binner->state = state;
+	binner->tiles_x = (state->fbinfo->width + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+	binner->tiles_y = (state->fbinfo->height + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+	ilglClipRect(state, &clip);
+	ilglTileRange(&clip, &binner->tiles);
+	binner->chunks = NULL;
+	binner->num_chunks = 0;
+	binner->max_chunks = 0;
+}
+
+static void ilglFreeBinner(ILGLbinner* binner) {
+	LGLsize i;
+	for (i = 0; i < binner->num_chunks; i++) {
+		free(binner->chunks[i].vertices);
+		free(binner->chunks[i].triangles);
+		free(binner->chunks[i].bin_offsets);
+		free(binner->chunks[i].bin_triangles);
+	}
+	free(binner->chunks);
+}
+
+/* triangle lists without primitive restart are split, other draws form a single chunk per instance */
+static LGLint ilglAddChunks(ILGLbinner* binner, const ILGLdraw* draw, LGLdrawtype type, LGLuint instance) {
+	const LGLint split = type == LGL_DRAW_TYPE_TRIANGLE_LIST && !draw->restart;
+	const LGLsize end = draw->first_index + draw->index_count;
+	LGLsize first = draw->first_index;
+	ILGLchunk* chunk;
+
+	while (first < end) {
+		if (binner->num_chunks == binner->max_chunks) {
+			const LGLsize max_chunks = binner->max_chunks ? binner->max_chunks * 2 : 64;
+			chunk = realloc(binner->chunks, sizeof(ILGLchunk) * max_chunks);
+			if (chunk == NULL) {
+				return 0;
+			}
+			binner->chunks = chunk;
+			binner->max_chunks = max_chunks;
+		}
+		chunk = &binner->chunks[binner->num_chunks++];
+		memset(chunk, 0, sizeof(ILGLchunk));
+		chunk->draw = draw;
+		chunk->type = type;
+		chunk->instance = instance;
+		chunk->first_index = first;
+		chunk->index_count = split && end - first > ILGL_CHUNK_INDICES ? ILGL_CHUNK_INDICES : end - first;
+		first += chunk->index_count;
+	}
+	return 1;
+}
+
+static void ilglShadeChunkJob(void* data, LGLuint index) {
+	const ILGLbinner* binner = data;
+	ILGLchunk* chunk = &binner->chunks[index];
+	ILGLdraw draw = *chunk->draw; /* shading writes to vsin */
+
+	if (chunk->type == LGL_DRAW_TYPE_TRIANGLE_LIST) {
+		chunk->max_triangles = chunk->index_count / 3;
+	} else {
+		chunk->max_triangles = chunk->index_count > 2 ? chunk->index_count - 2 : 0;
+	}
+	chunk->vertices = malloc(sizeof(ILGLvertex) * chunk->index_count);
+	chunk->triangles = malloc(sizeof(ILGLtriangle) * chunk->max_triangles);
+	if ((chunk->vertices == NULL && chunk->index_count != 0)
+			|| (chunk->triangles == NULL && chunk->max_triangles != 0)) {
+		chunk->failed = 1;
+		return;
+	}
+
+	draw.chunk = chunk;
+	draw.vsin.instance = chunk->instance;
+	draw.first_index = chunk->first_index;
+	draw.index_count = chunk->index_count;
+	ilglAssemble(&draw, chunk->type);
+
+	if (!ilglSortBins(chunk, binner->tiles_x, binner->tiles_x * binner->tiles_y)) {
+		chunk->failed = 1;
+	}
+}
+
+static void ilglRasterTileJob(void* data, LGLuint index) {
+	const ILGLbinner* binner = data;
+	const ILGLtriangle* triangle;
+	const LGLuint tile = ilglTileIndex(&binner->tiles, binner->tiles_x, index);
+	ILGLrect clip;
+	LGLfsin fsin;
+	LGLsize i;
+	LGLuint j, samples = 0;
+
+	if (binner->state->mask != NULL && !binner->state->mask[tile]) {
+		return;
+	}
+
+	for (i = 0; i < binner->num_chunks; i++) {
+		const ILGLchunk* chunk = &binner->chunks[i];
+		if (chunk->bin_offsets == NULL || chunk->bin_offsets[tile] == chunk->bin_offsets[tile + 1]) {
+			continue;
+		}
+		ilglTileRect(&chunk->draw->clip, binner->tiles_x, tile, &clip);
+		fsin.textures = chunk->draw->fsin.textures;
+		fsin.uniforms = chunk->draw->fsin.uniforms;
+		for (j = chunk->bin_offsets[tile]; j < chunk->bin_offsets[tile + 1]; j++) {
+			triangle = &chunk->triangles[chunk->bin_triangles[j]];
+			samples += ilglRasterTriangle(chunk->draw, &fsin, &clip, &chunk->vertices[triangle->v[0]],
+					&chunk->vertices[triangle->v[1]], &chunk->vertices[triangle->v[2]]);
+		}
+	}
+	ilglCountSamples(binner->state, samples);
+}
+
+/* shades and bins all chunks, then rasterizes all tiles, returns 0 before rasterizing if memory ran out */
+static LGLint ilglRunBinner(ILGLbinner* binner) {
+	LGLjobsystem* jobs = binner->state->jobs;
+	LGLsize i;
+
+	/* nothing can be written, skip shading */
+	if (ilglTileCount(&binner->tiles) == 0) {
+		return 1;
+	}
+
+	ilglRunJobs(jobs, ilglShadeChunkJob, binner, binner->num_chunks);
+	for (i = 0; i < binner->num_chunks; i++) {
+		if (binner->chunks[i].failed) {
+			return 0;
+		}
+	}
+
+	if (binner->num_chunks != 0) {
+		ilglRunJobs(jobs, ilglRasterTileJob, binner, ilglTileCount(&binner->tiles));
+	}
+	return 1;
+}
+
+/* rasterizes without binning, with a tile mask one tile at a time */
+static void ilglAssembleDirect(ILGLdraw* draw, LGLdrawtype type) {
+	const ILGLdrawstate* state = draw->state;
+	const LGLuint tiles_x = (state->fbinfo->width + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+	const ILGLrect clip = draw->clip;
+	ILGLrect tiles;
+	LGLuint i, tile;
+
+	if (state->mask == NULL) {
+		ilglAssemble(draw, type);
+		return;
+	}
+	ilglTileRange(&clip, &tiles);
+	for (i = 0; i < ilglTileCount(&tiles); i++) {
+		tile = ilglTileIndex(&tiles, tiles_x, i);
+		if (state->mask[tile]) {
+			ilglTileRect(&clip, tiles_x, tile, &draw->clip);
+			ilglAssemble(draw, type);
+		}
+	}
+	draw->clip = clip;
+}
+
+static void ilglClearRect(const LGLFramebufferinfo* fbinfo, LGLclear clear, const ILGLrect* rect) {
+	const LGLsize width = fbinfo->width;
+	LGLint y, rows = rect->maxy - rect->miny + 1, columns = rect->maxx - rect->minx + 1;
+
+	if (rows <= 0 || columns <= 0) {
+		return;
+	}
+	/* full rows are contiguous, clear them at once */
+	if (columns == (LGLint) width) {
+		columns *= rows;
+		rows = 1;
+	}
+	for (y = rect->miny; y < rect->miny + rows; y++) {
+		if (clear & LGL_CLEAR_FRAMEBUFFER) {
+			// TODO: clear color
+			memset((unsigned int*) fbinfo->framebuffer + y * width + rect->minx, 0, columns * sizeof(unsigned int));
+		}
+		if (clear & LGL_CLEAR_ZBUFFER) {
+			// TODO: clear depth
+			memset((unsigned short*) fbinfo->zbuffer + y * width + rect->minx, 0xff,
+					columns * sizeof(unsigned short));
+		}
+	}
+}
+
+typedef struct ILGLclearjob_s {
+	const LGLFramebufferinfo* fbinfo;
+	const LGLbyte* mask;
+	LGLclear clear;
+	LGLuint tiles_x;
+	ILGLrect rect, tiles;
+} ILGLclearjob;
+
+static void ilglClearTileJob(void* data, LGLuint index) {
+	const ILGLclearjob* job = data;
+	const LGLuint tile = ilglTileIndex(&job->tiles, job->tiles_x, index);
+	ILGLrect pixels;
+
+	if (job->mask != NULL && !job->mask[tile]) {
+		return;
+	}
+	ilglTileRect(&job->rect, job->tiles_x, tile, &pixels);
+	ilglClearRect(job->fbinfo, job->clear, &pixels);
+}
+
+/*
+ *  Command execution
+ */
+
+static void ilglClear(const ILGLdrawstate* state, LGLclear clear) {
+	ILGLclearjob job;
+
+	job.fbinfo = state->fbinfo;
+	job.mask = state->mask;
+	job.clear = clear;
+	ilglScissorRect(state, &job.rect);
+
+	if (state->jobs == NULL && state->mask == NULL) {
+		ilglClearRect(job.fbinfo, clear, &job.rect);
+		return;
+	}
+
+	job.tiles_x = (job.fbinfo->width + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+	ilglTileRange(&job.rect, &job.tiles);
+	ilglRunJobs(state->jobs, ilglClearTileJob, &job, ilglTileCount(&job.tiles));
+}
+
+static void ilglDrawInstanced(const ILGLdrawstate* state, LGLdrawtype type, LGLsize instances) {
+	ILGLbinner binner;
+	ILGLdraw draw;
+	LGLuint instance;
+	LGLint done = 0;
+
+	if (state->mask != NULL && !ilglTouchesMask(state, &state->bounds[0])) {
+		return;
+	}
+
+	/* everything but the instance index is shared by all instances */
+	ilglBeginDraw(&draw, state);
+
+	/* instances are shaded in parallel, every instance forms its own chunks */
+	if (state->jobs != NULL || state->mask != NULL) {
+		ilglInitBinner(&binner, state);
+		for (instance = 0; instance < instances && ilglAddChunks(&binner, &draw, type, instance); instance++)
+			;
+		done = instance == instances && ilglRunBinner(&binner);
+		ilglFreeBinner(&binner);
+	}
+	if (done) {
+		return;
+	}
+
+	for (instance = 0; instance < instances; instance++) {
+		draw.vsin.instance = instance;
+		ilglAssembleDirect(&draw, type);
+	}
+	ilglCountSamples(state, draw.samples);
+}
+
+/* orders records by shader, then texture bindings, then submission order */
+static int ilglCompareRecords(const void* a, const void* b) {
+	const LGLdrawrecord* ra = *(const LGLdrawrecord* const *) a;
+	const LGLdrawrecord* rb = *(const LGLdrawrecord* const *) b;
+	const size_t keysa[4] = { (size_t) ra->vertex_shader, (size_t) ra->fragment_shader, (size_t) ra->textures,
+			(size_t) ra };
+	const size_t keysb[4] = { (size_t) rb->vertex_shader, (size_t) rb->fragment_shader, (size_t) rb->textures,
+			(size_t) rb };
+	LGLuint i;
+	for (i = 0; i < 4; i++) {
+		if (keysa[i] != keysb[i]) {
+			return keysa[i] < keysb[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+static void ilglMultiDraw(const ILGLdrawstate* state, const LGLdrawrecord* records, LGLsize count) {
+	const LGLdrawrecord** sorted;
+	const LGLdrawrecord* record;
+	ILGLbinner binner;
+	ILGLdraw draw;
+	ILGLdraw* draws;
+	LGLuint i;
+	LGLint done = 0;
+
+	/*
+	 * with the depth test records are drawn in sorted order, if the sort buffer is not available in submission
+	 * order. Without it later records paint over earlier ones, they keep submission order.
+	 */
+	sorted = state->state & LGL_STATE_DEPTH_TEST ? malloc(sizeof(const LGLdrawrecord*) * count) : NULL;
+	if (sorted != NULL) {
+		for (i = 0; i < count; i++) {
+			sorted[i] = &records[i];
+		}
+		qsort(sorted, count, sizeof(const LGLdrawrecord*), ilglCompareRecords);
+	}
+
+	ilglBeginDraw(&draw, state);
+	draw.vsin.divisors = ilglNoDivisors;
+
+	/* binned every record keeps its own draw until the tiles are rasterized */
+	draws = state->jobs != NULL || state->mask != NULL ? malloc(sizeof(ILGLdraw) * count) : NULL;
+	if (draws != NULL) {
+		ilglInitBinner(&binner, state);
+		for (i = 0; i < count; i++) {
+			record = sorted != NULL ? sorted[i] : &records[i];
+			if (state->mask != NULL && !ilglTouchesMask(state, &state->bounds[record - records])) {
+				continue;
+			}
+			draws[i] = draw;
+			ilglBeginRecord(&draws[i], state, record);
+			if (!ilglAddChunks(&binner, &draws[i], record->type, 0)) {
+				break;
+			}
+		}
+		done = i == count && ilglRunBinner(&binner);
+		ilglFreeBinner(&binner);
+		free(draws);
+	}
+
+	for (i = 0; i < count && !done; i++) {
+		record = sorted != NULL ? sorted[i] : &records[i];
+		if (state->mask != NULL && !ilglTouchesMask(state, &state->bounds[record - records])) {
+			continue;
+		}
+		ilglBeginRecord(&draw, state, record);
+		ilglAssembleDirect(&draw, record->type);
+	}
+	ilglCountSamples(state, draw.samples);
+
+	free(sorted);
+}
+
+/* the twelve triangles of the box faces, rasterized by the depth only variant */
+static void ilglDrawBounds(const ILGLdrawstate* state, const LGLv3f* corners) {
+	static const LGLvaryinglayout no_varyings;
+	static const LGLbyte faces[6][4] = {
+		{ 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 5, 7, 6 }
+	};
+	ILGLvertex v[8];
+	ILGLdraw draw;
+	LGLuint i;
+
+	ilglBeginDraw(&draw, state);
+	draw.varying_layout = &no_varyings;
+	draw.raster = ilglRasterTriangle_None_DT;
+
+	for (i = 0; i < 8; i++) {
+		v[i].out.position = corners[i];
+		ilglProjectVertex(state, &v[i]);
+	}
+	for (i = 0; i < 6; i++) {
+		ilglRasterVertices(&draw, &v[faces[i][0]], &v[faces[i][1]], &v[faces[i][2]]);
+		ilglRasterVertices(&draw, &v[faces[i][0]], &v[faces[i][2]], &v[faces[i][3]]);
+	}
+	ilglCountSamples(state, draw.samples);
+}
+
+/*
+ *  Commands
+ */
+
+typedef enum ILGLcommandtype_e {
+	ILGL_COMMAND_CLEAR, ILGL_COMMAND_DRAW, ILGL_COMMAND_MULTIDRAW, ILGL_COMMAND_BEGIN_QUERY, ILGL_COMMAND_BOUNDS
+} ILGLcommandtype;
+
+struct ILGLcommand_s {
+	ILGLcommandtype type;
+	ILGLdrawstate state;
+	LGLclear clear;
+	LGLdrawtype draw_type;
+	LGLsize instances;
+	const LGLdrawrecord* records;
+	LGLsize num_records;
+	LGLint owns_records;
+	LGLv3f corners[8];
+	LGLint crosses_eye; /* a corner of the bounding box has w <= 0, it is counted visible without rasterizing */
+};
+
+/* takes references on the binding blocks, they are released by ilglFreeCommand */
+static void ilglCaptureState(const LGLcontext* context, ILGLcommandtype type, ILGLcommand* command) {
+	ILGLdrawstate* state = &command->state;
+
+	command->type = type;
+	command->owns_records = 0;
+	command->crosses_eye = 0;
+
+	state->fbinfo = &context->buffers[context->back_buffer];
+	state->vport_x = context->vport_x;
+	state->vport_y = context->vport_y;
+	state->vport_width = context->vport_width;
+	state->vport_height = context->vport_height;
+	state->scissor_x = context->scissor_x;
+	state->scissor_y = context->scissor_y;
+	state->scissor_width = context->scissor_width;
+	state->scissor_height = context->scissor_height;
+	state->state = context->state;
+	state->vertex_shader = context->vertex_shader;
+	state->fragment_shader = context->fragment_shader;
+	state->varying_layout = context->varying_layout;
+	state->vertex_stream = context->vertex_stream;
+	state->vertex_stream_elements = context->vertex_stream_elements;
+	state->index_stream = context->index_stream;
+	state->index_type = context->index_type;
+	state->index_stream_elements = context->index_stream_elements;
+	state->texture_block = context->texture_block;
+	state->uniform_block = context->uniform_block;
+	state->attribute_block = context->attribute_block;
+	state->jobs = context->jobs;
+	state->query = context->query;
+	state->condition = context->condition;
+	state->mask = NULL;
+	state->bounds = NULL;
+	ilglAcquireBlock(&state->texture_block->block);
+	ilglAcquireBlock(&state->uniform_block->block);
+	ilglAcquireBlock(&state->attribute_block->block);
+}
+
+static void ilglExecuteCommand(ILGLcommand* command) {
+	const LGLquery* condition = command->state.condition;
+
+	/* commands execute in order, the condition's samples are final */
+	if (condition != NULL && command->type != ILGL_COMMAND_CLEAR && command->type != ILGL_COMMAND_BEGIN_QUERY
+			&& __atomic_load_n(&condition->samples, __ATOMIC_ACQUIRE) == 0) {
+		return;
+	}
+
+	switch (command->type) {
+	case ILGL_COMMAND_CLEAR:
+		ilglClear(&command->state, command->clear);
+		break;
+	case ILGL_COMMAND_DRAW:
+		ilglDrawInstanced(&command->state, command->draw_type, command->instances);
+		break;
+	case ILGL_COMMAND_MULTIDRAW:
+		ilglMultiDraw(&command->state, command->records, command->num_records);
+		break;
+	case ILGL_COMMAND_BEGIN_QUERY:
+		__atomic_store_n(&command->state.query->samples, 0, __ATOMIC_RELAXED);
+		break;
+	case ILGL_COMMAND_BOUNDS:
+		if (command->crosses_eye) {
+			ilglCountSamples(&command->state, 1);
+		} else {
+			ilglDrawBounds(&command->state, command->corners);
+		}
+		break;
+	}
+}
+
+static void ilglFreeCommand(ILGLcommand* command) {
+	ilglReleaseBlock(&command->state.texture_block->block);
+	ilglReleaseBlock(&command->state.uniform_block->block);
+	ilglReleaseBlock(&command->state.attribute_block->block);
+	if (command->owns_records) {
+		free((LGLdrawrecord*) command->records);
+	}
+}
+
+static void ilglExecuteCommands(ILGLcommand* commands, LGLsize count) {
+	LGLsize i;
+	for (i = 0; i < count; i++) {
+		ilglExecuteCommand(&commands[i]);
+		ilglFreeCommand(&commands[i]);
+	}
+}
+
+/*
+ *  Incremental frames
+ */
+
+/*
+ * Everything that decides which pixels a clear, draw or multi draw record writes and with which values.
+ * Zeroed before it is filled so keys compare with memcmp. The bound textures, uniforms and attributes are
+ * copied, so resetting a uniform to the value of the last frame leaves the draws using it unchanged.
+ */
+typedef struct ILGLdrawkey_s {
+	ILGLcommandtype type;
+	LGLclear clear;
+	ILGLrect scissor;
+	LGLstate state;
+	LGLint vport_x, vport_y;
+	LGLsize vport_width, vport_height;
+	LGLdrawtype draw_type;
+	LGLsize instances;
+	LGLvertexshader vertex_shader;
+	LGLfragmentshader fragment_shader;
+	LGLvaryinglayout varying_layout;
+	LGLv3f* vertex_stream;
+	LGLsize vertex_stream_elements;
+	LGLdata index_stream;
+	LGLindextype index_type;
+	LGLsize first_index, index_count;
+	const LGLtexture* record_textures; /* records with their own bindings, compared by pointer */
+	const LGLuniform* record_uniforms;
+	LGLtexture textures[LGL_MAX_TEXTURES]; /* context bindings used by the item */
+	LGLuniform uniforms[LGL_MAX_UNIFORMS];
+	LGLattribute attributes[LGL_MAX_ATTRIBUTES];
+	LGLsize num_attributes[LGL_MAX_ATTRIBUTES];
+	LGLuint divisors[LGL_MAX_ATTRIBUTES];
+} ILGLdrawkey;
+
+/* clears and draws are one item each, multi draws one item per record */
+static LGLsize ilglCountItems(const ILGLcommand* command) {
+	return command->type == ILGL_COMMAND_MULTIDRAW ? command->num_records : 1;
+}
+
+static void ilglMakeKey(const ILGLcommand* command, LGLsize record_index, ILGLdrawkey* key) {
+	const ILGLdrawstate* state = &command->state;
+	const LGLdrawrecord* record;
+
+	memset(key, 0, sizeof(ILGLdrawkey));
+	key->type = command->type;
+	if (command->type == ILGL_COMMAND_CLEAR) {
+		key->clear = command->clear;
+		ilglScissorRect(state, &key->scissor);
+		return;
+	}
+
+	ilglClipRect(state, &key->scissor);
+	key->state = state->state;
+	key->vport_x = state->vport_x;
+	key->vport_y = state->vport_y;
+	key->vport_width = state->vport_width;
+	key->vport_height = state->vport_height;
+	if (command->type == ILGL_COMMAND_DRAW) {
+		key->draw_type = command->draw_type;
+		key->instances = command->instances;
+		key->vertex_shader = state->vertex_shader;
+		key->fragment_shader = state->fragment_shader;
+		key->varying_layout = state->varying_layout;
+		key->vertex_stream = state->vertex_stream;
+		key->vertex_stream_elements = state->vertex_stream_elements;
+		key->index_stream = state->index_stream;
+		key->index_type = state->index_type;
+		key->index_count = state->index_stream_elements;
+		memcpy(key->textures, state->texture_block->textures, sizeof(key->textures));
+		memcpy(key->uniforms, state->uniform_block->uniforms, sizeof(key->uniforms));
+		memcpy(key->attributes, state->attribute_block->attributes, sizeof(key->attributes));
+		memcpy(key->num_attributes, state->attribute_block->num_attributes, sizeof(key->num_attributes));
+		memcpy(key->divisors, state->attribute_block->divisors, sizeof(key->divisors));
+		return;
+	}
+
+	record = &command->records[record_index];
+	key->draw_type = record->type;
+	key->vertex_shader = record->vertex_shader;
+	key->fragment_shader = record->fragment_shader;
+	key->varying_layout = record->varying_layout != NULL ? *record->varying_layout : state->varying_layout;
+	key->vertex_stream = record->vertex_stream;
+	key->vertex_stream_elements = record->vertex_stream_elements;
+	key->index_stream = record->index_stream;
+	key->index_type = record->index_type;
+	key->first_index = record->first_index;
+	key->index_count = record->index_count;
+	key->record_textures = record->textures;
+	key->record_uniforms = record->uniforms;
+	if (record->textures == NULL) {
+		memcpy(key->textures, state->texture_block->textures, sizeof(key->textures));
+	}
+	if (record->uniforms == NULL) {
+		memcpy(key->uniforms, state->uniform_block->uniforms, sizeof(key->uniforms));
+	}
+	memcpy(key->attributes, record->attributes, sizeof(key->attributes));
+	memcpy(key->num_attributes, record->num_attributes, sizeof(key->num_attributes));
+}
+
+/* pixels an item writes, measured by shading it without rasterizing */
+static void ilglMeasureItem(const ILGLcommand* command, LGLsize record_index, ILGLrect* bounds) {
+	const ILGLdrawstate* state = &command->state;
+	ILGLdraw draw;
+	LGLuint instance;
+
+	if (command->type == ILGL_COMMAND_CLEAR) {
+		ilglScissorRect(state, bounds);
+		return;
+	}
+
+	ilglEmptyRect(bounds);
+	ilglBeginDraw(&draw, state);
+	draw.bounds = bounds;
+	if (command->type == ILGL_COMMAND_DRAW) {
+		for (instance = 0; instance < command->instances; instance++) {
+			draw.vsin.instance = instance;
+			ilglAssemble(&draw, command->draw_type);
+		}
+		return;
+	}
+	draw.vsin.divisors = ilglNoDivisors;
+	ilglBeginRecord(&draw, state, &command->records[record_index]);
+	ilglAssemble(&draw, command->records[record_index].type);
+}
+
+static void ilglMarkTiles(LGLbyte* mask, LGLuint tiles_x, const ILGLrect* rect) {
+	ILGLrect tiles;
+	LGLint x, y;
+
+	ilglTileRange(rect, &tiles);
+	for (y = tiles.miny; y <= tiles.maxy; y++) {
+		for (x = tiles.minx; x <= tiles.maxx; x++) {
+			mask[y * tiles_x + x] = 1;
+		}
+	}
+}
+
+/*
+ * Executes and frees the commands of a frame, rasterizing only the tiles written by items that differ from
+ * the history. Items are matched by position, items past the end of the shorter frame count as changed.
+ * Returns 0 without executing anything if the frame is not eligible or memory runs out.
+ */
+static LGLint ilglExecuteFrame(ILGLhistory* history, ILGLcommand* commands, LGLsize count) {
+	const LGLFramebufferinfo* fbinfo;
+	ILGLdrawkey* keys;
+	ILGLrect* bounds;
+	LGLbyte* mask = NULL;
+	LGLsize i, j, item, num_items = 0;
+	LGLuint tiles_x, tiles_y;
+
+	if (count == 0) {
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		if ((commands[i].type != ILGL_COMMAND_CLEAR && commands[i].type != ILGL_COMMAND_DRAW
+				&& commands[i].type != ILGL_COMMAND_MULTIDRAW) || commands[i].state.query != NULL
+				|| commands[i].state.condition != NULL) {
+			return 0;
+		}
+		num_items += ilglCountItems(&commands[i]);
+	}
+	fbinfo = commands[0].state.fbinfo;
+	tiles_x = (fbinfo->width + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+	tiles_y = (fbinfo->height + ILGL_TILE_SIZE - 1) / ILGL_TILE_SIZE;
+
+	keys = malloc(sizeof(ILGLdrawkey) * (num_items ? num_items : 1));
+	bounds = malloc(sizeof(ILGLrect) * (num_items ? num_items : 1));
+	if (history->valid) {
+		mask = calloc(tiles_x * tiles_y, 1);
+	}
+	if (keys == NULL || bounds == NULL || (history->valid && mask == NULL)) {
+		free(keys);
+		free(bounds);
+		free(mask);
+		return 0;
+	}
+
+	/* unchanged items keep their bounds, only the others are shaded a second time */
+	for (i = 0, item = 0; i < count; i++) {
+		for (j = 0; j < ilglCountItems(&commands[i]); j++, item++) {
+			ilglMakeKey(&commands[i], j, &keys[item]);
+			if (mask != NULL && item < history->num_items
+					&& memcmp(&keys[item], &history->keys[item], sizeof(ILGLdrawkey)) == 0) {
+				bounds[item] = history->bounds[item];
+				continue;
+			}
+			ilglMeasureItem(&commands[i], j, &bounds[item]);
+			if (mask != NULL) {
+				ilglMarkTiles(mask, tiles_x, &bounds[item]);
+				if (item < history->num_items) {
+					ilglMarkTiles(mask, tiles_x, &history->bounds[item]);
+				}
+			}
+		}
+	}
+	for (item = num_items; mask != NULL && item < history->num_items; item++) {
+		ilglMarkTiles(mask, tiles_x, &history->bounds[item]);
+	}
+
+	for (i = 0, item = 0; i < count; i++) {
+		commands[i].state.mask = mask;
+		commands[i].state.bounds = &bounds[item];
+		item += ilglCountItems(&commands[i]);
+		ilglExecuteCommand(&commands[i]);
+		ilglFreeCommand(&commands[i]);
+	}
+	free(mask);
+
+	ilglFreeHistory(history);
+	history->keys = keys;
+	history->bounds = bounds;
+	history->num_items = num_items;
+	history->valid = 1;
+	return 1;
+}
+
+static void ilglExecuteBatch(ILGLbatch* batch) {
+	if (batch->incremental && ilglExecuteFrame(batch->history, batch->commands, batch->num_commands)) {
+		return;
+	}
+	batch->history->valid = 0;
+	ilglExecuteCommands(batch->commands, batch->num_commands);
+}
+
+static void ilglFreeHistory(ILGLhistory* history) {
+	free(history->keys);
+	free(history->bounds);
+	history->keys = NULL;
+	history->bounds = NULL;
+	history->num_items = 0;
+	history->valid = 0;
+}
+
+/* appends the command to the ones recorded for the next flush */
+static LGLint ilglRecordCommand(LGLcontext* context, ILGLcommand* command) {
+	ILGLcommand* commands;
+	LGLdrawrecord* records;
+
+	if (context->num_commands == context->max_commands) {
+		const LGLsize max_commands = context->max_commands ? context->max_commands * 2 : 64;
+		commands = realloc(context->commands, sizeof(ILGLcommand) * max_commands);
+		if (commands == NULL) {
+			return 0;
+		}
+		context->commands = commands;
+		context->max_commands = max_commands;
+	}
+
+	/* the application may reuse its record array as soon as lglMultiDrawIndexed returns */
+	if (command->type == ILGL_COMMAND_MULTIDRAW) {
+		records = malloc(sizeof(LGLdrawrecord) * command->num_records);
+		if (records == NULL) {
+			return 0;
+		}
+		memcpy(records, command->records, sizeof(LGLdrawrecord) * command->num_records);
+		command->records = records;
+		command->owns_records = 1;
+	}
+
+	context->commands[context->num_commands++] = *command;
+	return 1;
+}
+
+/* executes the command right away or, for contexts with a render thread, records it for the next flush */
+static void ilglSubmitCommand(LGLcontext* context, ILGLcommand* command) {
+	if (context->threaded) {
+		if (ilglRecordCommand(context, command)) {
+			return;
+		}
+		lglFinish(context); /* out of memory, execute on this thread */
+		context->invalid_buffers |= 1 << context->back_buffer;
+	}
+	ilglExecuteCommand(command);
+	ilglFreeCommand(command);
+}
+
+/*
+ *  Drawing functions
+ */
+
+/* transforms the corners of an object space box to clip space, w is the fourth row of the transform */
+static void ilglTransformBox(const LGLm4x4f* transform, const LGLv3f* min, const LGLv3f* max, LGLv4f* corners) {
+	LGLuint i;
+
+	for (i = 0; i < 8; i++) {
+		const LGLfloat x = (i & 1) ? max->x : min->x;
+		const LGLfloat y = (i & 2) ? max->y : min->y;
+		const LGLfloat z = (i & 4) ? max->z : min->z;
+		corners[i].x = transform->m11 * x + transform->m12 * y + transform->m13 * z + transform->m14;
+		corners[i].y = transform->m21 * x + transform->m22 * y + transform->m23 * z + transform->m24;
+		corners[i].z = transform->m31 * x + transform->m32 * y + transform->m33 * z + transform->m34;
+		corners[i].w = transform->m41 * x + transform->m42 * y + transform->m43 * z + transform->m44;
+	}
+}
+
+/* returns 1 if all corners are beyond the same plane of the clip volume -w <= x, y, z <= w */
+static LGLint ilglBoxOutside(const LGLm4x4f* transform, const LGLv3f* min, const LGLv3f* max) {
+	LGLv4f corners[8];
+	LGLuint i, outside = 0x3f;
+
+	ilglTransformBox(transform, min, max, corners);
+	for (i = 0; i < 8 && outside != 0; i++) {
+		const LGLv4f* c = &corners[i];
+		outside &= (c->x < -c->w) | (c->x > c->w) << 1 | (c->y < -c->w) << 2 | (c->y > c->w) << 3
+				| (c->z < -c->w) << 4 | (c->z > c->w) << 5;
+	}
+	return outside != 0;
+}
+
+void lglViewport(LGLcontext* context, LGLint x, LGLint y, LGLsize width, LGLsize height) {
+	assert(context != NULL);
+	context->vport_x = x;
+	context->vport_y = y;
+	context->vport_width = width;
+	context->vport_height = height;
+}
+
+void lglScissor(LGLcontext* context, LGLint x, LGLint y, LGLsize width, LGLsize height) {
+	assert(context != NULL);
+	context->scissor_x = x;
+	context->scissor_y = y;
+	context->scissor_width = width;
+	context->scissor_height = height;
+}
+
+void lglSetDrawBounds(LGLcontext* context, const LGLm4x4f* transform, const LGLv3f* min, const LGLv3f* max) {
+	assert(context != NULL);
+	assert(transform == NULL || (min != NULL && max != NULL));
+	context->has_bounds = transform != NULL;
+	if (transform != NULL) {
+		context->bounds_transform = *transform;
+		context->bounds_min = *min;
+		context->bounds_max = *max;
+	}
+}
+
+void lglClear(LGLcontext* context, LGLclear clear/*, LGLpixel pixel*/) {
+	ILGLcommand command;
+	assert(context != NULL);
+	ilglCaptureState(context, ILGL_COMMAND_CLEAR, &command);
+	command.clear = clear;
+	ilglSubmitCommand(context, &command);
+}
+
+void lglDrawIndexed(LGLcontext* context, LGLdrawtype type) {
+	lglDrawIndexedInstanced(context, type, 1);
+}
+
+void lglDrawIndexedInstanced(LGLcontext* context, LGLdrawtype type, LGLsize instances) {
+	ILGLcommand command;
+	LGLuint i;
+
+	assert(context != NULL);
+	assert(context->vertex_stream != NULL);
+	assert(context->index_stream != NULL);
+	assert(context->vertex_shader != NULL);
+	assert(context->fragment_shader != NULL);
+
+	/* per instance streams must hold an element for every instance they are stepped to */
+	for (i = 0; i < LGL_MAX_ATTRIBUTES; i++) {
+		assert(context->attribute_block->divisors[i] == 0 || instances == 0
+				|| (instances - 1) / context->attribute_block->divisors[i] < context->attribute_block->num_attributes[i]);
+	}
+
+	if (context->has_bounds
+			&& ilglBoxOutside(&context->bounds_transform, &context->bounds_min, &context->bounds_max)) {
+		return;
+	}
+
+	ilglCaptureState(context, ILGL_COMMAND_DRAW, &command);
+	command.draw_type = type;
+	command.instances = instances;
+	ilglSubmitCommand(context, &command);
+}
+
+static LGLint ilglRecordOutside(const LGLdrawrecord* record) {
+	return record->bounds_transform != NULL
+			&& ilglBoxOutside(record->bounds_transform, &record->bounds_min, &record->bounds_max);
+}
+
+void lglMultiDrawIndexed(LGLcontext* context, const LGLdrawrecord* records, LGLsize count) {
+	ILGLcommand command;
+	LGLdrawrecord* visible = NULL;
+	LGLsize i, num_visible;
+
+	assert(context != NULL);
+	assert(records != NULL || count == 0);
+
+	/* the visible records are copied only if some are dropped, without memory all are drawn */
+	for (num_visible = 0; num_visible < count && !ilglRecordOutside(&records[num_visible]); num_visible++)
+		;
+	if (num_visible < count) {
+		visible = malloc(sizeof(LGLdrawrecord) * count);
+	}
+	if (visible != NULL) {
+		memcpy(visible, records, sizeof(LGLdrawrecord) * num_visible);
+		for (i = num_visible + 1; i < count; i++) {
+			if (!ilglRecordOutside(&records[i])) {
+				visible[num_visible++] = records[i];
+			}
+		}
+		if (num_visible == 0) {
+			free(visible);
+			return;
+		}
+		records = visible;
+		count = num_visible;
+	}
+
+	ilglCaptureState(context, ILGL_COMMAND_MULTIDRAW, &command);
+	command.records = records;
+	command.num_records = count;
+	ilglSubmitCommand(context, &command); /* recorded commands own a copy of the records */
+	free(visible);
+}
+
+/*
+ *  Query functions
+ */
+
+LGLquery* lglCreateQuery(LGLcontext* context) {
+	assert(context != NULL);
+	return calloc(1, sizeof(LGLquery));
+}
+
+void lglDestroyQuery(LGLcontext* context, LGLquery* query) {
+	assert(context != NULL);
+	assert(query != NULL);
+	assert(context->query != query && context->condition != query);
+	lglFinish(context); /* pending commands may still reference the query */
+	free(query);
+}
+
+void lglBeginQuery(LGLcontext* context, LGLquery* query) {
+	ILGLcommand command;
+
+	assert(context != NULL);
+	assert(query != NULL);
+	assert(context->query == NULL);
+	assert(context->condition != query);
+
+	context->query = query;
+	ilglCaptureState(context, ILGL_COMMAND_BEGIN_QUERY, &command);
+	ilglSubmitCommand(context, &command);
+}
+
+void lglEndQuery(LGLcontext* context) {
+	assert(context != NULL);
+	assert(context->query != NULL);
+
+	/* the query's last command executes with the next flush, or executed with the previous one */
+	context->query->fence = context->submitted + (context->num_commands != 0);
+	context->query = NULL;
+}
+
+LGLint lglQueryResultAvailable(LGLcontext* context, const LGLquery* query) {
+	assert(context != NULL);
+	assert(query != NULL);
+	assert(context->query != query);
+
+	if (!ilglFenceReached(context->submitted, query->fence)) {
+		lglFlush(context);
+	}
+	return lglFenceSignaled(context, query->fence);
+}
+
+LGLuint lglGetQueryResult(LGLcontext* context, const LGLquery* query) {
+	assert(context != NULL);
+	assert(query != NULL);
+	assert(context->query != query);
+
+	if (!ilglFenceReached(context->submitted, query->fence)) {
+		lglFlush(context);
+	}
+	lglWaitFence(context, query->fence);
+	return __atomic_load_n(&query->samples, __ATOMIC_ACQUIRE);
+}
+
+void lglBeginConditionalDraw(LGLcontext* context, LGLquery* query) {
+	assert(context != NULL);
+	assert(query != NULL);
+	assert(context->query != query);
+	context->condition = query;
+}
+
+void lglEndConditionalDraw(LGLcontext* context) {
+	assert(context != NULL);
+	context->condition = NULL;
+}
+
+void lglDrawBoundingBox(LGLcontext* context, const LGLm4x4f* transform, const LGLv3f* min, const LGLv3f* max) {
+	ILGLcommand command;
+	LGLv4f corners[8];
+	LGLuint i;
+
+	assert(context != NULL);
+	assert(transform != NULL);
+	assert(min != NULL && max != NULL);
+
+	ilglCaptureState(context, ILGL_COMMAND_BOUNDS, &command);
+	ilglTransformBox(transform, min, max, corners);
+	for (i = 0; i < 8; i++) {
+		LGLv3f* corner = &command.corners[i];
+		LGLfloat w = corners[i].w;
+
+		/* the box reaches the eye plane, its projection is unbounded */
+		if (w <= 0.0f) {
+			command.crosses_eye = 1;
+			break;
+		}
+		w = 1.0f / w;
+		corner->x = corners[i].x * w;
+		corner->y = corners[i].y * w;
+		/* keep the box inside the depth range so clipping never hides it */
+		corner->z = corners[i].z * w;
+		corner->z = corner->z < -1.0f ? -1.0f : corner->z > 1.0f ? 1.0f : corner->z;
 	}
+	ilglSubmitCommand(context, &command);
 }
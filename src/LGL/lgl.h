@@ -13,6 +13,7 @@
 #define LGL_MAX_UNIFORMS      16
 #define LGL_MAX_ATTRIBUTES     8
 #define LGL_MAX_VARYINGS       8
+#define LGL_MAX_BUFFERS        3
 
 typedef unsigned int LGLuint;
 typedef int LGLint;
@@ -23,6 +24,7 @@ typedef float LGLfloat;
 typedef unsigned int LGLsize;
 typedef void* LGLdata;
 typedef unsigned int LGLtexel;
+typedef unsigned int LGLfence;
 
 typedef struct LGLcolor_s {
 	LGLfloat r, g, b, a;
@@ -94,30 +96,50 @@ typedef union LGLattribute_u {
 	LGLv2f* v2;
 	LGLv3f* v3;
 	LGLv4f* v4;
+	LGLm4x4f* m4x4;
 } LGLattribute;
 
+typedef enum LGLindextype_e {
+	LGL_INDEX_TYPE_UINT, LGL_INDEX_TYPE_USHORT
+} LGLindextype;
+
+/* Shader inputs reference the context's binding blocks, they are never copied per draw. */
+
 typedef struct LGLvsin_s {
-	LGLuint       index;
-	LGLv3f*       vertex_stream;
-	LGLsize       vertex_stream_elements;
-	LGLuint*      index_stream;
-	LGLsize       index_stream_elements;
-	LGLtexture    textures[LGL_MAX_TEXTURES];
-	LGLuniform    uniforms[LGL_MAX_UNIFORMS];
-	LGLattribute  attributes[LGL_MAX_ATTRIBUTES];
-	LGLsize       num_attributes[LGL_MAX_ATTRIBUTES];
+	LGLuint              index;
+	LGLuint              instance;
+	LGLv3f*              vertex_stream;
+	LGLsize              vertex_stream_elements;
+	LGLdata              index_stream;
+	LGLindextype         index_type;
+	LGLsize              index_stream_elements;
+	const LGLtexture*    textures;
+	const LGLuniform*    uniforms;
+	const LGLattribute*  attributes;
+	const LGLsize*       num_attributes;
+	const LGLuint*       divisors;
 } LGLvsin;
 
+/* Element of attribute stream I for the vertex being shaded. Streams with a divisor step once every divisor instances. */
+#define LGL_ATTRIBUTE_ELEMENT(IN, I) ((IN)->divisors[I] ? (IN)->instance / (IN)->divisors[I] : (IN)->index)
+
 typedef struct LGLvsout_s {
 	LGLv3f position;
 	LGLvarying varyings[LGL_MAX_VARYINGS];
 } LGLvsout;
 
+/* Varyings written by a vertex shader: slots 0 to num_varyings - 1, each with 1 to 4 floats */
+
+typedef struct LGLvaryinglayout_s {
+	LGLuint num_varyings;
+	LGLuint components[LGL_MAX_VARYINGS];
+} LGLvaryinglayout;
+
 typedef struct LGLfsin_s {
 	LGLfloat a, b, c;
 	LGLvarying varyings[3][LGL_MAX_VARYINGS];
-	LGLtexture textures[LGL_MAX_TEXTURES];
-	LGLuniform uniforms[LGL_MAX_UNIFORMS];
+	const LGLtexture* textures;
+	const LGLuniform* uniforms;
 } LGLfsin;
 
 typedef struct LGLfsout_s {
@@ -128,12 +150,22 @@ typedef enum LGLclear_e {
 	LGL_CLEAR_FRAMEBUFFER = 1, LGL_CLEAR_ZBUFFER = 2
 } LGLclear;
 
+typedef enum LGLstate_e {
+	LGL_STATE_DEPTH_TEST = 1,
+	LGL_STATE_DEPTH_WRITE = 2,
+	LGL_STATE_PRIMITIVE_RESTART = 4,
+	LGL_STATE_SCISSOR_TEST = 8,
+	LGL_STATE_INCREMENTAL = 16
+} LGLstate;
+
 typedef enum LGLsourceformat_e {
 	LGL_SOURCE_FORMAT_V2F, LGL_SOURCE_FORMAT_V3F, LGL_SOURCE_FORMAT_V3UI
 } LGLsourceformat;
 
+/* With LGL_STATE_PRIMITIVE_RESTART enabled the largest value of the index type starts a new strip, fan or list */
+
 typedef enum LGLdrawtype_e {
-	LGL_DRAW_TYPE_TRIANGLE_LIST
+	LGL_DRAW_TYPE_TRIANGLE_LIST, LGL_DRAW_TYPE_TRIANGLE_STRIP, LGL_DRAW_TYPE_TRIANGLE_FAN
 } LGLdrawtype;
 
 typedef struct LGLFramebufferinfo_s {
@@ -147,14 +179,100 @@ typedef struct LGLFramebufferinfo_s {
 typedef void (*LGLvertexshader)(LGLvsout* out, const LGLvsin* in);
 typedef void (*LGLfragmentshader)(LGLfsout* out, const LGLfsin* in);
 
+/*
+ * One draw of lglMultiDrawIndexed, indices first_index to first_index + index_count - 1 are drawn.
+ * NULL textures, uniforms and varying_layout use the state bound to the context. A record with a
+ * bounds_transform is dropped when its box is outside the clip volume, see lglSetDrawBounds. With
+ * LGL_STATE_DEPTH_TEST enabled the records are drawn grouped by shaders and textures, not in submission
+ * order, so fragments at equal depth resolve in the grouped order. Without the depth test they are drawn in
+ * submission order.
+ */
+
+typedef struct LGLdrawrecord_s {
+	LGLdrawtype              type;
+	LGLvertexshader          vertex_shader;
+	LGLfragmentshader        fragment_shader;
+	const LGLvaryinglayout*  varying_layout;
+	const LGLtexture*        textures;
+	const LGLuniform*        uniforms;
+	LGLv3f*                  vertex_stream;
+	LGLsize                  vertex_stream_elements;
+	LGLdata                  index_stream;
+	LGLindextype             index_type;
+	LGLsize                  first_index;
+	LGLsize                  index_count;
+	LGLattribute             attributes[LGL_MAX_ATTRIBUTES];
+	LGLsize                  num_attributes[LGL_MAX_ATTRIBUTES];
+	const LGLm4x4f*          bounds_transform;
+	LGLv3f                   bounds_min;
+	LGLv3f                   bounds_max;
+} LGLdrawrecord;
+
 typedef struct LGLcontext_s LGLcontext;
+typedef struct LGLjobsystem_s LGLjobsystem;
+typedef struct LGLquery_s LGLquery;
 
 /* Context functions */
 
 LGLcontext* lglCreateContext(const LGLFramebufferinfo* fbinfo);
+LGLcontext* lglCreateBufferedContext(const LGLFramebufferinfo* fbinfo, LGLuint buffers);
 LGLFramebufferinfo* lglGetFBInfo(LGLcontext* context);
 void lglDestroyContext(LGLcontext* context);
 
+/*
+ * Job system functions, see lgljob.h
+ *
+ * With a job system set, commands split clears, vertex shading, binning and tile rasterization into jobs.
+ * Without one, the default, they execute on the thread executing the command.
+ * A job system must outlive the contexts using it.
+ */
+
+void lglSetJobSystem(LGLcontext* context, LGLjobsystem* jobs);
+LGLjobsystem* lglGetJobSystem(LGLcontext* context);
+
+/*
+ * Synchronization functions
+ *
+ * Contexts created by lglCreateContext execute every command before it returns. Buffered contexts record
+ * commands and hand them to a render thread on flush. Streams, textures and draw record uniforms are read
+ * when a command executes, the application must keep them unchanged until the command's fence is signaled.
+ */
+
+void lglFlush(LGLcontext* context);
+void lglFinish(LGLcontext* context);
+LGLfence lglFence(LGLcontext* context);
+LGLint lglFenceSignaled(LGLcontext* context, LGLfence fence);
+void lglWaitFence(LGLcontext* context, LGLfence fence);
+
+/*
+ * Buffer functions
+ *
+ * Buffered contexts render into one of their own buffers, see lglGetFBInfo. lglSwapBuffers submits the
+ * frame and moves on to the next buffer. lglGetFrontBuffer waits for the frame submitted by the previous
+ * swap and returns its buffer, it stays valid until the next flush.
+ */
+
+LGLfence lglSwapBuffers(LGLcontext* context);
+const LGLFramebufferinfo* lglGetFrontBuffer(LGLcontext* context);
+
+/*
+ * With LGL_STATE_INCREMENTAL enabled at lglSwapBuffers, a buffered context compares the frame's clears and
+ * draws with the ones last rendered into the same buffer. Only tiles touched by clears and draws that differ
+ * are cleared and rasterized, all other tiles keep their pixels. Draws are compared by state, shaders,
+ * stream pointers, index ranges and the bound textures, uniforms and attributes, but not by the data these
+ * point to. After modifying vertices, indices, attributes, texels or record uniforms in place, call
+ * lglInvalidateBuffers to render the next frames in full.
+ * Frames flushed before lglSwapBuffers, and frames with queries or conditional draws, are always rendered
+ * in full.
+ */
+
+void lglInvalidateBuffers(LGLcontext* context);
+
+/* State functions */
+
+void lglEnable(LGLcontext* context, LGLstate state);
+void lglDisable(LGLcontext* context, LGLstate state);
+
 /* Texture functions */
 
 void lglSetTextureData2d(LGLcontext* context, LGLuint index, LGLtexel* data, LGLuint width, LGLuint height);
@@ -172,6 +290,7 @@ void lglSetUniformm4x4f(LGLcontext* context, LGLuint index, const LGLm4x4f* v);
 
 void lglSetVertexStream(LGLcontext* context, LGLv3f vertices[], LGLsize elems);
 void lglSetIndexStream(LGLcontext* context, LGLuint indices[], LGLsize elems);
+void lglSetIndexStreamus(LGLcontext* context, LGLushort indices[], LGLsize elems);
 
 /* Vertex attribute functions */
 
@@ -179,16 +298,56 @@ void lglSetVertexAttribsf(LGLcontext* context, LGLuint index, LGLfloat* v, LGLsi
 void lglSetVertexAttribsv2f(LGLcontext* context, LGLuint index, LGLv2f* v, LGLsize elems);
 void lglSetVertexAttribsv3f(LGLcontext* context, LGLuint index, LGLv3f* v, LGLsize elems);
 void lglSetVertexAttribsv4f(LGLcontext* context, LGLuint index, LGLv4f* v, LGLsize elems);
+void lglSetVertexAttribsm4x4f(LGLcontext* context, LGLuint index, LGLm4x4f* v, LGLsize elems);
+void lglSetVertexAttribDivisor(LGLcontext* context, LGLuint index, LGLuint divisor);
 
 /* Shader function */
 
 void lglSetVertexShader(LGLcontext* context, LGLvertexshader vsproc);
 void lglSetFragmentShader(LGLcontext* context, LGLfragmentshader fsproc);
+void lglSetVaryingLayout(LGLcontext* context, const LGLvaryinglayout* layout);
+
+/*
+ * Draw functions
+ *
+ * Viewport and scissor rectangles are given in framebuffer pixels. Draws write only inside the viewport,
+ * with LGL_STATE_SCISSOR_TEST enabled clears and draws write only inside the scissor rectangle as well.
+ *
+ * lglSetDrawBounds gives the object space box of the following draws, including all instances, and the
+ * transform the vertex shader applies to reach clip space, before it divides by w. A draw whose transformed
+ * box lies outside the clip volume -w <= x, y, z <= w is dropped when it is issued, before any vertex is
+ * shaded. A NULL transform disables the test. The bounds are copied, the transform of a record only needs to be valid during the
+ * lglMultiDrawIndexed call.
+ */
+
+void lglViewport(LGLcontext* context, LGLint x, LGLint y, LGLsize width, LGLsize height);
+void lglScissor(LGLcontext* context, LGLint x, LGLint y, LGLsize width, LGLsize height);
+void lglSetDrawBounds(LGLcontext* context, const LGLm4x4f* transform, const LGLv3f* min, const LGLv3f* max);
+void lglClear(LGLcontext* context, LGLclear clear);
+void lglDrawIndexed(LGLcontext* context, LGLdrawtype type);
+void lglDrawIndexedInstanced(LGLcontext* context, LGLdrawtype type, LGLsize instances);
+void lglMultiDrawIndexed(LGLcontext* context, const LGLdrawrecord records[], LGLsize count);
 
-/* Draw functions */
+/*
+ * Query functions
+ *
+ * An occlusion query counts the samples passing the depth test in the draws issued between lglBeginQuery and
+ * lglEndQuery. Draws issued between lglBeginConditionalDraw and lglEndConditionalDraw are skipped when the
+ * query counted no samples, the result is checked when the draw executes so the application never waits.
+ * lglDrawBoundingBox is a cheap proxy for a query: it depth tests the faces of the transformed box without
+ * writing color or depth. The corners are divided by w, those outside the depth range are clamped to it, so
+ * the box is never hidden by the near or far plane. A box reaching the eye plane, w <= 0 at a corner, counts
+ * one sample without being rasterized.
+ */
 
-void lglViewport(const LGLcontext* context, LGLint x, LGLint y, LGLsize width, LGLsize height);
-void lglClear(const LGLcontext* context, LGLclear clear);
-void lglDrawIndexed(const LGLcontext* context, LGLdrawtype type);
+LGLquery* lglCreateQuery(LGLcontext* context);
+void lglDestroyQuery(LGLcontext* context, LGLquery* query);
+void lglBeginQuery(LGLcontext* context, LGLquery* query);
+void lglEndQuery(LGLcontext* context);
+LGLint lglQueryResultAvailable(LGLcontext* context, const LGLquery* query);
+LGLuint lglGetQueryResult(LGLcontext* context, const LGLquery* query);
+void lglBeginConditionalDraw(LGLcontext* context, LGLquery* query);
+void lglEndConditionalDraw(LGLcontext* context);
+void lglDrawBoundingBox(LGLcontext* context, const LGLm4x4f* transform, const LGLv3f* min, const LGLv3f* max);
 
 #endif
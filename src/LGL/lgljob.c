@@ -0,0 +1,356 @@
+/*
+ *
+ * LightGL - Job System
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ */
+
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+
+#include <stdlib.h> /* for malloc and free */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h> /* for sysconf */
+#include "lgljob.h"
+
+#define ILGL_DEQUE_CAPACITY 256
+
+typedef struct ILGLjob_s {
+	LGLjobproc proc;
+	void* data;
+	LGLuint index;
+	LGLjobgroup* group;
+} ILGLjob;
+
+/* ring buffer, the owner pushes and pops at the bottom, thieves take from the top */
+typedef struct ILGLdeque_s {
+	pthread_mutex_t lock;
+	ILGLjob* jobs;
+	LGLuint top, bottom; /* bottom - top jobs are queued */
+	LGLuint capacity; /* power of two */
+} ILGLdeque;
+
+typedef struct ILGLworker_s {
+	LGLjobsystem* jobs;
+	LGLuint index;
+	pthread_t thread;
+} ILGLworker;
+
+struct LGLjobsystem_s {
+	LGLuint num_workers;
+	LGLuint num_threads; /* workers started so far */
+	ILGLworker* workers;
+	ILGLdeque* deques; /* one per worker plus one for jobs submitted by other threads */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; /* broadcast when jobs are queued, a group completes or the workers quit */
+	LGLint queued;
+	LGLint quit;
+};
+
+/* the worker running on this thread, NULL for application threads */
+static __thread ILGLworker* ilglCurrentWorker;
+
+/*
+ *  Deque functions
+ */
+
+static LGLint ilglInitDeque(ILGLdeque* deque) {
+	deque->jobs = malloc(sizeof(ILGLjob) * ILGL_DEQUE_CAPACITY);
+	if (deque->jobs == NULL) {
+		return 0;
+	}
+	deque->top = deque->bottom = 0;
+	deque->capacity = ILGL_DEQUE_CAPACITY;
+	pthread_mutex_init(&deque->lock, NULL);
+	return 1;
+}
+
+static void ilglFreeDeque(ILGLdeque* deque) {
+	assert(deque->top == deque->bottom);
+	pthread_mutex_destroy(&deque->lock);
+	free(deque->jobs);
+}
+
+/* doubles the capacity, called with the deque locked */
+static LGLint ilglGrowDeque(ILGLdeque* deque) {
+	const LGLuint count = deque->bottom - deque->top;
+	ILGLjob* jobs;
+	LGLuint i;
+
+	jobs = malloc(sizeof(ILGLjob) * deque->capacity * 2);
+	if (jobs == NULL) {
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		jobs[i] = deque->jobs[(deque->top + i) & (deque->capacity - 1)];
+	}
+	free(deque->jobs);
+	deque->jobs = jobs;
+	deque->top = 0;
+	deque->bottom = count;
+	deque->capacity *= 2;
+	return 1;
+}
+
+/* pushes jobs first to first + count - 1, returns how many fit */
+static LGLuint ilglPushJobs(ILGLdeque* deque, LGLjobproc proc, void* data, LGLjobgroup* group, LGLuint first,
+		LGLuint count) {
+	LGLuint i;
+
+	pthread_mutex_lock(&deque->lock);
+	for (i = 0; i < count; i++) {
+		if (deque->bottom - deque->top == deque->capacity && !ilglGrowDeque(deque)) {
+			break;
+		}
+		ILGLjob* job = &deque->jobs[deque->bottom & (deque->capacity - 1)];
+		job->proc = proc;
+		job->data = data;
+		job->index = first + i;
+		job->group = group;
+		deque->bottom++;
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return i;
+}
+
+static LGLint ilglPopJob(ILGLdeque* deque, ILGLjob* job) {
+	LGLint found = 0;
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom != deque->top) {
+		deque->bottom--;
+		*job = deque->jobs[deque->bottom & (deque->capacity - 1)];
+		found = 1;
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return found;
+}
+
+static LGLint ilglStealJob(ILGLdeque* deque, ILGLjob* job) {
+	LGLint found = 0;
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom != deque->top) {
+		*job = deque->jobs[deque->top & (deque->capacity - 1)];
+		deque->top++;
+		found = 1;
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return found;
+}
+
+/*
+ *  Scheduling functions
+ */
+
+/* index of the calling thread's deque */
+static LGLuint ilglDequeIndex(const LGLjobsystem* jobs) {
+	if (ilglCurrentWorker != NULL && ilglCurrentWorker->jobs == jobs) {
+		return ilglCurrentWorker->index;
+	}
+	return jobs->num_workers;
+}
+
+/* takes a job from the own deque first, then from the shared one, then from the other workers */
+static LGLint ilglFindJob(LGLjobsystem* jobs, LGLuint self, ILGLjob* job) {
+	const LGLuint num_deques = jobs->num_workers + 1;
+	LGLuint i;
+
+	if (self < jobs->num_workers && ilglPopJob(&jobs->deques[self], job)) {
+		__atomic_sub_fetch(&jobs->queued, 1, __ATOMIC_RELAXED);
+		return 1;
+	}
+	if (ilglStealJob(&jobs->deques[jobs->num_workers], job)) {
+		__atomic_sub_fetch(&jobs->queued, 1, __ATOMIC_RELAXED);
+		return 1;
+	}
+	for (i = 1; i < num_deques; i++) {
+		const LGLuint victim = (self + i) % num_deques;
+		if (victim != jobs->num_workers && ilglStealJob(&jobs->deques[victim], job)) {
+			__atomic_sub_fetch(&jobs->queued, 1, __ATOMIC_RELAXED);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void ilglExecuteJob(LGLjobsystem* jobs, const ILGLjob* job) {
+	job->proc(job->data, job->index);
+	if (__atomic_sub_fetch(&job->group->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+		pthread_mutex_lock(&jobs->mutex);
+		pthread_cond_broadcast(&jobs->cond);
+		pthread_mutex_unlock(&jobs->mutex);
+	}
+}
+
+static void ilglSetAffinity(pthread_t thread, LGLuint processor) {
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor, &set);
+	pthread_setaffinity_np(thread, sizeof(cpu_set_t), &set);
+#else
+	(void) thread;
+	(void) processor;
+#endif
+}
+
+static void* ilglWorkerThread(void* arg) {
+	ILGLworker* worker = arg;
+	LGLjobsystem* jobs = worker->jobs;
+	ILGLjob job;
+
+	ilglCurrentWorker = worker;
+	for (;;) {
+		if (ilglFindJob(jobs, worker->index, &job)) {
+			ilglExecuteJob(jobs, &job);
+			continue;
+		}
+		pthread_mutex_lock(&jobs->mutex);
+		while (__atomic_load_n(&jobs->queued, __ATOMIC_RELAXED) <= 0 && !jobs->quit) {
+			pthread_cond_wait(&jobs->cond, &jobs->mutex);
+		}
+		if (jobs->quit) {
+			pthread_mutex_unlock(&jobs->mutex);
+			break;
+		}
+		pthread_mutex_unlock(&jobs->mutex);
+	}
+	return NULL;
+}
+
+/*
+ *  Job system functions
+ */
+
+LGLjobsystem* lglCreateJobSystem(LGLuint workers, LGLjobaffinity affinity, LGLuint first_processor) {
+	LGLjobsystem* jobs;
+	LGLuint i, processors;
+
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	processors = online > 0 ? (LGLuint) online : 1;
+	if (workers == 0) {
+		workers = processors;
+	}
+
+	jobs = calloc(1, sizeof(LGLjobsystem));
+	if (jobs == NULL) {
+		return NULL;
+	}
+	jobs->workers = calloc(workers, sizeof(ILGLworker));
+	jobs->deques = calloc(workers + 1, sizeof(ILGLdeque));
+	if (jobs->workers == NULL || jobs->deques == NULL) {
+		free(jobs->workers);
+		free(jobs->deques);
+		free(jobs);
+		return NULL;
+	}
+	jobs->num_workers = workers;
+	pthread_mutex_init(&jobs->mutex, NULL);
+	pthread_cond_init(&jobs->cond, NULL);
+
+	for (i = 0; i <= workers; i++) {
+		if (!ilglInitDeque(&jobs->deques[i])) {
+			lglDestroyJobSystem(jobs);
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < workers; i++) {
+		ILGLworker* worker = &jobs->workers[i];
+		worker->jobs = jobs;
+		worker->index = i;
+		if (pthread_create(&worker->thread, NULL, ilglWorkerThread, worker) != 0) {
+			lglDestroyJobSystem(jobs);
+			return NULL;
+		}
+		jobs->num_threads++;
+		if (affinity == LGL_JOB_AFFINITY_PIN) {
+			ilglSetAffinity(worker->thread, (first_processor + i) % processors);
+		}
+	}
+
+	return jobs;
+}
+
+void lglDestroyJobSystem(LGLjobsystem* jobs) {
+	LGLuint i;
+	assert(jobs != NULL);
+
+	pthread_mutex_lock(&jobs->mutex);
+	jobs->quit = 1;
+	pthread_cond_broadcast(&jobs->cond);
+	pthread_mutex_unlock(&jobs->mutex);
+	for (i = 0; i < jobs->num_threads; i++) {
+		pthread_join(jobs->workers[i].thread, NULL);
+	}
+
+	for (i = 0; i <= jobs->num_workers; i++) {
+		if (jobs->deques[i].jobs != NULL) { /* not initialized if creation failed */
+			ilglFreeDeque(&jobs->deques[i]);
+		}
+	}
+	pthread_mutex_destroy(&jobs->mutex);
+	pthread_cond_destroy(&jobs->cond);
+	free(jobs->workers);
+	free(jobs->deques);
+	free(jobs);
+}
+
+LGLuint lglGetJobWorkers(const LGLjobsystem* jobs) {
+	assert(jobs != NULL);
+	return jobs->num_workers;
+}
+
+/*
+ *  Job functions
+ */
+
+void lglRunJobs(LGLjobsystem* jobs, LGLjobgroup* group, LGLjobproc proc, void* data, LGLuint count) {
+	LGLuint pushed;
+	ILGLjob job;
+
+	assert(jobs != NULL);
+	assert(group != NULL);
+	assert(proc != NULL);
+
+	if (count == 0) {
+		return;
+	}
+	__atomic_add_fetch(&group->pending, count, __ATOMIC_RELAXED);
+	pushed = ilglPushJobs(&jobs->deques[ilglDequeIndex(jobs)], proc, data, group, 0, count);
+
+	pthread_mutex_lock(&jobs->mutex);
+	__atomic_add_fetch(&jobs->queued, (LGLint) pushed, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(&jobs->cond);
+	pthread_mutex_unlock(&jobs->mutex);
+
+	/* out of memory, the jobs that did not fit run on this thread */
+	job.proc = proc;
+	job.data = data;
+	job.group = group;
+	for (job.index = pushed; job.index < count; job.index++) {
+		ilglExecuteJob(jobs, &job);
+	}
+}
+
+void lglWaitJobs(LGLjobsystem* jobs, LGLjobgroup* group) {
+	const LGLuint self = ilglDequeIndex(jobs);
+	ILGLjob job;
+
+	assert(jobs != NULL);
+	assert(group != NULL);
+
+	while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) != 0) {
+		if (ilglFindJob(jobs, self, &job)) {
+			ilglExecuteJob(jobs, &job);
+			continue;
+		}
+		pthread_mutex_lock(&jobs->mutex);
+		while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) != 0
+				&& __atomic_load_n(&jobs->queued, __ATOMIC_RELAXED) <= 0) {
+			pthread_cond_wait(&jobs->cond, &jobs->mutex);
+		}
+		pthread_mutex_unlock(&jobs->mutex);
+	}
+}
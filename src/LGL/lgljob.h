@@ -0,0 +1,46 @@
+/*
+ *
+ * LightGL - Job System
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ */
+
+#ifndef LGLJOB_H_INCLUDED
+#define LGLJOB_H_INCLUDED
+
+#include "lgl.h"
+
+/*
+ * Work stealing job scheduler. Every worker thread owns a deque, it pushes and pops its jobs at the bottom
+ * while idle workers steal from the top. Jobs submitted by other threads go to a shared deque. A thread
+ * waiting for a job group executes queued jobs until the group is done, so jobs may submit and wait too.
+ *
+ * A context executes its clears, vertex shading, binning and tile rasterization on the job system set with
+ * lglSetJobSystem. Applications may submit their own jobs to the same job system at any time.
+ */
+
+typedef void (*LGLjobproc)(void* data, LGLuint index);
+
+/* counts the unfinished jobs of one or more lglRunJobs calls, zero it before the first call */
+typedef struct LGLjobgroup_s {
+	LGLuint pending;
+} LGLjobgroup;
+
+typedef enum LGLjobaffinity_e {
+	LGL_JOB_AFFINITY_NONE, /* the operating system places the workers */
+	LGL_JOB_AFFINITY_PIN   /* worker i runs on processor (first_processor + i) modulo the processor count */
+} LGLjobaffinity;
+
+/* Job system functions, zero workers starts one worker per online processor */
+
+LGLjobsystem* lglCreateJobSystem(LGLuint workers, LGLjobaffinity affinity, LGLuint first_processor);
+void lglDestroyJobSystem(LGLjobsystem* jobs);
+LGLuint lglGetJobWorkers(const LGLjobsystem* jobs);
+
+/* Job functions, lglRunJobs queues proc(data, 0) to proc(data, count - 1) and returns */
+
+void lglRunJobs(LGLjobsystem* jobs, LGLjobgroup* group, LGLjobproc proc, void* data, LGLuint count);
+void lglWaitJobs(LGLjobsystem* jobs, LGLjobgroup* group);
+
+#endif
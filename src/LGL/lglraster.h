@@ -0,0 +1,136 @@
+/*
+ *
+ * LightGL - Raster Loop Template
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ * This file has no include guard, lgl.c includes it once per raster variant.
+ * Define the following macros before each inclusion:
+ *
+ *   LGL_RASTER_NAME         name of the generated function
+ *   LGL_RASTER_DEPTH_TEST   1 to compare against the zbuffer, 0 to pass every fragment
+ *   LGL_RASTER_DEPTH_WRITE  1 to store the fragment depth, 0 to leave the zbuffer untouched
+ *   LGL_RASTER_FORMAT       ILGL_FORMAT_GENERIC, ILGL_FORMAT_XRGB8888 or ILGL_FORMAT_NONE to skip shading
+ *
+ * All state is resolved by the preprocessor, the pixel loop contains no state branches.
+ * Only pixels inside the clip rectangle are written, tile jobs pass the tile's rectangle.
+ * Returns the number of samples that passed the depth test, for occlusion queries.
+ */
+
+static LGLuint LGL_RASTER_NAME(const ILGLdraw* draw, LGLfsin* fsin, const ILGLrect* clip, LGLint p1x, LGLint p1y,
+		LGLfloat p1z, LGLint p2x, LGLint p2y, LGLfloat p2z, LGLint p3x, LGLint p3y, LGLfloat p3z) {
+	LGLint x, y;
+	LGLuint samples = 0;
+
+	assert(draw != NULL);
+	assert(fsin != NULL);
+	assert(clip != NULL);
+
+	const ILGLdrawstate* state = draw->state;
+#if LGL_RASTER_FORMAT != ILGL_FORMAT_NONE
+	const LGLfragmentshader fragment_shader = draw->fragment_shader;
+	LGLfsout fsout;
+#endif
+
+	LGLint bminx = ilglMin3(p1x, p2x, p3x);
+	LGLint bminy = ilglMin3(p1y, p2y, p3y);
+	LGLint bmaxx = ilglMax3(p1x, p2x, p3x);
+	LGLint bmaxy = ilglMax3(p1y, p2y, p3y);
+
+	// clip non visible triangles
+	if (bmaxx < clip->minx)
+		return 0;
+	if (bminx > clip->maxx)
+		return 0;
+	if (bmaxy < clip->miny)
+		return 0;
+	if (bminy > clip->maxy)
+		return 0;
+
+	bmaxx = ilglMin2(clip->maxx, bmaxx);
+	bmaxy = ilglMin2(clip->maxy, bmaxy);
+	bminx = ilglMax2(clip->minx, bminx);
+	bminy = ilglMax2(clip->miny, bminy);
+
+	const LGLint dx13 = p1x - p3x;
+	const LGLint dy13 = p1y - p3y;
+	const LGLint dx23 = p2x - p3x;
+	const LGLint dy23 = p2y - p3y;
+
+	const LGLint det = dx13 * dy23 - dx23 * dy13;
+	if (det == 0) /* zero area, the barycentrics would be NaN and pass every test */
+		return 0;
+	const float idett = 1.0f / det;
+
+#if LGL_RASTER_FORMAT != ILGL_FORMAT_NONE
+	unsigned int* const framebuffer = state->fbinfo->framebuffer;
+#endif
+#if LGL_RASTER_DEPTH_TEST || LGL_RASTER_DEPTH_WRITE
+	unsigned short* const zbuffer = state->fbinfo->zbuffer;
+#endif
+#if LGL_RASTER_FORMAT == ILGL_FORMAT_GENERIC
+	const LGLbyte rshift = state->fbinfo->rshift;
+	const LGLbyte gshift = state->fbinfo->gshift;
+	const LGLbyte bshift = state->fbinfo->bshift;
+#endif
+
+	for (y = bminy; y <= bmaxy; y++) {
+		const LGLint dy2 = y - p3y;
+		const LGLint dx02_dy2 = dx13 * dy2;
+		const LGLint dx12_dy2 = dx23 * dy2;
+
+		for (x = bminx; x <= bmaxx; x++) {
+			const LGLint dx2 = x - p3x;
+
+			const float l1 = (dy23 * dx2 - dx12_dy2) * idett;
+			if (l1 > 1.0f || l1 < 0.0f)
+				continue;
+
+			const float l2 = (dx02_dy2 - dy13 * dx2) * idett;
+			if (l2 > 1.0f || l2 < 0.0f)
+				continue;
+
+			const float l3 = 1.0f - l1 - l2;
+			if (l3 > 1.0f || l3 < 0.0f)
+				continue;
+
+			const LGLfloat z = l1 * p1z + l2 * p2z + l3 * p3z;
+			if(z < -1.0 || z > 1.0) /* z clipping */
+				continue;
+
+			const LGLsize offset = state->fbinfo->width * y + x;
+#if LGL_RASTER_DEPTH_TEST || LGL_RASTER_DEPTH_WRITE
+			const LGLint zdepth = (LGLint)(((z + 1.0f) * 0.5f) * 0xfffe);
+#endif
+#if LGL_RASTER_DEPTH_TEST
+			if (zdepth >= zbuffer[offset])
+				continue;
+#endif
+#if LGL_RASTER_DEPTH_WRITE
+			zbuffer[offset] = zdepth;
+#endif
+			samples++;
+#if LGL_RASTER_FORMAT != ILGL_FORMAT_NONE
+			fsin->a = l1;
+			fsin->b = l2;
+			fsin->c = l3;
+			fragment_shader(&fsout, fsin);
+
+			const unsigned int r = (unsigned int) (fsout.color.r * 255.0f) & 0xff;
+			const unsigned int g = (unsigned int) (fsout.color.g * 255.0f) & 0xff;
+			const unsigned int b = (unsigned int) (fsout.color.b * 255.0f) & 0xff;
+#if LGL_RASTER_FORMAT == ILGL_FORMAT_XRGB8888
+			framebuffer[offset] = r << 16 | g << 8 | b;
+#else
+			framebuffer[offset] = r << rshift | g << gshift | b << bshift;
+#endif
+#endif
+		}
+	}
+	return samples;
+}
+
+#undef LGL_RASTER_NAME
+#undef LGL_RASTER_DEPTH_TEST
+#undef LGL_RASTER_DEPTH_WRITE
+#undef LGL_RASTER_FORMAT
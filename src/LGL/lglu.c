@@ -7,11 +7,22 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h> /* for malloc, free and qsort */
+#include <string.h> /* for memcpy */
 #include <math.h>
 #include <float.h>
 #include <assert.h>
 #include "lglu.h"
 
+#if defined(__SSE2__) && !defined(LGLU_NO_SIMD)
+#include <emmintrin.h>
+#define LGLU_SSE 1
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LGLU_AVX 1
+#endif
+#endif
+
 /*
  *  Matrix/Vector functions
  */
@@ -231,7 +242,102 @@ void lgluMatrixSetFrustum(LGLm4x4f* m, LGLfloat left, LGLfloat right, LGLfloat b
 }
 
 void lgluMatrixSetLookAt(LGLm4x4f* m, const LGLv3f* eye, const LGLv3f* center, const LGLv3f* up) {
-	assert(!"not implemented");
+	LGLv3f f, s, u;
+	assert(m != NULL);
+	assert(eye != NULL);
+	assert(center != NULL);
+	assert(up != NULL);
+
+	/* forward, side and the up vector orthogonal to both, the eye looks down -z */
+	f.x = center->x - eye->x;
+	f.y = center->y - eye->y;
+	f.z = center->z - eye->z;
+	lgluVectorNormalize(&f);
+	s.x = f.y * up->z - f.z * up->y;
+	s.y = f.z * up->x - f.x * up->z;
+	s.z = f.x * up->y - f.y * up->x;
+	lgluVectorNormalize(&s);
+	u.x = s.y * f.z - s.z * f.y;
+	u.y = s.z * f.x - s.x * f.z;
+	u.z = s.x * f.y - s.y * f.x;
+
+	m->m11 = s.x;
+	m->m12 = s.y;
+	m->m13 = s.z;
+	m->m14 = -(s.x * eye->x + s.y * eye->y + s.z * eye->z);
+
+	m->m21 = u.x;
+	m->m22 = u.y;
+	m->m23 = u.z;
+	m->m24 = -(u.x * eye->x + u.y * eye->y + u.z * eye->z);
+
+	m->m31 = -f.x;
+	m->m32 = -f.y;
+	m->m33 = -f.z;
+	m->m34 = f.x * eye->x + f.y * eye->y + f.z * eye->z;
+
+	m->m41 = 0.0f;
+	m->m42 = 0.0f;
+	m->m43 = 0.0f;
+	m->m44 = 1.0f;
+}
+
+/*
+ * The SSE2 and AVX paths are chosen at compile time from the target flags, define LGLU_NO_SIMD to build the
+ * scalar path only. Both paths perform the same float operations in the same order, so they return the
+ * same bits unless the compiler contracts multiplies and adds into FMA instructions.
+ */
+
+static void ilgluMatrixMultiply(LGLfloat* o, const LGLfloat* a, const LGLfloat* b) {
+#if LGLU_AVX
+	/* two rows of the result per instruction, b is read completely before o is written */
+	const __m256 b1 = _mm256_broadcast_ps((const __m128*) (b + 0));
+	const __m256 b2 = _mm256_broadcast_ps((const __m128*) (b + 4));
+	const __m256 b3 = _mm256_broadcast_ps((const __m128*) (b + 8));
+	const __m256 b4 = _mm256_broadcast_ps((const __m128*) (b + 12));
+	const __m256 a12 = _mm256_loadu_ps(a + 0);
+	const __m256 a34 = _mm256_loadu_ps(a + 8);
+	__m256 r12, r34;
+
+	r12 = _mm256_mul_ps(_mm256_shuffle_ps(a12, a12, 0x00), b1);
+	r12 = _mm256_add_ps(r12, _mm256_mul_ps(_mm256_shuffle_ps(a12, a12, 0x55), b2));
+	r12 = _mm256_add_ps(r12, _mm256_mul_ps(_mm256_shuffle_ps(a12, a12, 0xaa), b3));
+	r12 = _mm256_add_ps(r12, _mm256_mul_ps(_mm256_shuffle_ps(a12, a12, 0xff), b4));
+	r34 = _mm256_mul_ps(_mm256_shuffle_ps(a34, a34, 0x00), b1);
+	r34 = _mm256_add_ps(r34, _mm256_mul_ps(_mm256_shuffle_ps(a34, a34, 0x55), b2));
+	r34 = _mm256_add_ps(r34, _mm256_mul_ps(_mm256_shuffle_ps(a34, a34, 0xaa), b3));
+	r34 = _mm256_add_ps(r34, _mm256_mul_ps(_mm256_shuffle_ps(a34, a34, 0xff), b4));
+	_mm256_storeu_ps(o + 0, r12);
+	_mm256_storeu_ps(o + 8, r34);
+#elif LGLU_SSE
+	/* row i of the result is a(i,1) * b1 + a(i,2) * b2 + a(i,3) * b3 + a(i,4) * b4 */
+	const __m128 b1 = _mm_loadu_ps(b + 0);
+	const __m128 b2 = _mm_loadu_ps(b + 4);
+	const __m128 b3 = _mm_loadu_ps(b + 8);
+	const __m128 b4 = _mm_loadu_ps(b + 12);
+	__m128 r;
+	int i;
+
+	for (i = 0; i < 16; i += 4) {
+		r = _mm_mul_ps(_mm_set1_ps(a[i + 0]), b1);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i + 1]), b2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i + 2]), b3));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i + 3]), b4));
+		_mm_storeu_ps(o + i, r);
+	}
+#else
+	LGLfloat r[16];
+	int i, j;
+
+	for (i = 0; i < 16; i += 4) {
+		for (j = 0; j < 4; j++) {
+			r[i + j] = a[i] * b[j] + a[i + 1] * b[4 + j] + a[i + 2] * b[8 + j] + a[i + 3] * b[12 + j];
+		}
+	}
+	for (i = 0; i < 16; i++) {
+		o[i] = r[i];
+	}
+#endif
 }
 
 void lgluMatrixMultiply(LGLm4x4f* o, const LGLm4x4f* m1, const LGLm4x4f* m2) {
@@ -239,106 +345,114 @@ void lgluMatrixMultiply(LGLm4x4f* o, const LGLm4x4f* m1, const LGLm4x4f* m2) {
 	assert(m1 != NULL);
 	assert(m2 != NULL);
 
-	LGLm4x4f a;
-
-	a.m11 = m1->m11 * m2->m11 + m1->m12 * m2->m21 + m1->m13 * m2->m31 + m1->m14 * m2->m41;
-	a.m12 = m1->m11 * m2->m12 + m1->m12 * m2->m22 + m1->m13 * m2->m32 + m1->m14 * m2->m42;
-	a.m13 = m1->m11 * m2->m13 + m1->m12 * m2->m23 + m1->m13 * m2->m33 + m1->m14 * m2->m43;
-	a.m14 = m1->m11 * m2->m14 + m1->m12 * m2->m24 + m1->m13 * m2->m34 + m1->m14 * m2->m44;
-
-	a.m21 = m1->m21 * m2->m11 + m1->m22 * m2->m21 + m1->m23 * m2->m31 + m1->m24 * m2->m41;
-	a.m22 = m1->m21 * m2->m12 + m1->m22 * m2->m22 + m1->m23 * m2->m32 + m1->m24 * m2->m42;
-	a.m23 = m1->m21 * m2->m13 + m1->m22 * m2->m23 + m1->m23 * m2->m33 + m1->m24 * m2->m43;
-	a.m24 = m1->m21 * m2->m14 + m1->m22 * m2->m24 + m1->m23 * m2->m34 + m1->m24 * m2->m44;
-
-	a.m31 = m1->m31 * m2->m11 + m1->m32 * m2->m21 + m1->m33 * m2->m31 + m1->m34 * m2->m41;
-	a.m32 = m1->m31 * m2->m12 + m1->m32 * m2->m22 + m1->m33 * m2->m32 + m1->m34 * m2->m42;
-	a.m33 = m1->m31 * m2->m13 + m1->m32 * m2->m23 + m1->m33 * m2->m33 + m1->m34 * m2->m43;
-	a.m34 = m1->m31 * m2->m14 + m1->m32 * m2->m24 + m1->m33 * m2->m34 + m1->m34 * m2->m44;
-
-	a.m41 = m1->m41 * m2->m11 + m1->m42 * m2->m21 + m1->m43 * m2->m31 + m1->m44 * m2->m41;
-	a.m42 = m1->m41 * m2->m12 + m1->m42 * m2->m22 + m1->m43 * m2->m32 + m1->m44 * m2->m42;
-	a.m43 = m1->m41 * m2->m13 + m1->m42 * m2->m23 + m1->m43 * m2->m33 + m1->m44 * m2->m43;
-	a.m44 = m1->m41 * m2->m14 + m1->m42 * m2->m24 + m1->m43 * m2->m34 + m1->m44 * m2->m44;
-
-	*o = a;
-}
-
-static LGLfloat ilgluDet3x3(LGLfloat a11, LGLfloat a12, LGLfloat a13, LGLfloat a21, LGLfloat a22, LGLfloat a23,
-		LGLfloat a31, LGLfloat a32, LGLfloat a33) {
-	return a11 * a22 * a33 + a12 * a23 * a31 + a13 * a21 * a32 - a13 * a22 * a31 - a12 * a12 * a33 - a11 * a23 * a32;
+	ilgluMatrixMultiply(&o->m11, &m1->m11, &m2->m11);
 }
 
-static void ilgluMatrixAdjugate(LGLm4x4f* o, const LGLm4x4f* m) {
-	assert(o != NULL);
+void lgluMatrixMultiplyArray(LGLm4x4f* d, const LGLm4x4f* m, const LGLm4x4f* v, LGLsize count) {
+	LGLsize i;
 	assert(m != NULL);
+	assert(count == 0 || (d != NULL && v != NULL));
 
-	LGLm4x4f a;
-
-	a.m11 = +ilgluDet3x3(m->m22, m->m23, m->m24, m->m32, m->m33, m->m34, m->m42, m->m43, m->m44);
-	a.m21 = -ilgluDet3x3(m->m21, m->m23, m->m24, m->m31, m->m33, m->m34, m->m41, m->m43, m->m44);
-	a.m31 = +ilgluDet3x3(m->m21, m->m22, m->m24, m->m31, m->m32, m->m34, m->m41, m->m42, m->m44);
-	a.m41 = -ilgluDet3x3(m->m21, m->m22, m->m23, m->m31, m->m32, m->m33, m->m41, m->m42, m->m43);
-
-	a.m12 = -ilgluDet3x3(m->m12, m->m13, m->m14, m->m32, m->m33, m->m34, m->m42, m->m43, m->m44);
-	a.m22 = +ilgluDet3x3(m->m11, m->m13, m->m14, m->m31, m->m33, m->m34, m->m41, m->m43, m->m44);
-	a.m32 = -ilgluDet3x3(m->m11, m->m12, m->m14, m->m31, m->m32, m->m34, m->m41, m->m42, m->m44);
-	a.m42 = +ilgluDet3x3(m->m11, m->m12, m->m13, m->m31, m->m32, m->m33, m->m41, m->m42, m->m43);
-
-	a.m13 = +ilgluDet3x3(m->m12, m->m13, m->m14, m->m22, m->m23, m->m24, m->m42, m->m43, m->m44);
-	a.m23 = -ilgluDet3x3(m->m11, m->m13, m->m14, m->m21, m->m23, m->m24, m->m41, m->m43, m->m44);
-	a.m33 = +ilgluDet3x3(m->m11, m->m12, m->m14, m->m21, m->m22, m->m24, m->m41, m->m42, m->m44);
-	a.m43 = -ilgluDet3x3(m->m11, m->m12, m->m13, m->m21, m->m22, m->m23, m->m41, m->m42, m->m43);
-
-	a.m14 = -ilgluDet3x3(m->m12, m->m13, m->m14, m->m22, m->m23, m->m24, m->m32, m->m33, m->m34);
-	a.m24 = +ilgluDet3x3(m->m11, m->m13, m->m14, m->m21, m->m23, m->m24, m->m31, m->m33, m->m34);
-	a.m34 = -ilgluDet3x3(m->m11, m->m12, m->m14, m->m21, m->m22, m->m24, m->m31, m->m32, m->m34);
-	a.m44 = +ilgluDet3x3(m->m11, m->m12, m->m13, m->m21, m->m22, m->m23, m->m31, m->m32, m->m33);
-
-	*o = a;
-}
-
-static LGLfloat ilgluMatrixDet(const LGLm4x4f* m) {
-	assert(m != NULL);
-	const LGLfloat a = ilgluDet3x3(m->m22, m->m23, m->m24, m->m32, m->m33, m->m34, m->m42, m->m43, m->m44);
-	const LGLfloat b = ilgluDet3x3(m->m21, m->m23, m->m24, m->m31, m->m33, m->m34, m->m41, m->m43, m->m44);
-	const LGLfloat c = ilgluDet3x3(m->m21, m->m22, m->m24, m->m31, m->m32, m->m34, m->m41, m->m42, m->m44);
-	const LGLfloat d = ilgluDet3x3(m->m21, m->m22, m->m23, m->m31, m->m32, m->m33, m->m41, m->m42, m->m43);
-	return m->m11 * a - m->m12 * b + m->m13 * c - m->m14 * d;
+	for (i = 0; i < count; i++) {
+		ilgluMatrixMultiply(&d[i].m11, &m->m11, &v[i].m11);
+	}
 }
 
+/*
+ * Inverse from the 2x2 minors of the upper (s) and lower (c) two rows, shared by all cofactors:
+ * s0 = m11 * m22 - m21 * m12, s1 = m11 * m23 - m21 * m13, ..., s5 = m13 * m24 - m23 * m14,
+ * c0 = m31 * m42 - m41 * m32, c1 = m31 * m43 - m41 * m33, ..., c5 = m33 * m44 - m43 * m34.
+ */
 LGLint lgluMatrixInverse(LGLm4x4f* o, const LGLm4x4f* m) {
 	assert(o != NULL);
 	assert(m != NULL);
 
-	const LGLfloat det = ilgluMatrixDet(m);
+#if LGLU_SSE
+	/* the rows of the inverse are signed combinations of the columns of m with the row pairs swapped */
+	__m128 r1 = _mm_loadu_ps(&m->m11);
+	__m128 r2 = _mm_loadu_ps(&m->m21);
+	__m128 r3 = _mm_loadu_ps(&m->m31);
+	__m128 r4 = _mm_loadu_ps(&m->m41);
+	_MM_TRANSPOSE4_PS(r1, r2, r3, r4);
+
+	/* minor k of columns (a, b) as [ck, ck, sk, sk] */
+#define ILGLU_MINOR(A, B) _mm_sub_ps( \
+		_mm_mul_ps(_mm_shuffle_ps(A, A, _MM_SHUFFLE(0, 0, 2, 2)), _mm_shuffle_ps(B, B, _MM_SHUFFLE(1, 1, 3, 3))), \
+		_mm_mul_ps(_mm_shuffle_ps(A, A, _MM_SHUFFLE(1, 1, 3, 3)), _mm_shuffle_ps(B, B, _MM_SHUFFLE(0, 0, 2, 2))))
+	const __m128 m0 = ILGLU_MINOR(r1, r2);
+	const __m128 m1 = ILGLU_MINOR(r1, r3);
+	const __m128 m2 = ILGLU_MINOR(r1, r4);
+	const __m128 m3 = ILGLU_MINOR(r2, r3);
+	const __m128 m4 = ILGLU_MINOR(r2, r4);
+	const __m128 m5 = ILGLU_MINOR(r3, r4);
+#undef ILGLU_MINOR
+#define ILGLU_S(M) _mm_cvtss_f32(_mm_movehl_ps(M, M))
+#define ILGLU_C(M) _mm_cvtss_f32(M)
+	const LGLfloat det = ILGLU_S(m0) * ILGLU_C(m5) - ILGLU_S(m1) * ILGLU_C(m4) + ILGLU_S(m2) * ILGLU_C(m3)
+			+ ILGLU_S(m3) * ILGLU_C(m2) - ILGLU_S(m4) * ILGLU_C(m1) + ILGLU_S(m5) * ILGLU_C(m0);
+#undef ILGLU_S
+#undef ILGLU_C
 	if (det == 0.0f) {
 		return -1;
 	}
 	const LGLfloat idet = 1.0f / det;
+	const __m128 pos = _mm_setr_ps(idet, -idet, idet, -idet);
+	const __m128 neg = _mm_setr_ps(-idet, idet, -idet, idet);
+
+	const __m128 k1 = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(2, 3, 0, 1));
+	const __m128 k2 = _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(2, 3, 0, 1));
+	const __m128 k3 = _mm_shuffle_ps(r3, r3, _MM_SHUFFLE(2, 3, 0, 1));
+	const __m128 k4 = _mm_shuffle_ps(r4, r4, _MM_SHUFFLE(2, 3, 0, 1));
+#define ILGLU_ROW(A, P, B, Q, C, R, S) _mm_mul_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(A, P), _mm_mul_ps(B, Q)), \
+		_mm_mul_ps(C, R)), S)
+	_mm_storeu_ps(&o->m11, ILGLU_ROW(k2, m5, k3, m4, k4, m3, pos));
+	_mm_storeu_ps(&o->m21, ILGLU_ROW(k1, m5, k3, m2, k4, m1, neg));
+	_mm_storeu_ps(&o->m31, ILGLU_ROW(k1, m4, k2, m2, k4, m0, pos));
+	_mm_storeu_ps(&o->m41, ILGLU_ROW(k1, m3, k2, m1, k3, m0, neg));
+#undef ILGLU_ROW
+#else
+	const LGLfloat s0 = m->m11 * m->m22 - m->m21 * m->m12;
+	const LGLfloat s1 = m->m11 * m->m23 - m->m21 * m->m13;
+	const LGLfloat s2 = m->m11 * m->m24 - m->m21 * m->m14;
+	const LGLfloat s3 = m->m12 * m->m23 - m->m22 * m->m13;
+	const LGLfloat s4 = m->m12 * m->m24 - m->m22 * m->m14;
+	const LGLfloat s5 = m->m13 * m->m24 - m->m23 * m->m14;
+	const LGLfloat c0 = m->m31 * m->m42 - m->m41 * m->m32;
+	const LGLfloat c1 = m->m31 * m->m43 - m->m41 * m->m33;
+	const LGLfloat c2 = m->m31 * m->m44 - m->m41 * m->m34;
+	const LGLfloat c3 = m->m32 * m->m43 - m->m42 * m->m33;
+	const LGLfloat c4 = m->m32 * m->m44 - m->m42 * m->m34;
+	const LGLfloat c5 = m->m33 * m->m44 - m->m43 * m->m34;
+
+	const LGLfloat det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (det == 0.0f) {
+		return -1;
+	}
+	const LGLfloat idet = 1.0f / det;
+	LGLm4x4f a;
 
-	ilgluMatrixAdjugate(o, m);
-
-	o->m11 *= idet;
-	o->m12 *= idet;
-	o->m13 *= idet;
-	o->m14 *= idet;
+	a.m11 = (m->m22 * c5 - m->m23 * c4 + m->m24 * c3) * idet;
+	a.m12 = (m->m12 * c5 - m->m13 * c4 + m->m14 * c3) * -idet;
+	a.m13 = (m->m42 * s5 - m->m43 * s4 + m->m44 * s3) * idet;
+	a.m14 = (m->m32 * s5 - m->m33 * s4 + m->m34 * s3) * -idet;
 
-	o->m21 *= idet;
-	o->m22 *= idet;
-	o->m23 *= idet;
-	o->m24 *= idet;
+	a.m21 = (m->m21 * c5 - m->m23 * c2 + m->m24 * c1) * -idet;
+	a.m22 = (m->m11 * c5 - m->m13 * c2 + m->m14 * c1) * idet;
+	a.m23 = (m->m41 * s5 - m->m43 * s2 + m->m44 * s1) * -idet;
+	a.m24 = (m->m31 * s5 - m->m33 * s2 + m->m34 * s1) * idet;
 
-	o->m31 *= idet;
-	o->m32 *= idet;
-	o->m33 *= idet;
-	o->m34 *= idet;
+	a.m31 = (m->m21 * c4 - m->m22 * c2 + m->m24 * c0) * idet;
+	a.m32 = (m->m11 * c4 - m->m12 * c2 + m->m14 * c0) * -idet;
+	a.m33 = (m->m41 * s4 - m->m42 * s2 + m->m44 * s0) * idet;
+	a.m34 = (m->m31 * s4 - m->m32 * s2 + m->m34 * s0) * -idet;
 
-	o->m41 *= idet;
-	o->m42 *= idet;
-	o->m43 *= idet;
-	o->m44 *= idet;
+	a.m41 = (m->m21 * c3 - m->m22 * c1 + m->m23 * c0) * -idet;
+	a.m42 = (m->m11 * c3 - m->m12 * c1 + m->m13 * c0) * idet;
+	a.m43 = (m->m41 * s3 - m->m42 * s1 + m->m43 * s0) * -idet;
+	a.m44 = (m->m31 * s3 - m->m32 * s1 + m->m33 * s0) * idet;
 
+	*o = a;
+#endif
 	return 1;
 }
 
@@ -346,6 +460,17 @@ void lgluMatrixTranspose(LGLm4x4f* o, const LGLm4x4f* m) {
 	assert(o != NULL);
 	assert(m != NULL);
 
+#if LGLU_SSE
+	__m128 r1 = _mm_loadu_ps(&m->m11);
+	__m128 r2 = _mm_loadu_ps(&m->m21);
+	__m128 r3 = _mm_loadu_ps(&m->m31);
+	__m128 r4 = _mm_loadu_ps(&m->m41);
+	_MM_TRANSPOSE4_PS(r1, r2, r3, r4);
+	_mm_storeu_ps(&o->m11, r1);
+	_mm_storeu_ps(&o->m21, r2);
+	_mm_storeu_ps(&o->m31, r3);
+	_mm_storeu_ps(&o->m41, r4);
+#else
 	LGLm4x4f a;
 
 	a.m11 = m->m11;
@@ -369,8 +494,10 @@ void lgluMatrixTranspose(LGLm4x4f* o, const LGLm4x4f* m) {
 	a.m44 = m->m44;
 
 	*o = a;
+#endif
 }
 
+/* a single vector does not fill a register, lgluTransformArray packs four */
 void lgluTransform(LGLv3f* d, const LGLm4x4f* m, const LGLv3f* v) {
 	assert(d != v);
 	d->x = m->m11 * v->x + m->m12 * v->y + m->m13 * v->z + m->m14;
@@ -378,6 +505,57 @@ void lgluTransform(LGLv3f* d, const LGLm4x4f* m, const LGLv3f* v) {
 	d->z = m->m31 * v->x + m->m32 * v->y + m->m33 * v->z + m->m34;
 }
 
+void lgluTransformArray(LGLv3f* d, const LGLm4x4f* m, const LGLv3f* v, LGLsize count) {
+	LGLsize i = 0;
+	LGLv3f t;
+	assert(m != NULL);
+	assert(count == 0 || (d != NULL && v != NULL));
+
+#if LGLU_SSE
+	const __m128 m11 = _mm_set1_ps(m->m11), m12 = _mm_set1_ps(m->m12), m13 = _mm_set1_ps(m->m13);
+	const __m128 m14 = _mm_set1_ps(m->m14), m21 = _mm_set1_ps(m->m21), m22 = _mm_set1_ps(m->m22);
+	const __m128 m23 = _mm_set1_ps(m->m23), m24 = _mm_set1_ps(m->m24), m31 = _mm_set1_ps(m->m31);
+	const __m128 m32 = _mm_set1_ps(m->m32), m33 = _mm_set1_ps(m->m33), m34 = _mm_set1_ps(m->m34);
+	__m128 a, b, c, p, q, x, y, z, dx, dy, dz;
+
+	/* four vectors are three registers [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3], shuffled to x, y and z */
+	for (; i + 4 <= count; i += 4) {
+		const LGLfloat* s = &v[i].x;
+		LGLfloat* o = &d[i].x;
+
+		a = _mm_loadu_ps(s + 0);
+		b = _mm_loadu_ps(s + 4);
+		c = _mm_loadu_ps(s + 8);
+		p = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+		x = _mm_shuffle_ps(a, p, _MM_SHUFFLE(2, 0, 3, 0));
+		p = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+		q = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+		y = _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0));
+		p = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+		z = _mm_shuffle_ps(p, c, _MM_SHUFFLE(3, 0, 2, 0));
+
+		dx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, x), _mm_mul_ps(m12, y)), _mm_mul_ps(m13, z)), m14);
+		dy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m21, x), _mm_mul_ps(m22, y)), _mm_mul_ps(m23, z)), m24);
+		dz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m31, x), _mm_mul_ps(m32, y)), _mm_mul_ps(m33, z)), m34);
+
+		p = _mm_shuffle_ps(dx, dy, _MM_SHUFFLE(0, 0, 0, 0));
+		q = _mm_shuffle_ps(dz, dx, _MM_SHUFFLE(1, 1, 0, 0));
+		_mm_storeu_ps(o + 0, _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0)));
+		p = _mm_shuffle_ps(dy, dz, _MM_SHUFFLE(1, 1, 1, 1));
+		q = _mm_shuffle_ps(dx, dy, _MM_SHUFFLE(2, 2, 2, 2));
+		_mm_storeu_ps(o + 4, _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0)));
+		p = _mm_shuffle_ps(dz, dx, _MM_SHUFFLE(3, 3, 2, 2));
+		q = _mm_shuffle_ps(dy, dz, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(o + 8, _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif
+	for (; i < count; i++) {
+		t = v[i];
+		lgluTransform(&d[i], m, &t);
+	}
+}
+
+/* the reciprocal square root is computed in double precision like sqrt does */
 void lgluVectorNormalize(LGLv3f* v) {
 	const LGLfloat f = 1.0f / sqrt(v->x * v->x + v->y * v->y + v->z * v->z);
 	v->x *= f;
@@ -385,6 +563,43 @@ void lgluVectorNormalize(LGLv3f* v) {
 	v->z *= f;
 }
 
+void lgluVectorNormalizeArray(LGLv3f* v, LGLsize count) {
+	LGLsize i = 0;
+	assert(count == 0 || v != NULL);
+
+#if LGLU_SSE
+	const __m128d one = _mm_set1_pd(1.0);
+	__m128 a, b, c, p, q, x, y, z, f;
+
+	for (; i + 4 <= count; i += 4) {
+		LGLfloat* s = &v[i].x;
+
+		a = _mm_loadu_ps(s + 0);
+		b = _mm_loadu_ps(s + 4);
+		c = _mm_loadu_ps(s + 8);
+		p = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+		x = _mm_shuffle_ps(a, p, _MM_SHUFFLE(2, 0, 3, 0));
+		p = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+		q = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+		y = _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0));
+		p = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+		z = _mm_shuffle_ps(p, c, _MM_SHUFFLE(3, 0, 2, 0));
+
+		p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		f = _mm_movelh_ps(_mm_cvtpd_ps(_mm_div_pd(one, _mm_sqrt_pd(_mm_cvtps_pd(p)))),
+				_mm_cvtpd_ps(_mm_div_pd(one, _mm_sqrt_pd(_mm_cvtps_pd(_mm_movehl_ps(p, p))))));
+
+		/* every vector is scaled by its own factor, [f0 f0 f0 f1] [f1 f1 f2 f2] [f2 f3 f3 f3] */
+		_mm_storeu_ps(s + 0, _mm_mul_ps(a, _mm_shuffle_ps(f, f, _MM_SHUFFLE(1, 0, 0, 0))));
+		_mm_storeu_ps(s + 4, _mm_mul_ps(b, _mm_shuffle_ps(f, f, _MM_SHUFFLE(2, 2, 1, 1))));
+		_mm_storeu_ps(s + 8, _mm_mul_ps(c, _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 2))));
+	}
+#endif
+	for (; i < count; i++) {
+		lgluVectorNormalize(&v[i]);
+	}
+}
+
 LGLfloat lgluVectorDot(LGLv3f* a, LGLv3f* b) {
 	return a->x * b->x + a->y * b->y + a->z * b->z;
 }
@@ -395,6 +610,1588 @@ void lgluInterpolatev3f(LGLv3f* o, LGLfloat a, const LGLv3f* v1, LGLfloat b, con
 	o->z = a * v1->z + b * v2->z + c * v3->z;
 }
 
+/*
+ *  Frustum functions
+ */
+
+/* plane row4 + sign * row of m, -w <= row . v resp. row . v <= w */
+static void ilgluSetPlane(LGLv4f* p, const LGLfloat* row, const LGLfloat* row4, LGLfloat sign) {
+	LGLfloat ilen;
+
+	p->x = row4[0] + sign * row[0];
+	p->y = row4[1] + sign * row[1];
+	p->z = row4[2] + sign * row[2];
+	p->w = row4[3] + sign * row[3];
+	ilen = 1.0f / (LGLfloat) sqrt(p->x * p->x + p->y * p->y + p->z * p->z);
+	p->x *= ilen;
+	p->y *= ilen;
+	p->z *= ilen;
+	p->w *= ilen;
+}
+
+void lgluFrustumFromMatrix(LGLUfrustum* f, const LGLm4x4f* m) {
+	assert(f != NULL);
+	assert(m != NULL);
+
+	ilgluSetPlane(&f->planes[0], &m->m11, &m->m41, 1.0f);
+	ilgluSetPlane(&f->planes[1], &m->m11, &m->m41, -1.0f);
+	ilgluSetPlane(&f->planes[2], &m->m21, &m->m41, 1.0f);
+	ilgluSetPlane(&f->planes[3], &m->m21, &m->m41, -1.0f);
+	ilgluSetPlane(&f->planes[4], &m->m31, &m->m41, 1.0f);
+	ilgluSetPlane(&f->planes[5], &m->m31, &m->m41, -1.0f);
+}
+
+LGLUvisibility lgluFrustumTestSphere(const LGLUfrustum* f, const LGLv3f* center, LGLfloat radius) {
+	LGLUvisibility visibility = LGLU_INSIDE;
+	LGLfloat distance;
+	int i;
+
+	assert(f != NULL);
+	assert(center != NULL);
+
+	for (i = 0; i < 6; i++) {
+		const LGLv4f* p = &f->planes[i];
+		distance = p->x * center->x + p->y * center->y + p->z * center->z + p->w;
+		if (distance < -radius) {
+			return LGLU_OUTSIDE;
+		}
+		if (distance < radius) {
+			visibility = LGLU_INTERSECTS;
+		}
+	}
+	return visibility;
+}
+
+/* per plane the corner furthest along the normal decides outside, the nearest one inside */
+LGLUvisibility lgluFrustumTestBox(const LGLUfrustum* f, const LGLv3f* min, const LGLv3f* max) {
+	LGLUvisibility visibility = LGLU_INSIDE;
+	int i;
+
+	assert(f != NULL);
+	assert(min != NULL && max != NULL);
+
+	for (i = 0; i < 6; i++) {
+		const LGLv4f* p = &f->planes[i];
+		const LGLfloat outer = p->x * (p->x > 0.0f ? max->x : min->x) + p->y * (p->y > 0.0f ? max->y : min->y)
+				+ p->z * (p->z > 0.0f ? max->z : min->z) + p->w;
+		const LGLfloat inner = p->x * (p->x > 0.0f ? min->x : max->x) + p->y * (p->y > 0.0f ? min->y : max->y)
+				+ p->z * (p->z > 0.0f ? min->z : max->z) + p->w;
+		if (outer < 0.0f) {
+			return LGLU_OUTSIDE;
+		}
+		if (inner < 0.0f) {
+			visibility = LGLU_INTERSECTS;
+		}
+	}
+	return visibility;
+}
+
+/*
+ *  Shader math functions
+ */
+
+#if LGLU_FAST_MATH
+
+typedef union ILGLUbits_u {
+	LGLfloat f;
+	LGLuint i;
+} ILGLUbits;
+
+/* 2^x from the exponent bits of the integer part and a degree 5 polynomial of the fraction */
+static LGLfloat ilgluExp2(LGLfloat x) {
+	ILGLUbits bits;
+	LGLint i;
+	LGLfloat f;
+
+	if (!(x >= -126.0f)) { /* also NaN, denormals are flushed to zero */
+		return 0.0f;
+	}
+	if (x > 127.99999f) { /* FLT_MAX, not infinity */
+		x = 127.99999f;
+	}
+	i = (LGLint) x;
+	if (x < i) {
+		i--;
+	}
+	f = x - i;
+	bits.i = (LGLuint) (i + 127) << 23;
+	return bits.f * (1.0f + f * (0.6931513628f + f * (0.2401641538f + f * (0.0558004463f + f * (0.0090166886f
+			+ f * 0.0018671825f)))));
+}
+
+/*
+ * e^x = 2^n * e^r with n = round(x / ln 2). ln 2 is split into a part with few mantissa bits, so n times it is
+ * exact, and the rest: r = x - n * ln 2 keeps its precision, where rounding x / ln 2 to float would lose up to
+ * |x| * 2^-24 of the exponent. e^r of r in [-ln 2 / 2, ln 2 / 2] is a degree 7 polynomial.
+ */
+static LGLfloat ilgluExp(LGLfloat x) {
+	ILGLUbits bits;
+	LGLint n;
+	LGLfloat r;
+
+	if (!(x > -87.33654f)) { /* below FLT_MIN, also NaN */
+		return 0.0f;
+	}
+	if (x > 88.0f) {
+		x = 88.0f;
+	}
+	n = (LGLint) (x * 1.4426950409f + (x < 0.0f ? -0.5f : 0.5f));
+	r = x - n * 0.693359375f + n * 2.12194440e-4f;
+	bits.i = (LGLuint) (n + 127) << 23;
+	return bits.f * (1.0f + r + r * r * (0.5000000120f + r * (0.1666666546f + r * (0.0416657959f + r * (0.0083334519f
+			+ r * (0.0013981999f + r * 0.0001987569f))))));
+}
+
+/* log2(x) of x > 0, the mantissa is mapped to [sqrt(1/2), sqrt(2)) and expanded in t = (m - 1) / (m + 1) */
+static LGLfloat ilgluLog2(LGLfloat x) {
+	ILGLUbits bits;
+	LGLint e;
+	LGLfloat m, t, t2;
+
+	bits.f = x;
+	e = (LGLint) ((bits.i >> 23) & 0xff) - 127;
+	bits.i = (bits.i & 0x007fffff) | 0x3f800000;
+	m = bits.f;
+	if (m > 1.41421356f) {
+		m *= 0.5f;
+		e++;
+	}
+	t = (m - 1.0f) / (m + 1.0f);
+	t2 = t * t;
+	return e + t * (2.8853900818f + t2 * (0.9617966939f + t2 * (0.5770780164f + t2 * 0.4121985831f)));
+}
+
+#endif
+
+LGLfloat lgluShaderRsqrt(LGLfloat x) {
+#if LGLU_FAST_MATH && LGLU_SSE
+	/* 12 bit hardware estimate, the Newton step y * (1.5 - 0.5 * x * y * y) doubles the correct bits */
+	const LGLfloat y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+	return y * (1.5f - 0.5f * x * y * y);
+#elif LGLU_FAST_MATH
+	ILGLUbits bits;
+	LGLfloat y;
+
+	bits.f = x;
+	bits.i = 0x5f375a86 - (bits.i >> 1);
+	y = bits.f;
+	return y * (1.5f - 0.5f * x * y * y);
+#else
+	return (LGLfloat) (1.0 / sqrt(x));
+#endif
+}
+
+void lgluShaderNormalize(LGLv3f* v) {
+#if LGLU_FAST_MATH
+	const LGLfloat f = lgluShaderRsqrt(v->x * v->x + v->y * v->y + v->z * v->z);
+	v->x *= f;
+	v->y *= f;
+	v->z *= f;
+#else
+	lgluVectorNormalize(v);
+#endif
+}
+
+LGLfloat lgluShaderExp(LGLfloat x) {
+#if LGLU_FAST_MATH
+	return ilgluExp(x);
+#else
+	return (LGLfloat) exp(x);
+#endif
+}
+
+LGLfloat lgluShaderPow(LGLfloat x, LGLfloat y) {
+#if LGLU_FAST_MATH
+	if (!(x > 0.0f)) {
+		return 0.0f;
+	}
+	return ilgluExp2(y * ilgluLog2(x));
+#else
+	if (!(x > 0.0f)) {
+		return 0.0f;
+	}
+	return (LGLfloat) pow(x, y);
+#endif
+}
+
+LGLuint lgluShaderUnorm8(LGLfloat x) {
+	const LGLfloat c = !(x > 0.0f) ? 0.0f : x > 1.0f ? 1.0f : x;
+#if LGLU_FAST_MATH
+	/* adding 1.5 * 2^23 leaves the rounded integer in the low mantissa bits, no float to int conversion */
+	ILGLUbits bits;
+	bits.f = c * 255.0f + 12582912.0f;
+	return bits.i & 0xff;
+#else
+	return (LGLuint) (c * 255.0f + 0.5f);
+#endif
+}
+
+/*
+ *  Mesh functions
+ */
+
+static LGLuint ilgluGetIndex(LGLdata indices, LGLindextype type, LGLsize i) {
+	return type == LGL_INDEX_TYPE_USHORT ? ((const LGLushort*) indices)[i] : ((const LGLuint*) indices)[i];
+}
+
+static void ilgluSetIndex(LGLdata indices, LGLindextype type, LGLsize i, LGLuint index) {
+	if (type == LGL_INDEX_TYPE_USHORT) {
+		((LGLushort*) indices)[i] = (LGLushort) index;
+	} else {
+		((LGLuint*) indices)[i] = index;
+	}
+}
+
+/* a vertex last used at time stamp t is cached while time - t < LGLU_VERTEX_CACHE_SIZE */
+static LGLint ilgluCached(const LGLuint* stamps, LGLuint time, LGLuint vertex) {
+	return stamps[vertex] != 0 && time - stamps[vertex] < LGLU_VERTEX_CACHE_SIZE;
+}
+
+/* triangles of each vertex, the ones of vertex v are triangles[offsets[v]] to triangles[offsets[v + 1] - 1] */
+static LGLint ilgluBuildAdjacency(LGLuint** offsets, LGLuint** triangles, LGLdata indices, LGLindextype type,
+		LGLsize num_indices, LGLsize num_vertices) {
+	LGLsize i;
+
+	*offsets = calloc(num_vertices + 1, sizeof(LGLuint));
+	*triangles = malloc(sizeof(LGLuint) * (num_indices + 1));
+	if (*offsets == NULL || *triangles == NULL) {
+		free(*offsets);
+		free(*triangles);
+		return 0;
+	}
+	for (i = 0; i < num_indices; i++) {
+		(*offsets)[ilgluGetIndex(indices, type, i) + 1]++;
+	}
+	for (i = 0; i < num_vertices; i++) {
+		(*offsets)[i + 1] += (*offsets)[i];
+	}
+	for (i = 0; i < num_indices; i++) {
+		const LGLuint v = ilgluGetIndex(indices, type, i);
+		(*triangles)[(*offsets)[v]++] = (LGLuint) (i / 3);
+	}
+	/* the fill moved every offset to the start of the next vertex */
+	for (i = num_vertices; i > 0; i--) {
+		(*offsets)[i] = (*offsets)[i - 1];
+	}
+	(*offsets)[0] = 0;
+	return 1;
+}
+
+/*
+ * Tipsify, Sander et al. 2007. Fans around the current vertex, then continues with the candidate that stays in
+ * the cache longest after its remaining triangles are emitted, or a vertex from the dead end stack.
+ */
+LGLint lgluOptimizeVertexCache(LGLdata indices, LGLindextype type, LGLsize num_indices, LGLsize num_vertices) {
+	LGLuint *offsets, *triangles, *live, *stamps, *stack, *output;
+	unsigned char* emitted;
+	LGLuint time = 1, cursor = 0, top = 0, written = 0;
+	LGLint fan = 0;
+	LGLsize i;
+
+	assert(indices != NULL || num_indices == 0);
+	assert(num_indices % 3 == 0);
+
+	if (num_indices == 0 || num_vertices == 0) {
+		return 1;
+	}
+	if (!ilgluBuildAdjacency(&offsets, &triangles, indices, type, num_indices, num_vertices)) {
+		return 0;
+	}
+	live = malloc(sizeof(LGLuint) * num_vertices);
+	stamps = calloc(num_vertices, sizeof(LGLuint));
+	stack = malloc(sizeof(LGLuint) * num_indices);
+	output = malloc(sizeof(LGLuint) * num_indices);
+	emitted = calloc(num_indices / 3, 1);
+	if (live == NULL || stamps == NULL || stack == NULL || output == NULL || emitted == NULL) {
+		free(live);
+		free(stamps);
+		free(stack);
+		free(output);
+		free(emitted);
+		free(offsets);
+		free(triangles);
+		return 0;
+	}
+	for (i = 0; i < num_vertices; i++) {
+		live[i] = offsets[i + 1] - offsets[i];
+	}
+
+	while (fan >= 0) {
+		const LGLuint first = top;
+		LGLuint t, k, best_score = 0;
+		LGLint best = -1;
+
+		for (t = offsets[fan]; t < offsets[fan + 1]; t++) {
+			const LGLuint triangle = triangles[t];
+			if (emitted[triangle]) {
+				continue;
+			}
+			emitted[triangle] = 1;
+			for (k = 0; k < 3; k++) {
+				const LGLuint v = ilgluGetIndex(indices, type, triangle * 3 + k);
+				output[written++] = v;
+				stack[top++] = v;
+				live[v]--;
+				if (!ilgluCached(stamps, time, v)) {
+					stamps[v] = time++;
+				}
+			}
+		}
+
+		/* candidates are the vertices of the fan, prefer the oldest that survives its own triangles */
+		for (k = first; k < top; k++) {
+			const LGLuint v = stack[k];
+			LGLuint score = 0;
+			if (live[v] == 0) {
+				continue;
+			}
+			if (ilgluCached(stamps, time, v) && time - stamps[v] + 2 * live[v] < LGLU_VERTEX_CACHE_SIZE) {
+				score = time - stamps[v] + 1;
+			}
+			if (best < 0 || score > best_score) {
+				best = (LGLint) v;
+				best_score = score;
+			}
+		}
+
+		/* dead end, go back through the stack, then scan for the next vertex with triangles left */
+		while (best < 0 && top > 0) {
+			const LGLuint v = stack[--top];
+			if (live[v] > 0) {
+				best = (LGLint) v;
+			}
+		}
+		while (best < 0 && cursor < num_vertices) {
+			if (live[cursor] > 0) {
+				best = (LGLint) cursor;
+			}
+			cursor++;
+		}
+		fan = best;
+	}
+	assert(written == num_indices);
+
+	for (i = 0; i < num_indices; i++) {
+		ilgluSetIndex(indices, type, i, output[i]);
+	}
+	free(live);
+	free(stamps);
+	free(stack);
+	free(output);
+	free(emitted);
+	free(offsets);
+	free(triangles);
+	return 1;
+}
+
+typedef struct ILGLUcluster_s {
+	LGLuint first, count; /* triangles */
+	LGLfloat potential;
+} ILGLUcluster;
+
+static int ilgluCompareClusters(const void* a, const void* b) {
+	const ILGLUcluster* ca = a;
+	const ILGLUcluster* cb = b;
+	if (ca->potential != cb->potential) {
+		return ca->potential > cb->potential ? -1 : 1;
+	}
+	return ca->first < cb->first ? -1 : 1;
+}
+
+/* simulates the cache for triangle t, returns the number of vertices that missed */
+static LGLuint ilgluCacheTriangle(LGLdata indices, LGLindextype type, LGLsize t, LGLuint* stamps, LGLuint* time) {
+	LGLuint k, misses = 0;
+
+	for (k = 0; k < 3; k++) {
+		const LGLuint v = ilgluGetIndex(indices, type, t * 3 + k);
+		if (!ilgluCached(stamps, *time, v)) {
+			stamps[v] = (*time)++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+/*
+ * Sander et al. 2007. Splits the triangle order into clusters that start with an empty cache and end as soon as
+ * their cache misses per triangle drop to threshold times the ones of the whole order, then sorts the clusters
+ * by occlusion potential: how far a cluster lies out along its own normal from the mesh centroid. Clusters on
+ * the outside are likely to cover the others from any view point.
+ */
+LGLint lgluOptimizeOverdraw(LGLdata indices, LGLindextype type, LGLsize num_indices, const LGLv3f* vertices,
+		LGLsize num_vertices, LGLfloat threshold) {
+	const LGLsize num_triangles = num_indices / 3;
+	ILGLUcluster *clusters, *cluster = NULL;
+	LGLuint *stamps, *output;
+	LGLuint time = 1, num_clusters = 0, written = 0, total = 0, misses = 0;
+	LGLv3f center = { 0.0f, 0.0f, 0.0f };
+	LGLfloat area = 0.0f;
+	LGLsize i, t;
+
+	assert(indices != NULL || num_indices == 0);
+	assert(vertices != NULL || num_vertices == 0);
+	assert(num_indices % 3 == 0);
+
+	if (num_triangles < 2) {
+		return 1;
+	}
+	clusters = malloc(sizeof(ILGLUcluster) * num_triangles);
+	stamps = calloc(num_vertices, sizeof(LGLuint));
+	output = malloc(sizeof(LGLuint) * num_indices);
+	if (clusters == NULL || stamps == NULL || output == NULL) {
+		free(clusters);
+		free(stamps);
+		free(output);
+		return 0;
+	}
+
+	for (t = 0; t < num_triangles; t++) {
+		total += ilgluCacheTriangle(indices, type, t, stamps, &time);
+	}
+	for (t = 0; t < num_triangles; t++) {
+		if (cluster == NULL || (LGLfloat) misses <= threshold * total * cluster->count / num_triangles) {
+			time += LGLU_VERTEX_CACHE_SIZE; /* flushes the cache */
+			cluster = &clusters[num_clusters++];
+			cluster->first = (LGLuint) t;
+			cluster->count = 0;
+			misses = 0;
+		}
+		misses += ilgluCacheTriangle(indices, type, t, stamps, &time);
+		cluster->count++;
+	}
+
+	/* area weighted centroid of the surface */
+	for (t = 0; t < num_triangles; t++) {
+		const LGLv3f* a = &vertices[ilgluGetIndex(indices, type, t * 3 + 0)];
+		const LGLv3f* b = &vertices[ilgluGetIndex(indices, type, t * 3 + 1)];
+		const LGLv3f* c = &vertices[ilgluGetIndex(indices, type, t * 3 + 2)];
+		const LGLfloat ux = b->x - a->x, uy = b->y - a->y, uz = b->z - a->z;
+		const LGLfloat vx = c->x - a->x, vy = c->y - a->y, vz = c->z - a->z;
+		const LGLfloat nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+		const LGLfloat w = (LGLfloat) sqrt(nx * nx + ny * ny + nz * nz);
+		center.x += w * (a->x + b->x + c->x);
+		center.y += w * (a->y + b->y + c->y);
+		center.z += w * (a->z + b->z + c->z);
+		area += w;
+	}
+	if (area > 0.0f) {
+		center.x /= 3.0f * area;
+		center.y /= 3.0f * area;
+		center.z /= 3.0f * area;
+	}
+
+	for (i = 0; i < num_clusters; i++) {
+		LGLv3f centroid = { 0.0f, 0.0f, 0.0f }, normal = { 0.0f, 0.0f, 0.0f };
+		LGLfloat weight = 0.0f, length;
+
+		cluster = &clusters[i];
+		for (t = cluster->first; t < cluster->first + cluster->count; t++) {
+			const LGLv3f* a = &vertices[ilgluGetIndex(indices, type, t * 3 + 0)];
+			const LGLv3f* b = &vertices[ilgluGetIndex(indices, type, t * 3 + 1)];
+			const LGLv3f* c = &vertices[ilgluGetIndex(indices, type, t * 3 + 2)];
+			const LGLfloat ux = b->x - a->x, uy = b->y - a->y, uz = b->z - a->z;
+			const LGLfloat vx = c->x - a->x, vy = c->y - a->y, vz = c->z - a->z;
+			const LGLfloat nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+			const LGLfloat w = (LGLfloat) sqrt(nx * nx + ny * ny + nz * nz);
+			centroid.x += w * (a->x + b->x + c->x);
+			centroid.y += w * (a->y + b->y + c->y);
+			centroid.z += w * (a->z + b->z + c->z);
+			normal.x += nx;
+			normal.y += ny;
+			normal.z += nz;
+			weight += w;
+		}
+		cluster->potential = 0.0f;
+		length = (LGLfloat) sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		if (weight > 0.0f && length > 0.0f) {
+			cluster->potential = ((centroid.x / (3.0f * weight) - center.x) * normal.x
+					+ (centroid.y / (3.0f * weight) - center.y) * normal.y
+					+ (centroid.z / (3.0f * weight) - center.z) * normal.z) / length;
+		}
+	}
+	qsort(clusters, num_clusters, sizeof(ILGLUcluster), ilgluCompareClusters);
+
+	for (i = 0; i < num_clusters; i++) {
+		for (t = clusters[i].first * 3; t < (clusters[i].first + clusters[i].count) * 3; t++) {
+			output[written++] = ilgluGetIndex(indices, type, t);
+		}
+	}
+	for (i = 0; i < num_indices; i++) {
+		ilgluSetIndex(indices, type, i, output[i]);
+	}
+	free(clusters);
+	free(stamps);
+	free(output);
+	return 1;
+}
+
+LGLsize lgluOptimizeVertexFetch(LGLuint* remap, LGLdata indices, LGLindextype type, LGLsize num_indices,
+		LGLsize num_vertices) {
+	LGLuint next = 0;
+	LGLsize i, used;
+
+	assert(remap != NULL || num_vertices == 0);
+	assert(indices != NULL || num_indices == 0);
+
+	for (i = 0; i < num_vertices; i++) {
+		remap[i] = ~0u;
+	}
+	for (i = 0; i < num_indices; i++) {
+		const LGLuint v = ilgluGetIndex(indices, type, i);
+		assert(v < num_vertices);
+		if (remap[v] == ~0u) {
+			remap[v] = next++;
+		}
+		ilgluSetIndex(indices, type, i, remap[v]);
+	}
+	used = next;
+	for (i = 0; i < num_vertices; i++) {
+		if (remap[i] == ~0u) {
+			remap[i] = next++;
+		}
+	}
+	return used;
+}
+
+void lgluRemapVertices(void* d, const void* v, LGLsize size, LGLsize num_vertices, const LGLuint* remap) {
+	LGLsize i;
+
+	assert(d != NULL || num_vertices == 0);
+	assert(v != NULL || num_vertices == 0);
+	assert(remap != NULL || num_vertices == 0);
+	assert(d != v);
+
+	for (i = 0; i < num_vertices; i++) {
+		memcpy((char*) d + remap[i] * size, (const char*) v + i * size, size);
+	}
+}
+
+/*
+ *  LOD functions
+ */
+
+/* symmetric 4x4 plane quadric, the sum of weight * squared distance to each plane */
+typedef struct ILGLUquadric_s {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, w;
+} ILGLUquadric;
+
+typedef struct ILGLUcollapse_s {
+	LGLuint from, to;
+	double cost;
+} ILGLUcollapse;
+
+typedef struct ILGLUposition_s {
+	LGLv3f p;
+	LGLuint vertex;
+} ILGLUposition;
+
+static int ilgluComparePositions(const void* a, const void* b) {
+	const ILGLUposition* pa = a;
+	const ILGLUposition* pb = b;
+	const int order = memcmp(&pa->p, &pb->p, sizeof(LGLv3f));
+	if (order != 0) {
+		return order;
+	}
+	return pa->vertex < pb->vertex ? -1 : 1;
+}
+
+static int ilgluCompareCollapses(const void* a, const void* b) {
+	const ILGLUcollapse* ca = a;
+	const ILGLUcollapse* cb = b;
+	if (ca->cost != cb->cost) {
+		return ca->cost < cb->cost ? -1 : 1;
+	}
+	if (ca->from != cb->from) {
+		return ca->from < cb->from ? -1 : 1;
+	}
+	return ca->to < cb->to ? -1 : 1;
+}
+
+static void ilgluAddPlane(ILGLUquadric* q, double a, double b, double c, double d, double w) {
+	q->a2 += w * a * a;
+	q->ab += w * a * b;
+	q->ac += w * a * c;
+	q->ad += w * a * d;
+	q->b2 += w * b * b;
+	q->bc += w * b * c;
+	q->bd += w * b * d;
+	q->c2 += w * c * c;
+	q->cd += w * c * d;
+	q->d2 += w * d * d;
+	q->w += w;
+}
+
+/* area weighted sum of the squared distances of p to the planes of q1 and q2 */
+static double ilgluQuadricError(const ILGLUquadric* q1, const ILGLUquadric* q2, const LGLv3f* p) {
+	const double x = p->x, y = p->y, z = p->z;
+	const double e = (q1->a2 + q2->a2) * x * x + (q1->b2 + q2->b2) * y * y + (q1->c2 + q2->c2) * z * z
+			+ 2.0 * ((q1->ab + q2->ab) * x * y + (q1->ac + q2->ac) * x * z + (q1->bc + q2->bc) * y * z)
+			+ 2.0 * ((q1->ad + q2->ad) * x + (q1->bd + q2->bd) * y + (q1->cd + q2->cd) * z) + q1->d2 + q2->d2;
+	return e > 0.0 ? e : 0.0;
+}
+
+static void ilgluCross(LGLv3f* n, const LGLv3f* a, const LGLv3f* b, const LGLv3f* c) {
+	const LGLfloat ux = b->x - a->x, uy = b->y - a->y, uz = b->z - a->z;
+	const LGLfloat vx = c->x - a->x, vy = c->y - a->y, vz = c->z - a->z;
+	n->x = uy * vz - uz * vy;
+	n->y = uz * vx - ux * vz;
+	n->z = ux * vy - uy * vx;
+}
+
+/* moving from onto to must not flip or degenerate the triangles of from that stay */
+static LGLint ilgluCollapseFlips(const LGLuint* work, const LGLuint* offsets, const LGLuint* triangles,
+		const LGLv3f* vertices, LGLuint from, LGLuint to) {
+	LGLuint t, k;
+
+	for (t = offsets[from]; t < offsets[from + 1]; t++) {
+		const LGLuint* tri = &work[triangles[t] * 3];
+		LGLv3f p[3], before, after;
+		if (tri[0] == to || tri[1] == to || tri[2] == to) {
+			continue;
+		}
+		for (k = 0; k < 3; k++) {
+			p[k] = vertices[tri[k]];
+		}
+		ilgluCross(&before, &p[0], &p[1], &p[2]);
+		for (k = 0; k < 3; k++) {
+			if (tri[k] == from) {
+				p[k] = vertices[to];
+			}
+		}
+		ilgluCross(&after, &p[0], &p[1], &p[2]);
+		if (before.x * after.x + before.y * after.y + before.z * after.z
+				<= 0.25f * (LGLfloat) sqrt(before.x * before.x + before.y * before.y + before.z * before.z)
+						* (LGLfloat) sqrt(after.x * after.x + after.y * after.y + after.z * after.z)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* vertices next to both ends of an interior edge must be the two opposite corners, or the mesh folds */
+static LGLint ilgluCollapseFolds(const LGLuint* work, const LGLuint* offsets, const LGLuint* triangles, LGLuint* marks,
+		LGLuint* stamp, LGLuint from, LGLuint to) {
+	const LGLuint next = *stamp + 1, shared = *stamp + 2;
+	LGLuint s, k, count = 0;
+
+	for (s = offsets[from]; s < offsets[from + 1]; s++) {
+		for (k = 0; k < 3; k++) {
+			marks[work[triangles[s] * 3 + k]] = next;
+		}
+	}
+	for (s = offsets[to]; s < offsets[to + 1]; s++) {
+		for (k = 0; k < 3; k++) {
+			const LGLuint v = work[triangles[s] * 3 + k];
+			if (marks[v] == next && v != from && v != to) {
+				marks[v] = shared;
+				count++;
+			}
+		}
+	}
+	*stamp = shared;
+	return count > 2;
+}
+
+/*
+ * Garland and Heckbert 1997 with half edge collapses, a vertex moves onto a neighbour so the vertex array stays
+ * unchanged. Vertices sharing a position (attribute seams) and vertices on open borders are locked. Each pass
+ * sorts the collapses of the current triangles by cost and applies those that touch no triangle changed
+ * earlier in the pass, until the target or max_error is reached or no collapse is left.
+ */
+LGLsize lgluSimplify(LGLdata d, LGLdata indices, LGLindextype type, LGLsize num_indices, const LGLv3f* vertices,
+		LGLsize num_vertices, LGLsize target_indices, LGLfloat max_error, LGLfloat* error) {
+	ILGLUquadric* quadrics = NULL;
+	ILGLUcollapse* collapses = NULL;
+	ILGLUposition* positions = NULL;
+	LGLuint *weld = NULL, *work = NULL, *map = NULL, *offsets = NULL, *triangles = NULL, *marks = NULL;
+	unsigned char *locked = NULL, *touched = NULL;
+	LGLuint stamp = 0;
+	LGLsize count = num_indices, i, t;
+	double worst = 0.0;
+	LGLint done = 0;
+
+	assert(indices != NULL || num_indices == 0);
+	assert(vertices != NULL || num_vertices == 0);
+	assert(num_indices % 3 == 0);
+
+	weld = malloc(sizeof(LGLuint) * num_vertices);
+	map = malloc(sizeof(LGLuint) * num_vertices);
+	work = malloc(sizeof(LGLuint) * (num_indices + 1));
+	positions = malloc(sizeof(ILGLUposition) * num_vertices);
+	quadrics = calloc(num_vertices, sizeof(ILGLUquadric));
+	collapses = malloc(sizeof(ILGLUcollapse) * (num_indices * 2 + 1));
+	locked = calloc(num_vertices, 1);
+	touched = malloc(num_vertices);
+	marks = calloc(num_vertices, sizeof(LGLuint));
+	if (weld == NULL || map == NULL || work == NULL || positions == NULL || quadrics == NULL || collapses == NULL
+			|| locked == NULL || touched == NULL || marks == NULL) {
+		count = 0;
+		goto out;
+	}
+
+	/* the first vertex at a position stands for all of them, the others are seam wedges and lock it */
+	for (i = 0; i < num_vertices; i++) {
+		positions[i].p = vertices[i];
+		positions[i].vertex = (LGLuint) i;
+	}
+	qsort(positions, num_vertices, sizeof(ILGLUposition), ilgluComparePositions);
+	for (i = 0; i < num_vertices; i++) {
+		if (i > 0 && memcmp(&positions[i].p, &positions[i - 1].p, sizeof(LGLv3f)) == 0) {
+			weld[positions[i].vertex] = weld[positions[i - 1].vertex];
+			locked[weld[positions[i].vertex]] = 1;
+			locked[positions[i].vertex] = 1;
+		} else {
+			weld[positions[i].vertex] = positions[i].vertex;
+		}
+		map[i] = (LGLuint) i;
+	}
+	for (i = 0; i < num_indices; i++) {
+		work[i] = weld[ilgluGetIndex(indices, type, i)];
+	}
+
+	for (t = 0; t < num_indices; t += 3) {
+		LGLv3f n;
+		const LGLv3f* a = &vertices[work[t]];
+		double length, w;
+		ilgluCross(&n, a, &vertices[work[t + 1]], &vertices[work[t + 2]]);
+		length = sqrt((double) n.x * n.x + (double) n.y * n.y + (double) n.z * n.z);
+		if (length == 0.0) {
+			continue;
+		}
+		w = length * 0.5; /* area */
+		for (i = 0; i < 3; i++) {
+			ilgluAddPlane(&quadrics[work[t + i]], n.x / length, n.y / length, n.z / length,
+					-(n.x * a->x + n.y * a->y + n.z * a->z) / length, w);
+		}
+	}
+
+	/* an edge used by one triangle only is an open border */
+	if (!ilgluBuildAdjacency(&offsets, &triangles, work, LGL_INDEX_TYPE_UINT, num_indices, num_vertices)) {
+		count = 0;
+		goto out;
+	}
+	for (t = 0; t < num_indices; t++) {
+		const LGLuint a = work[t], b = work[t - t % 3 + (t + 1) % 3];
+		LGLuint s, shared = 0;
+		for (s = offsets[a]; s < offsets[a + 1]; s++) {
+			const LGLuint* tri = &work[triangles[s] * 3];
+			shared += tri[0] == b || tri[1] == b || tri[2] == b;
+		}
+		if (shared < 2) {
+			locked[a] = locked[b] = 1;
+		}
+	}
+
+	while (!done && count > target_indices) {
+		LGLsize num_collapses = 0, removed = 0, budget;
+		LGLsize c;
+
+		if (triangles == NULL
+				&& !ilgluBuildAdjacency(&offsets, &triangles, work, LGL_INDEX_TYPE_UINT, count, num_vertices)) {
+			break;
+		}
+		for (t = 0; t < count; t++) {
+			const LGLuint a = work[t], b = work[t - t % 3 + (t + 1) % 3];
+			if (!locked[a]) {
+				collapses[num_collapses].from = a;
+				collapses[num_collapses].to = b;
+				collapses[num_collapses].cost = ilgluQuadricError(&quadrics[a], &quadrics[b], &vertices[b]);
+				num_collapses++;
+			}
+			if (!locked[b]) {
+				collapses[num_collapses].from = b;
+				collapses[num_collapses].to = a;
+				collapses[num_collapses].cost = ilgluQuadricError(&quadrics[a], &quadrics[b], &vertices[a]);
+				num_collapses++;
+			}
+		}
+		qsort(collapses, num_collapses, sizeof(ILGLUcollapse), ilgluCompareCollapses);
+
+		/* a collapse removes about two triangles */
+		budget = (count - target_indices) / 6 + 1;
+		memset(touched, 0, num_vertices);
+		done = 1;
+		for (c = 0; c < num_collapses && removed < budget; c++) {
+			const ILGLUcollapse* collapse = &collapses[c];
+			const double weight = quadrics[collapse->from].w + quadrics[collapse->to].w;
+			const double distance = weight > 0.0 ? collapse->cost / weight : 0.0; /* mean squared */
+			LGLuint s;
+			if (distance > (double) max_error * max_error || touched[collapse->from] || touched[collapse->to]
+					|| ilgluCollapseFlips(work, offsets, triangles, vertices, collapse->from, collapse->to)
+					|| ilgluCollapseFolds(work, offsets, triangles, marks, &stamp, collapse->from, collapse->to)) {
+				continue;
+			}
+			for (s = offsets[collapse->from]; s < offsets[collapse->from + 1]; s++) {
+				const LGLuint* tri = &work[triangles[s] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			map[collapse->from] = collapse->to;
+			quadrics[collapse->to].a2 += quadrics[collapse->from].a2;
+			quadrics[collapse->to].ab += quadrics[collapse->from].ab;
+			quadrics[collapse->to].ac += quadrics[collapse->from].ac;
+			quadrics[collapse->to].ad += quadrics[collapse->from].ad;
+			quadrics[collapse->to].b2 += quadrics[collapse->from].b2;
+			quadrics[collapse->to].bc += quadrics[collapse->from].bc;
+			quadrics[collapse->to].bd += quadrics[collapse->from].bd;
+			quadrics[collapse->to].c2 += quadrics[collapse->from].c2;
+			quadrics[collapse->to].cd += quadrics[collapse->from].cd;
+			quadrics[collapse->to].d2 += quadrics[collapse->from].d2;
+			quadrics[collapse->to].w += quadrics[collapse->from].w;
+			if (distance > worst) {
+				worst = distance;
+			}
+			removed++;
+			done = 0;
+		}
+
+		/* apply the pass, triangles that lost a vertex drop out */
+		for (t = 0, c = 0; t < count; t += 3) {
+			const LGLuint a = map[work[t]], b = map[work[t + 1]], e = map[work[t + 2]];
+			if (a != b && b != e && a != e) {
+				work[c++] = a;
+				work[c++] = b;
+				work[c++] = e;
+			}
+		}
+		count = c;
+		free(offsets);
+		free(triangles);
+		offsets = triangles = NULL;
+	}
+
+	/* collapsed vertices are never seam wedges, the others keep their own index */
+	for (i = 0, t = 0; i < num_indices; i += 3) {
+		LGLuint k, v[3];
+		for (k = 0; k < 3; k++) {
+			v[k] = ilgluGetIndex(indices, type, i + k);
+			while (map[weld[v[k]]] != weld[v[k]]) {
+				v[k] = map[weld[v[k]]];
+			}
+		}
+		if (weld[v[0]] != weld[v[1]] && weld[v[1]] != weld[v[2]] && weld[v[0]] != weld[v[2]]) {
+			for (k = 0; k < 3; k++) {
+				ilgluSetIndex(d, type, t++, v[k]);
+			}
+		}
+	}
+	assert(t == count);
+
+out:
+	if (error != NULL) {
+		*error = (LGLfloat) sqrt(worst);
+	}
+	free(weld);
+	free(map);
+	free(work);
+	free(positions);
+	free(quadrics);
+	free(collapses);
+	free(locked);
+	free(touched);
+	free(marks);
+	free(offsets);
+	free(triangles);
+	return count;
+}
+
+LGLuint lgluBuildLods(LGLUlod lods[], LGLuint max_lods, LGLdata d, LGLsize capacity, LGLdata indices,
+		LGLindextype type, LGLsize num_indices, const LGLv3f* vertices, LGLsize num_vertices, LGLfloat ratio) {
+	const LGLsize size = type == LGL_INDEX_TYPE_USHORT ? sizeof(LGLushort) : sizeof(LGLuint);
+	LGLsize first = 0;
+	LGLuint num_lods = 0;
+
+	assert(lods != NULL || max_lods == 0);
+	assert(d != NULL || capacity == 0);
+	assert(ratio > 0.0f && ratio < 1.0f);
+
+	if (max_lods == 0 || capacity < num_indices) {
+		return 0;
+	}
+	memcpy(d, indices, size * num_indices);
+	lods[0].first_index = 0;
+	lods[0].index_count = num_indices;
+	lods[0].error = 0.0f;
+	first = num_indices;
+
+	for (num_lods = 1; num_lods < max_lods; num_lods++) {
+		const LGLUlod* prev = &lods[num_lods - 1];
+		const LGLsize target = (LGLsize) (prev->index_count / 3 * ratio) * 3;
+		LGLdata level = (char*) d + first * size;
+		LGLsize count;
+		LGLfloat error;
+
+		if (target == 0 || capacity - first < num_indices) {
+			break;
+		}
+		/* every level starts from the full mesh, its error is measured against the original surface */
+		memcpy(level, indices, size * num_indices);
+		count = lgluSimplify(level, level, type, num_indices, vertices, num_vertices, target, FLT_MAX, &error);
+		/* locked vertices stop the collapses, a level must save at least a quarter of the previous one */
+		if (count == 0 || count > prev->index_count * 3 / 4) {
+			break;
+		}
+		lgluOptimizeVertexCache(level, type, count, num_vertices);
+		lods[num_lods].first_index = first;
+		lods[num_lods].index_count = count;
+		lods[num_lods].error = error > prev->error ? error : prev->error;
+		first += count;
+	}
+	return num_lods;
+}
+
+LGLuint lgluSelectLod(LGLdrawrecord* record, const LGLUlod lods[], LGLuint num_lods, LGLfloat height,
+		LGLfloat pixel_error) {
+	const LGLm4x4f* m;
+	LGLv3f center;
+	LGLfloat radius, w, scale;
+	LGLuint level = 0;
+
+	assert(record != NULL);
+	assert(lods != NULL && num_lods > 0);
+
+	m = record->bounds_transform;
+	if (m != NULL) {
+		center.x = (record->bounds_min.x + record->bounds_max.x) * 0.5f;
+		center.y = (record->bounds_min.y + record->bounds_max.y) * 0.5f;
+		center.z = (record->bounds_min.z + record->bounds_max.z) * 0.5f;
+		radius = (LGLfloat) sqrt((record->bounds_max.x - center.x) * (record->bounds_max.x - center.x)
+				+ (record->bounds_max.y - center.y) * (record->bounds_max.y - center.y)
+				+ (record->bounds_max.z - center.z) * (record->bounds_max.z - center.z));
+
+		/* the nearest point of the bounding sphere has the largest scale */
+		w = m->m41 * center.x + m->m42 * center.y + m->m43 * center.z + m->m44
+				- radius * (LGLfloat) sqrt(m->m41 * m->m41 + m->m42 * m->m42 + m->m43 * m->m43);
+		if (w > 0.0f) {
+			scale = (LGLfloat) sqrt(m->m21 * m->m21 + m->m22 * m->m22 + m->m23 * m->m23) * 0.5f * height / w;
+			for (level = num_lods - 1; level > 0 && lods[level].error * scale > pixel_error; level--)
+				;
+		}
+	}
+	record->first_index = lods[level].first_index;
+	record->index_count = lods[level].index_count;
+	return level;
+}
+
+/*
+ *  Meshlet functions
+ */
+
+/* unit normal of triangle t, zero for degenerate triangles */
+static void ilgluTriangleNormal(LGLv3f* n, LGLdata indices, LGLindextype type, LGLsize t, const LGLv3f* vertices) {
+	LGLfloat length;
+
+	ilgluCross(n, &vertices[ilgluGetIndex(indices, type, t * 3 + 0)], &vertices[ilgluGetIndex(indices, type, t * 3 + 1)],
+			&vertices[ilgluGetIndex(indices, type, t * 3 + 2)]);
+	length = (LGLfloat) sqrt(n->x * n->x + n->y * n->y + n->z * n->z);
+	if (length > 0.0f) {
+		n->x /= length;
+		n->y /= length;
+		n->z /= length;
+	}
+}
+
+/* sphere around the vertices and cone around the face normals of triangles first to first + count - 1 */
+static void ilgluBoundMeshlet(LGLUmeshlet* meshlet, LGLdata indices, LGLindextype type, const LGLv3f* vertices) {
+	const LGLsize first = meshlet->first_index / 3, last = first + meshlet->index_count / 3;
+	LGLv3f min, max, axis = { 0.0f, 0.0f, 0.0f }, n;
+	LGLfloat r2 = 0.0f, length, mindp = 1.0f;
+	LGLsize i, t;
+
+	min = max = vertices[ilgluGetIndex(indices, type, meshlet->first_index)];
+	for (i = meshlet->first_index; i < meshlet->first_index + meshlet->index_count; i++) {
+		const LGLv3f* v = &vertices[ilgluGetIndex(indices, type, i)];
+		min.x = v->x < min.x ? v->x : min.x;
+		min.y = v->y < min.y ? v->y : min.y;
+		min.z = v->z < min.z ? v->z : min.z;
+		max.x = v->x > max.x ? v->x : max.x;
+		max.y = v->y > max.y ? v->y : max.y;
+		max.z = v->z > max.z ? v->z : max.z;
+	}
+	meshlet->center.x = (min.x + max.x) * 0.5f;
+	meshlet->center.y = (min.y + max.y) * 0.5f;
+	meshlet->center.z = (min.z + max.z) * 0.5f;
+	for (i = meshlet->first_index; i < meshlet->first_index + meshlet->index_count; i++) {
+		const LGLv3f* v = &vertices[ilgluGetIndex(indices, type, i)];
+		const LGLfloat dx = v->x - meshlet->center.x, dy = v->y - meshlet->center.y, dz = v->z - meshlet->center.z;
+		if (dx * dx + dy * dy + dz * dz > r2) {
+			r2 = dx * dx + dy * dy + dz * dz;
+		}
+	}
+	meshlet->radius = (LGLfloat) sqrt(r2);
+
+	for (t = first; t < last; t++) {
+		ilgluTriangleNormal(&n, indices, type, t, vertices);
+		axis.x += n.x;
+		axis.y += n.y;
+		axis.z += n.z;
+	}
+	length = (LGLfloat) sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+	for (t = first; t < last && length > 0.0f; t++) {
+		LGLfloat dp;
+		ilgluTriangleNormal(&n, indices, type, t, vertices);
+		dp = (n.x * axis.x + n.y * axis.y + n.z * axis.z) / length;
+		mindp = dp < mindp ? dp : mindp;
+	}
+
+	/* a cone of 90 degrees or more has a front face in every direction, the zero axis never culls */
+	if (length > 0.0f && mindp > 0.0f) {
+		meshlet->cone_axis.x = axis.x / length;
+		meshlet->cone_axis.y = axis.y / length;
+		meshlet->cone_axis.z = axis.z / length;
+		meshlet->cone_cutoff = (LGLfloat) sqrt(1.0f - mindp * mindp);
+	} else {
+		meshlet->cone_axis.x = meshlet->cone_axis.y = meshlet->cone_axis.z = 0.0f;
+		meshlet->cone_cutoff = 1.0f;
+	}
+}
+
+#define ILGLU_MESHLET_MIN_TRIANGLES 8
+
+/*
+ * Grows each meshlet from the first unused triangle, adding the adjacent triangle with the fewest new vertices
+ * and the lowest score. Like meshoptimizer's, the score weighs the distance from the meshlet's center against
+ * the angle to its average normal by cone_weight. Large meshlets of a coarse mesh span more than 90 degrees and
+ * never cull, so with cone_weight > 0 a meshlet of ILGLU_MESHLET_MIN_TRIANGLES or more also closes when the best
+ * triangle's normal is further from its average than cone_weight, the cosine, or when no adjacent triangle is
+ * left. Otherwise it continues with the next unused triangle.
+ */
+LGLsize lgluBuildMeshlets(LGLUmeshlet meshlets[], LGLdata indices, LGLindextype type, LGLsize num_indices,
+		const LGLv3f* vertices, LGLsize num_vertices, LGLfloat cone_weight) {
+	const LGLsize num_triangles = num_indices / 3;
+	LGLuint *offsets, *triangles, *marks, *locals, *output;
+	LGLuint members[LGLU_MESHLET_VERTICES], local[LGLU_MESHLET_TRIANGLES * 3];
+	LGLv3f* normals;
+	unsigned char* emitted;
+	LGLsize num_meshlets = 0, cursor = 0, written = 0, i;
+	LGLfloat radius, area = 0.0f;
+
+	assert(meshlets != NULL || num_indices == 0);
+	assert(indices != NULL || num_indices == 0);
+	assert(vertices != NULL || num_vertices == 0);
+	assert(num_indices % 3 == 0);
+	assert(cone_weight >= 0.0f && cone_weight <= 1.0f);
+
+	if (num_triangles == 0) {
+		return 0;
+	}
+	if (!ilgluBuildAdjacency(&offsets, &triangles, indices, type, num_indices, num_vertices)) {
+		return 0;
+	}
+	marks = calloc(num_vertices, sizeof(LGLuint));
+	locals = malloc(sizeof(LGLuint) * num_vertices);
+	output = malloc(sizeof(LGLuint) * num_indices);
+	normals = malloc(sizeof(LGLv3f) * num_triangles);
+	emitted = calloc(num_triangles, 1);
+	if (marks == NULL || locals == NULL || output == NULL || normals == NULL || emitted == NULL) {
+		free(marks);
+		free(locals);
+		free(output);
+		free(normals);
+		free(emitted);
+		free(offsets);
+		free(triangles);
+		return 0;
+	}
+	for (i = 0; i < num_triangles; i++) {
+		LGLv3f* n = &normals[i];
+		LGLfloat length;
+		ilgluCross(n, &vertices[ilgluGetIndex(indices, type, i * 3 + 0)],
+				&vertices[ilgluGetIndex(indices, type, i * 3 + 1)], &vertices[ilgluGetIndex(indices, type, i * 3 + 2)]);
+		length = (LGLfloat) sqrt(n->x * n->x + n->y * n->y + n->z * n->z);
+		if (length > 0.0f) {
+			n->x /= length;
+			n->y /= length;
+			n->z /= length;
+		}
+		area += length * 0.5f;
+	}
+	/* of a disc of LGLU_MESHLET_TRIANGLES average triangles, distances are measured in it */
+	radius = (LGLfloat) sqrt(area / num_triangles * LGLU_MESHLET_TRIANGLES / 3.14159265);
+	if (!(radius > 0.0f)) {
+		radius = 1.0f;
+	}
+
+	while (written < num_indices) {
+		LGLUmeshlet* meshlet = &meshlets[num_meshlets++];
+		const LGLuint mark = (LGLuint) num_meshlets; /* vertices of this meshlet */
+		LGLv3f axis = { 0.0f, 0.0f, 0.0f }, sum = { 0.0f, 0.0f, 0.0f };
+		LGLuint num_members = 0, count = 0, k;
+		LGLint next;
+
+		while (emitted[cursor]) {
+			cursor++;
+		}
+		next = (LGLint) cursor;
+		meshlet->first_index = written;
+
+		while (next >= 0) {
+			LGLint best = -1;
+			LGLuint best_new = 4, m;
+			LGLfloat best_score = 0.0f, best_spread = 1.0f, length;
+			LGLv3f center;
+
+			emitted[next] = 1;
+			for (k = 0; k < 3; k++) {
+				const LGLuint v = ilgluGetIndex(indices, type, next * 3 + k);
+				output[written++] = v;
+				if (marks[v] != mark) {
+					marks[v] = mark;
+					locals[v] = num_members;
+					members[num_members++] = v;
+					sum.x += vertices[v].x;
+					sum.y += vertices[v].y;
+					sum.z += vertices[v].z;
+				}
+			}
+			axis.x += normals[next].x;
+			axis.y += normals[next].y;
+			axis.z += normals[next].z;
+			if (++count == LGLU_MESHLET_TRIANGLES) {
+				break;
+			}
+
+			length = (LGLfloat) sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+			length = length > 0.0f ? 1.0f / length : 0.0f;
+			center.x = sum.x / num_members;
+			center.y = sum.y / num_members;
+			center.z = sum.z / num_members;
+			for (m = 0; m < num_members; m++) {
+				LGLuint s;
+				for (s = offsets[members[m]]; s < offsets[members[m] + 1]; s++) {
+					const LGLuint t = triangles[s];
+					const LGLv3f* n = &normals[t];
+					LGLuint added = 0;
+					LGLv3f d = { 0.0f, 0.0f, 0.0f };
+					LGLfloat spread, cone, score;
+					if (emitted[t]) {
+						continue;
+					}
+					for (k = 0; k < 3; k++) {
+						const LGLuint v = ilgluGetIndex(indices, type, t * 3 + k);
+						added += marks[v] != mark;
+						d.x += vertices[v].x;
+						d.y += vertices[v].y;
+						d.z += vertices[v].z;
+					}
+					d.x = d.x / 3.0f - center.x;
+					d.y = d.y / 3.0f - center.y;
+					d.z = d.z / 3.0f - center.z;
+					spread = (n->x * axis.x + n->y * axis.y + n->z * axis.z) * length;
+					cone = 1.0f - spread * cone_weight;
+					cone = cone > 1e-3f ? cone : 1e-3f;
+					score = (1.0f + (LGLfloat) sqrt(d.x * d.x + d.y * d.y + d.z * d.z) / radius * (1.0f - cone_weight))
+							* cone;
+					if (added < best_new || (added == best_new && score < best_score)) {
+						best = (LGLint) t;
+						best_new = added;
+						best_score = score;
+						best_spread = spread;
+					}
+				}
+			}
+			if (cone_weight > 0.0f && count >= ILGLU_MESHLET_MIN_TRIANGLES && (best < 0 || best_spread < cone_weight)) {
+				break;
+			}
+			if (best < 0) {
+				while (cursor < num_triangles && emitted[cursor]) {
+					cursor++;
+				}
+				if (cursor < num_triangles) {
+					best = (LGLint) cursor;
+					best_new = 3;
+				}
+			}
+			next = best >= 0 && num_members + best_new <= LGLU_MESHLET_VERTICES ? best : -1;
+		}
+		meshlet->index_count = written - meshlet->first_index;
+
+		/* the meshlet is drawn on its own, reorder it for the vertex cache in its local vertex numbering */
+		for (i = 0; i < meshlet->index_count; i++) {
+			local[i] = locals[output[meshlet->first_index + i]];
+		}
+		if (lgluOptimizeVertexCache(local, LGL_INDEX_TYPE_UINT, meshlet->index_count, num_members)) {
+			for (i = 0; i < meshlet->index_count; i++) {
+				output[meshlet->first_index + i] = members[local[i]];
+			}
+		}
+	}
+
+	for (i = 0; i < num_indices; i++) {
+		ilgluSetIndex(indices, type, i, output[i]);
+	}
+	for (i = 0; i < num_meshlets; i++) {
+		ilgluBoundMeshlet(&meshlets[i], indices, type, vertices);
+	}
+	free(marks);
+	free(locals);
+	free(output);
+	free(normals);
+	free(emitted);
+	free(offsets);
+	free(triangles);
+	return num_meshlets;
+}
+
+/*
+ * The eye is the point the transform maps to w = 0, column three of the inverse. Affine transforms have no
+ * such point, the column is then the view direction. A meshlet faces away when every direction from the eye
+ * to its sphere is within 90 degrees minus the cone's angle of the cone axis.
+ */
+LGLsize lgluCullMeshlets(LGLdrawrecord visible[], const LGLdrawrecord* record, const LGLUmeshlet meshlets[],
+		LGLsize count, const LGLm4x4f* transform) {
+	LGLUfrustum frustum;
+	LGLm4x4f inverse;
+	LGLv3f eye = { 0.0f, 0.0f, 0.0f };
+	LGLfloat w = 0.0f;
+	LGLint cones;
+	LGLsize i, num_visible = 0;
+
+	assert(visible != NULL || count == 0);
+	assert(record != NULL);
+	assert(meshlets != NULL || count == 0);
+	assert(transform != NULL);
+
+	lgluFrustumFromMatrix(&frustum, transform);
+	cones = lgluMatrixInverse(&inverse, transform);
+	if (cones) {
+		eye.x = inverse.m13;
+		eye.y = inverse.m23;
+		eye.z = inverse.m33;
+		w = inverse.m43;
+		if (fabs(w) > 1e-6f * sqrt(eye.x * eye.x + eye.y * eye.y + eye.z * eye.z)) {
+			eye.x /= w;
+			eye.y /= w;
+			eye.z /= w;
+		} else {
+			w = 0.0f;
+			lgluVectorNormalize(&eye);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		const LGLUmeshlet* meshlet = &meshlets[i];
+		LGLdrawrecord* last = num_visible > 0 ? &visible[num_visible - 1] : NULL;
+
+		if (lgluFrustumTestSphere(&frustum, &meshlet->center, meshlet->radius) == LGLU_OUTSIDE) {
+			continue;
+		}
+		if (cones && w != 0.0f) {
+			const LGLfloat dx = meshlet->center.x - eye.x, dy = meshlet->center.y - eye.y, dz = meshlet->center.z - eye.z;
+			if (dx * meshlet->cone_axis.x + dy * meshlet->cone_axis.y + dz * meshlet->cone_axis.z
+					>= meshlet->cone_cutoff * (LGLfloat) sqrt(dx * dx + dy * dy + dz * dz) + meshlet->radius) {
+				continue;
+			}
+		} else if (cones && eye.x * meshlet->cone_axis.x + eye.y * meshlet->cone_axis.y
+				+ eye.z * meshlet->cone_axis.z >= meshlet->cone_cutoff) {
+			continue;
+		}
+
+		/* neighbouring visible meshlets merge into one record */
+		if (last != NULL && last->first_index + last->index_count == record->first_index + meshlet->first_index) {
+			last->index_count += meshlet->index_count;
+			continue;
+		}
+		visible[num_visible] = *record;
+		visible[num_visible].first_index = record->first_index + meshlet->first_index;
+		visible[num_visible].index_count = meshlet->index_count;
+		visible[num_visible].bounds_transform = NULL; /* tested already */
+		num_visible++;
+	}
+	return num_visible;
+}
+
+/*
+ *  Texture cache functions
+ */
+
+#define ILGLU_MAX_LEVELS 16
+
+typedef struct ILGLUlevel_s {
+	LGLtexel* data; /* NULL if not resident */
+	LGLfence fence; /* of the frame that last bound the level */
+	LGLint bound; /* bound since the last lgluTextureCacheFence */
+	LGLint prev, next; /* the LRU list of resident levels, texture * ILGLU_MAX_LEVELS + level, -1 ends it */
+} ILGLUlevel;
+
+typedef struct ILGLUtexture_s {
+	LGLUtextureloader load;
+	void* user;
+	LGLuint width, height;
+	LGLuint num_levels;
+	ILGLUlevel levels[ILGLU_MAX_LEVELS];
+} ILGLUtexture;
+
+struct LGLUtexturecache_s {
+	LGLcontext* context;
+	LGLsize budget;
+	LGLsize resident; /* bytes of the resident levels */
+	ILGLUtexture* textures;
+	LGLuint num_textures, capacity;
+	LGLint head, tail; /* most and least recently bound level */
+};
+
+static LGLuint ilgluLevelWidth(const ILGLUtexture* texture, LGLuint level) {
+	return texture->width >> level > 0 ? texture->width >> level : 1;
+}
+
+static LGLuint ilgluLevelHeight(const ILGLUtexture* texture, LGLuint level) {
+	return texture->height >> level > 0 ? texture->height >> level : 1;
+}
+
+static LGLsize ilgluLevelSize(const ILGLUtexture* texture, LGLuint level) {
+	return sizeof(LGLtexel) * ilgluLevelWidth(texture, level) * ilgluLevelHeight(texture, level);
+}
+
+static ILGLUlevel* ilgluLevel(LGLUtexturecache* cache, LGLint id) {
+	return &cache->textures[id / ILGLU_MAX_LEVELS].levels[id % ILGLU_MAX_LEVELS];
+}
+
+static void ilgluUnlinkLevel(LGLUtexturecache* cache, LGLint id) {
+	ILGLUlevel* level = ilgluLevel(cache, id);
+	if (level->prev >= 0) {
+		ilgluLevel(cache, level->prev)->next = level->next;
+	} else {
+		cache->head = level->next;
+	}
+	if (level->next >= 0) {
+		ilgluLevel(cache, level->next)->prev = level->prev;
+	} else {
+		cache->tail = level->prev;
+	}
+	level->prev = level->next = -1;
+}
+
+static void ilgluLinkLevel(LGLUtexturecache* cache, LGLint id) {
+	ILGLUlevel* level = ilgluLevel(cache, id);
+	level->prev = -1;
+	level->next = cache->head;
+	if (cache->head >= 0) {
+		ilgluLevel(cache, cache->head)->prev = id;
+	} else {
+		cache->tail = id;
+	}
+	cache->head = id;
+}
+
+/* halves both sides of width x height texels, rounding per channel, odd sides repeat their last texel */
+static void ilgluDownsample(LGLtexel* d, const LGLtexel* s, LGLuint width, LGLuint height) {
+	const LGLuint dw = width > 1 ? width / 2 : 1;
+	const LGLuint dh = height > 1 ? height / 2 : 1;
+	LGLuint x, y, c;
+
+	for (y = 0; y < dh; y++) {
+		const LGLtexel* r1 = &s[(y * 2) * width];
+		const LGLtexel* r2 = &s[(y * 2 + 1 < height ? y * 2 + 1 : y * 2) * width];
+		for (x = 0; x < dw; x++) {
+			const LGLuint x1 = x * 2, x2 = x * 2 + 1 < width ? x * 2 + 1 : x * 2;
+			LGLtexel t = 0;
+			for (c = 0; c < 32; c += 8) {
+				const LGLuint sum = (r1[x1] >> c & 0xff) + (r1[x2] >> c & 0xff) + (r2[x1] >> c & 0xff)
+						+ (r2[x2] >> c & 0xff);
+				t |= (sum + 2) / 4 << c;
+			}
+			d[y * dw + x] = t;
+		}
+	}
+}
+
+/* evicts least recently bound levels until size more bytes fit, returns 0 if they do not */
+static LGLint ilgluEvictLevels(LGLUtexturecache* cache, LGLsize size) {
+	while (cache->resident + size > cache->budget && cache->tail >= 0) {
+		const LGLint id = cache->tail;
+		ILGLUlevel* level = ilgluLevel(cache, id);
+		if (level->bound) { /* every level towards the head was bound in this frame too */
+			return 0;
+		}
+		lglWaitFence(cache->context, level->fence); /* the oldest fence of all, usually signaled */
+		ilgluUnlinkLevel(cache, id);
+		cache->resident -= ilgluLevelSize(&cache->textures[id / ILGLU_MAX_LEVELS], id % ILGLU_MAX_LEVELS);
+		free(level->data);
+		level->data = NULL;
+	}
+	return cache->resident + size <= cache->budget;
+}
+
+/*
+ * Bytes ilgluLoadLevel allocates besides the level: the reloaded full resolution source, and while
+ * downsampling the previous level along with the next one.
+ */
+static LGLsize ilgluLoadTransient(const ILGLUtexture* texture, LGLuint level) {
+	LGLint i = level;
+	LGLsize held, peak;
+	LGLuint j;
+
+	while (--i >= 0 && texture->levels[i].data == NULL)
+		;
+	held = i < 0 ? ilgluLevelSize(texture, 0) : 0;
+	peak = held;
+	for (j = i < 0 ? 0 : i; j < level; j++) {
+		const LGLsize next = ilgluLevelSize(texture, j + 1);
+		peak = held + next > peak ? held + next : peak;
+		held = next;
+	}
+	return peak - ilgluLevelSize(texture, level);
+}
+
+/* loads the level from the nearest finer resident level, or from the source */
+static LGLtexel* ilgluLoadLevel(ILGLUtexture* texture, LGLuint level) {
+	LGLtexel *s, *d;
+	LGLint i = level;
+	LGLuint j;
+
+	while (--i >= 0 && texture->levels[i].data == NULL)
+		;
+	if (i < 0) {
+		s = malloc(ilgluLevelSize(texture, 0));
+		if (s == NULL || !texture->load(texture->user, s, texture->width, texture->height)) {
+			free(s);
+			return NULL;
+		}
+		i = 0;
+	} else {
+		s = texture->levels[i].data;
+	}
+
+	for (j = i; j < level; j++) {
+		d = malloc(ilgluLevelSize(texture, j + 1));
+		if (d != NULL) {
+			ilgluDownsample(d, s, ilgluLevelWidth(texture, j), ilgluLevelHeight(texture, j));
+		}
+		if (s != texture->levels[j].data) {
+			free(s);
+		}
+		if (d == NULL) {
+			return NULL;
+		}
+		s = d;
+	}
+	return s;
+}
+
+LGLUtexturecache* lgluCreateTextureCache(LGLcontext* context, LGLsize budget) {
+	LGLUtexturecache* cache;
+	assert(context != NULL);
+
+	cache = calloc(1, sizeof(LGLUtexturecache));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->context = context;
+	cache->budget = budget;
+	cache->head = cache->tail = -1;
+	return cache;
+}
+
+void lgluDestroyTextureCache(LGLUtexturecache* cache) {
+	LGLuint i, j;
+	assert(cache != NULL);
+
+	lglFinish(cache->context);
+	for (i = 0; i < cache->num_textures; i++) {
+		for (j = 0; j < cache->textures[i].num_levels; j++) {
+			free(cache->textures[i].levels[j].data);
+		}
+	}
+	free(cache->textures);
+	free(cache);
+}
+
+LGLint lgluAddTexture(LGLUtexturecache* cache, LGLuint width, LGLuint height, LGLUtextureloader load, void* user) {
+	ILGLUtexture* texture;
+	LGLuint i;
+
+	assert(cache != NULL);
+	assert(width > 0 && height > 0);
+	assert(load != NULL);
+
+	if (cache->num_textures == cache->capacity) {
+		const LGLuint capacity = cache->capacity ? cache->capacity * 2 : 16;
+		ILGLUtexture* textures = realloc(cache->textures, sizeof(ILGLUtexture) * capacity);
+		if (textures == NULL) {
+			return -1;
+		}
+		cache->textures = textures;
+		cache->capacity = capacity;
+	}
+
+	texture = &cache->textures[cache->num_textures];
+	memset(texture, 0, sizeof(ILGLUtexture));
+	texture->load = load;
+	texture->user = user;
+	texture->width = width;
+	texture->height = height;
+	for (texture->num_levels = 1; (width | height) >> texture->num_levels != 0; texture->num_levels++)
+		;
+	assert(texture->num_levels <= ILGLU_MAX_LEVELS);
+	for (i = 0; i < texture->num_levels; i++) {
+		texture->levels[i].prev = texture->levels[i].next = -1;
+	}
+	return cache->num_textures++;
+}
+
+LGLint lgluBindTexture(LGLUtexturecache* cache, LGLuint texture, LGLuint index, LGLfloat size) {
+	ILGLUtexture* t;
+	ILGLUlevel* level;
+	LGLuint l = 0;
+	LGLint id;
+
+	assert(cache != NULL);
+	assert(texture < cache->num_textures);
+
+	t = &cache->textures[texture];
+	while (l + 1 < t->num_levels && (LGLfloat) ilgluLevelWidth(t, l + 1) >= size
+			&& (LGLfloat) ilgluLevelHeight(t, l + 1) >= size) {
+		l++;
+	}
+
+	/* a resident level or the first one that fits, coarser levels need less room */
+	for (; l < t->num_levels; l++) {
+		if (t->levels[l].data != NULL || ilgluEvictLevels(cache, ilgluLevelSize(t, l)) || l + 1 == t->num_levels) {
+			break;
+		}
+	}
+	level = &t->levels[l];
+	id = texture * ILGLU_MAX_LEVELS + l;
+
+	if (level->data == NULL) {
+		/* room for the transient too where the budget allows, evicting the finer source level makes it grow */
+		LGLsize transient;
+		do {
+			transient = ilgluLoadTransient(t, l);
+			ilgluEvictLevels(cache, ilgluLevelSize(t, l) + transient);
+		} while (ilgluLoadTransient(t, l) != transient);
+		level->data = ilgluLoadLevel(t, l);
+		if (level->data == NULL) {
+			return -1;
+		}
+		cache->resident += ilgluLevelSize(t, l);
+	} else {
+		ilgluUnlinkLevel(cache, id);
+	}
+	ilgluLinkLevel(cache, id);
+	level->bound = 1;
+	ilgluEvictLevels(cache, 0); /* a coarsest level loaded over the budget in an earlier frame */
+
+	lglSetTextureData2d(cache->context, index, level->data, ilgluLevelWidth(t, l), ilgluLevelHeight(t, l));
+	return l;
+}
+
+void lgluTextureCacheFence(LGLUtexturecache* cache, LGLfence fence) {
+	LGLint id;
+	assert(cache != NULL);
+
+	/* the levels bound since the last fence lead the list */
+	for (id = cache->head; id >= 0 && ilgluLevel(cache, id)->bound; id = ilgluLevel(cache, id)->next) {
+		ilgluLevel(cache, id)->bound = 0;
+		ilgluLevel(cache, id)->fence = fence;
+	}
+}
+
+LGLsize lgluTextureCacheResident(const LGLUtexturecache* cache) {
+	assert(cache != NULL);
+	return cache->resident;
+}
+
 /* Utility functions */
 
 /*
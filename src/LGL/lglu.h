@@ -21,6 +21,8 @@ void lgluMatrixSetRotationY(LGLm4x4f* m, LGLfloat theta);
 void lgluMatrixSetRotationZ(LGLm4x4f* m, LGLfloat theta);
 void lgluMatrixSetOrtho(LGLm4x4f* m, LGLfloat left, LGLfloat right, LGLfloat bottom, LGLfloat top, LGLfloat near,
 		LGLfloat far);
+void lgluMatrixSetFrustum(LGLm4x4f* m, LGLfloat left, LGLfloat right, LGLfloat bottom, LGLfloat top, LGLfloat near,
+		LGLfloat far);
 void lgluMatrixSetLookAt(LGLm4x4f* m, const LGLv3f* eye, const LGLv3f* center, const LGLv3f* up);
 void lgluMatrixMultiply(LGLm4x4f* d, const LGLm4x4f* m1, const LGLm4x4f* m2);
 LGLint lgluMatrixInverse(LGLm4x4f* o, const LGLm4x4f* m);
@@ -30,4 +32,147 @@ void lgluVectorNormalize(LGLv3f* v);
 LGLfloat lgluVectorDot(LGLv3f* a, LGLv3f* b);
 void lgluInterpolatev3f(LGLv3f* o, LGLfloat a, const LGLv3f* v1, LGLfloat b, const LGLv3f* v2, LGLfloat c, const LGLv3f* v3);
 
+/* Array functions, d[i] = m * v[i] for i = 0 to count - 1, d may equal v but must not overlap it otherwise */
+
+void lgluTransformArray(LGLv3f* d, const LGLm4x4f* m, const LGLv3f* v, LGLsize count);
+void lgluMatrixMultiplyArray(LGLm4x4f* d, const LGLm4x4f* m, const LGLm4x4f* v, LGLsize count);
+void lgluVectorNormalizeArray(LGLv3f* v, LGLsize count);
+
+/*
+ * Frustum functions. lgluFrustumFromMatrix extracts the planes of the clip volume -w <= x, y, z <= w of a
+ * transform, usually model view projection, in the space the transform is applied to. w is 1 for the affine
+ * transforms of lgluTransform. Planes are normalized, a * x + b * y + c * z + d is the distance to the plane,
+ * positive inside. The tests are conservative, boxes near the corners of the volume may intersect.
+ */
+
+typedef struct LGLUfrustum_s {
+	LGLv4f planes[6]; /* left, right, bottom, top, near, far */
+} LGLUfrustum;
+
+typedef enum LGLUvisibility_e {
+	LGLU_OUTSIDE, LGLU_INTERSECTS, LGLU_INSIDE
+} LGLUvisibility;
+
+void lgluFrustumFromMatrix(LGLUfrustum* f, const LGLm4x4f* m);
+LGLUvisibility lgluFrustumTestSphere(const LGLUfrustum* f, const LGLv3f* center, LGLfloat radius);
+LGLUvisibility lgluFrustumTestBox(const LGLUfrustum* f, const LGLv3f* min, const LGLv3f* max);
+
+/*
+ * Mesh functions for triangle lists, run once after loading. lgluOptimizeVertexCache reorders the triangles for
+ * the vertex cache lglDraw* use for triangle lists: first in first out, LGLU_VERTEX_CACHE_SIZE entries, a hit
+ * does not move a vertex to the front. lgluOptimizeOverdraw then moves clusters of them that likely occlude the
+ * rest to the front, a threshold of 1.2 allows about 20% more cache misses. Then lgluOptimizeVertexFetch
+ * renumbers the vertices in first use order, writes the new index of vertex i to remap[i] and returns the number
+ * of used vertices, unused ones move to the end. lgluRemapVertices copies vertex i of v, size bytes each, to
+ * d[remap[i]], d must not overlap v. Functions returning LGLint return 0 and leave the mesh unchanged when out
+ * of memory.
+ */
+
+#define LGLU_VERTEX_CACHE_SIZE 32
+
+LGLint lgluOptimizeVertexCache(LGLdata indices, LGLindextype type, LGLsize num_indices, LGLsize num_vertices);
+LGLint lgluOptimizeOverdraw(LGLdata indices, LGLindextype type, LGLsize num_indices, const LGLv3f* vertices,
+		LGLsize num_vertices, LGLfloat threshold);
+LGLsize lgluOptimizeVertexFetch(LGLuint* remap, LGLdata indices, LGLindextype type, LGLsize num_indices,
+		LGLsize num_vertices);
+void lgluRemapVertices(void* d, const void* v, LGLsize size, LGLsize num_vertices, const LGLuint* remap);
+
+/*
+ * LOD functions. lgluSimplify collapses edges of a triangle list by quadric error until at most target_indices
+ * are left or the next collapse would move the surface further than max_error, writes the indices to d, which
+ * may equal indices, and returns their count. It keeps the vertices, error receives the distance reached.
+ * lgluBuildLods stores level 0, the original, and levels of ratio times the previous triangles each in d, until
+ * max_lods, a level that simplifies poorly or capacity indices are reached, num_indices * 3 is enough for a ratio
+ * of 0.5. It returns the number of levels. lgluSelectLod sets the index range of record to the coarsest level
+ * whose error stays below pixel_error pixels, projected by bounds_transform at the nearest point of the bounds,
+ * height is the viewport height. Records without bounds_transform get level 0.
+ */
+
+typedef struct LGLUlod_s {
+	LGLsize first_index;
+	LGLsize index_count;
+	LGLfloat error; /* object space distance to the original surface */
+} LGLUlod;
+
+LGLsize lgluSimplify(LGLdata d, LGLdata indices, LGLindextype type, LGLsize num_indices, const LGLv3f* vertices,
+		LGLsize num_vertices, LGLsize target_indices, LGLfloat max_error, LGLfloat* error);
+LGLuint lgluBuildLods(LGLUlod lods[], LGLuint max_lods, LGLdata d, LGLsize capacity, LGLdata indices,
+		LGLindextype type, LGLsize num_indices, const LGLv3f* vertices, LGLsize num_vertices, LGLfloat ratio);
+LGLuint lgluSelectLod(LGLdrawrecord* record, const LGLUlod lods[], LGLuint num_lods, LGLfloat height,
+		LGLfloat pixel_error);
+
+/*
+ * Meshlet functions. lgluBuildMeshlets reorders the triangles of a list into meshlets of at most
+ * LGLU_MESHLET_VERTICES vertices and LGLU_MESHLET_TRIANGLES triangles, each a contiguous index range with a
+ * bounding sphere and a cone around its face normals, counter-clockwise triangles face out. cone_weight in
+ * [0, 1] trades vertex reuse for narrower cones, which cull more: 0 builds the largest meshlets, above 0 they
+ * close early when their normals spread. Each meshlet is reordered for the vertex cache. meshlets must hold
+ * num_indices / 24 + 1 entries, the number built is returned, 0 when out of memory. lgluCullMeshlets copies
+ * record once per visible run of meshlets to visible, which must hold count entries, offsetting their ranges by
+ * the record's first_index, and returns the number of records. Meshlets outside the clip volume of transform or
+ * facing away from its eye are dropped, so use it only for meshes whose back faces need not be drawn.
+ */
+
+#define LGLU_MESHLET_VERTICES 64
+#define LGLU_MESHLET_TRIANGLES 124
+
+typedef struct LGLUmeshlet_s {
+	LGLsize first_index;
+	LGLsize index_count;
+	LGLv3f center;
+	LGLfloat radius;
+	LGLv3f cone_axis; /* zero if the normals spread 90 degrees or more */
+	LGLfloat cone_cutoff; /* sine of the cone's half angle */
+} LGLUmeshlet;
+
+LGLsize lgluBuildMeshlets(LGLUmeshlet meshlets[], LGLdata indices, LGLindextype type, LGLsize num_indices,
+		const LGLv3f* vertices, LGLsize num_vertices, LGLfloat cone_weight);
+LGLsize lgluCullMeshlets(LGLdrawrecord visible[], const LGLdrawrecord* record, const LGLUmeshlet meshlets[],
+		LGLsize count, const LGLm4x4f* transform);
+
+/*
+ * Texture cache functions. A cache keeps the mip levels of its textures within budget bytes. lgluAddTexture
+ * registers a width x height texture whose full resolution texels load fills when asked, nothing is loaded
+ * yet. lgluBindTexture binds the smallest level that still covers size pixels, the texture's extent on screen,
+ * to texture unit index with lglSetTextureData2d and returns the level, -1 if it could not be loaded. Missing
+ * levels are downsampled from a finer resident level or from the reloaded source, least recently bound levels
+ * are evicted to stay within the budget. When nothing can be evicted a coarser level is bound, the coarsest
+ * level is always loaded. Levels bound since the last lgluTextureCacheFence are never evicted, pass the fence of
+ * every lglSwapBuffers, levels are evicted once the fence of their last frame is signaled. Loading also allocates
+ * the levels in between while downsampling, and full resolution level 0 when the source is reloaded. The cache
+ * evicts to fit these within the budget as far as it can, so only while loading a texture whose level 0 does not
+ * fit, or with every level bound in the frame, memory exceeds the budget for the duration of the load.
+ * lgluTextureCacheResident returns the bytes of the resident levels, the transient ones are not counted.
+ */
+
+typedef struct LGLUtexturecache_s LGLUtexturecache;
+
+/* fills data with width * height texels, top row first, returns 0 on failure */
+typedef LGLint (*LGLUtextureloader)(void* user, LGLtexel* data, LGLuint width, LGLuint height);
+
+LGLUtexturecache* lgluCreateTextureCache(LGLcontext* context, LGLsize budget);
+void lgluDestroyTextureCache(LGLUtexturecache* cache);
+LGLint lgluAddTexture(LGLUtexturecache* cache, LGLuint width, LGLuint height, LGLUtextureloader load, void* user);
+LGLint lgluBindTexture(LGLUtexturecache* cache, LGLuint texture, LGLuint index, LGLfloat size);
+void lgluTextureCacheFence(LGLUtexturecache* cache, LGLfence fence);
+LGLsize lgluTextureCacheResident(const LGLUtexturecache* cache);
+
+/*
+ * Shader math functions, precise unless lglu.c is compiled with LGLU_FAST_MATH. The precise mode rounds the
+ * exact result once to float. Relative errors of the fast mode over the stated ranges, test/shadermath.c sweeps
+ * them in both modes:
+ *   lgluShaderRsqrt      x >= FLT_MIN: 3e-7 with SSE (hardware estimate), 1.8e-3 without (bit trick), one Newton step
+ *   lgluShaderNormalize  lengths 1e-18 to 1e18 end within 3e-7 resp. 1.8e-3 of one, within 3e-7 in the precise mode
+ *   lgluShaderExp        x in [-87, 88]: 2e-7
+ *   lgluShaderPow        x >= FLT_MIN and a normal result: 2e-7 * (1 + |y * log2(x)|), x <= 0 returns 0 in both modes
+ *   lgluShaderUnorm8     clamps to [0, 1] and rounds the float product x * 255, ties to even in the fast mode and up
+ *                        otherwise
+ */
+
+LGLfloat lgluShaderRsqrt(LGLfloat x);
+void lgluShaderNormalize(LGLv3f* v);
+LGLfloat lgluShaderExp(LGLfloat x);
+LGLfloat lgluShaderPow(LGLfloat x, LGLfloat y);
+LGLuint lgluShaderUnorm8(LGLfloat x);
+
 #endif
@@ -0,0 +1,176 @@
+/*
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "../tga/tga.h"
+#include "../3ds/3ds.h"
+#include "../lmsh/lmsh.h"
+#include "asset.h"
+
+struct ASSETloader_s {
+	LGLjobsystem* jobs;
+	LGLjobgroup group; /* every load */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; /* broadcast when a load completes */
+};
+
+struct ASSET_s {
+	ASSETloader* loader;
+	ASSETtype type;
+	char* filename;
+	ASSETcallback callback;
+	void* user;
+	void* data;
+	ASSETstate state; /* written once by the loader thread, data and the callback's work happen before */
+};
+
+static void assetFree(ASSETtype type, void* data) {
+	if (data == NULL) {
+		return;
+	}
+	switch (type) {
+	case ASSET_TYPE_TGA:
+		tgaUnload(data);
+		break;
+	case ASSET_TYPE_3DS:
+		a3dsUnload(data);
+		break;
+	case ASSET_TYPE_LMSH:
+		lmshUnload(data);
+		break;
+	}
+}
+
+static void assetLoadJob(void* data, LGLuint index) {
+	ASSET* asset = data;
+	ASSETloader* loader = asset->loader;
+	ASSETstate state;
+	void* loaded = NULL;
+
+	(void) index;
+	switch (asset->type) {
+	case ASSET_TYPE_TGA:
+		loaded = tgaLoad(asset->filename);
+		break;
+	case ASSET_TYPE_3DS:
+		loaded = a3dsLoad(asset->filename, A3DS_NORMALS_FACE, loader->jobs);
+		break;
+	case ASSET_TYPE_LMSH:
+		loaded = lmshLoad(asset->filename);
+		break;
+	}
+
+	if (asset->callback != NULL && !asset->callback(asset, loaded, asset->user)) {
+		assetFree(asset->type, loaded);
+		loaded = NULL;
+	}
+	asset->data = loaded;
+	state = loaded != NULL ? ASSET_STATE_READY : ASSET_STATE_FAILED;
+
+	pthread_mutex_lock(&loader->mutex);
+	__atomic_store_n(&asset->state, state, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&loader->cond);
+	pthread_mutex_unlock(&loader->mutex);
+}
+
+/*
+ *  Loader functions
+ */
+
+ASSETloader* assetCreateLoader(unsigned int threads) {
+	ASSETloader* loader;
+
+	loader = calloc(1, sizeof(ASSETloader));
+	if (loader == NULL) {
+		return NULL;
+	}
+	loader->jobs = lglCreateJobSystem(threads, LGL_JOB_AFFINITY_NONE, 0);
+	if (loader->jobs == NULL) {
+		free(loader);
+		return NULL;
+	}
+	pthread_mutex_init(&loader->mutex, NULL);
+	pthread_cond_init(&loader->cond, NULL);
+	return loader;
+}
+
+void assetDestroyLoader(ASSETloader* loader) {
+	assert(loader != NULL);
+
+	assetWaitAll(loader);
+	lglDestroyJobSystem(loader->jobs);
+	pthread_mutex_destroy(&loader->mutex);
+	pthread_cond_destroy(&loader->cond);
+	free(loader);
+}
+
+void assetWaitAll(ASSETloader* loader) {
+	assert(loader != NULL);
+	lglWaitJobs(loader->jobs, &loader->group);
+}
+
+/*
+ *  Asset functions
+ */
+
+ASSET* assetLoad(ASSETloader* loader, ASSETtype type, const char* filename, ASSETcallback callback, void* user) {
+	ASSET* asset;
+
+	assert(loader != NULL);
+	assert(filename != NULL);
+
+	asset = calloc(1, sizeof(ASSET));
+	if (asset == NULL) {
+		return NULL;
+	}
+	asset->filename = malloc(strlen(filename) + 1);
+	if (asset->filename == NULL) {
+		free(asset);
+		return NULL;
+	}
+	strcpy(asset->filename, filename);
+	asset->loader = loader;
+	asset->type = type;
+	asset->callback = callback;
+	asset->user = user;
+	asset->state = ASSET_STATE_PENDING;
+
+	lglRunJobs(loader->jobs, &loader->group, assetLoadJob, asset, 1);
+	return asset;
+}
+
+void assetUnload(ASSET* asset) {
+	assert(asset != NULL);
+
+	assetWait(asset);
+	assetFree(asset->type, asset->data);
+	free(asset->filename);
+	free(asset);
+}
+
+ASSETstate assetGetState(const ASSET* asset) {
+	assert(asset != NULL);
+	return __atomic_load_n(&asset->state, __ATOMIC_ACQUIRE);
+}
+
+void* assetGetData(const ASSET* asset) {
+	return assetGetState(asset) == ASSET_STATE_READY ? asset->data : NULL;
+}
+
+void assetWait(ASSET* asset) {
+	ASSETloader* loader;
+
+	assert(asset != NULL);
+
+	loader = asset->loader;
+	pthread_mutex_lock(&loader->mutex);
+	while (assetGetState(asset) == ASSET_STATE_PENDING) {
+		pthread_cond_wait(&loader->cond, &loader->mutex);
+	}
+	pthread_mutex_unlock(&loader->mutex);
+}
@@ -0,0 +1,53 @@
+/*
+ *
+ */
+
+#ifndef ASSET_H_INCLUDED
+#define ASSET_H_INCLUDED
+
+#include "../LGL/lgljob.h"
+
+/*
+ * Asynchronous asset loading. assetLoad returns a handle at once, the file is decoded on the loader's own job
+ * system, so loads run in parallel with each other and never occupy the workers that render. A load completes
+ * by calling its callback on a loader thread, then its state becomes ready or failed. The render thread polls
+ * assetGetState each frame and starts using an asset once it is ready, or blocks with assetWait/assetWaitAll.
+ */
+
+typedef enum ASSETtype_e {
+	ASSET_TYPE_TGA,  /* TGA*, tgaLoad */
+	ASSET_TYPE_3DS,  /* A3DS*, a3dsLoad with face weighted normals, computed on the loader's jobs */
+	ASSET_TYPE_LMSH  /* LMSH*, lmshLoad */
+} ASSETtype;
+
+typedef enum ASSETstate_e {
+	ASSET_STATE_PENDING,
+	ASSET_STATE_READY,
+	ASSET_STATE_FAILED
+} ASSETstate;
+
+typedef struct ASSETloader_s ASSETloader;
+typedef struct ASSET_s ASSET;
+
+/*
+ * Called on a loader thread once the file is decoded, data is NULL if it could not be loaded. The callback may
+ * prepare the data for rendering, nothing reads the asset before its state changes. Returning 0 fails the
+ * asset and unloads its data.
+ */
+typedef int (*ASSETcallback)(ASSET* asset, void* data, void* user);
+
+/* Loader functions, zero threads starts one per online processor, destroying waits for pending loads */
+
+ASSETloader* assetCreateLoader(unsigned int threads);
+void assetDestroyLoader(ASSETloader* loader);
+void assetWaitAll(ASSETloader* loader);
+
+/* Asset functions, the callback may be NULL, assetGetData returns NULL unless the asset is ready */
+
+ASSET* assetLoad(ASSETloader* loader, ASSETtype type, const char* file, ASSETcallback callback, void* user);
+void assetUnload(ASSET* asset);
+ASSETstate assetGetState(const ASSET* asset);
+void* assetGetData(const ASSET* asset);
+void assetWait(ASSET* asset);
+
+#endif
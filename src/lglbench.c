@@ -0,0 +1,619 @@
+/*
+ *
+ * lglbench - synthetic LightGL workloads with machine readable results
+ *
+ * usage: lglbench [-f frames] [-j workers] [-m monkey.3ds] [scenario ...]
+ *
+ * Every scenario renders its frames into a buffered context of its own and finishes each frame before the
+ * next one starts, so frame times are latencies of whole frames. Fragments are the samples counted by an
+ * occlusion query around the draws, triangles are the ones submitted. Each scenario runs in a process forked
+ * after loading, peak memory is the resident peak of that process. Results go to stdout as JSON, the loaders
+ * report on stderr. Without scenario names all scenarios run, the monkey ones only if the mesh loads, otherwise
+ * they are listed as skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h> /* for dup, dup2 and fork */
+#include <sys/types.h>
+#include <sys/resource.h> /* for wait4 */
+#include <sys/wait.h>
+#include "LGL/lgl.h"
+#include "LGL/lglu.h"
+#include "LGL/lgljob.h"
+#include "3ds/3ds.h"
+
+/* Uniforms */
+#define UNI_OFFSET      0 /* added to the xy of normalized device coordinates */
+#define UNI_MVP_MATRIX  1 /* model * view * projection of the monkey, y points down */
+
+/* Attributes and varyings */
+#define ATR_TEXCOORD  0
+#define ATR_NORMAL    1
+
+#define TEXTURE_SIZE  256 /* power of two, sampled with wrapping */
+#define WARMUP_FRAMES 3
+
+typedef struct Bench_s Bench;
+
+typedef struct Scenario_s {
+	const char* name;
+	LGLuint width, height;
+	LGLint (*setup)(Bench* bench);
+	void (*draw)(Bench* bench);
+} Scenario;
+
+struct Bench_s {
+	LGLcontext* context;
+	LGLuint width, height;
+	LGLv3f* vertices;
+	LGLv2f* texcoords;
+	LGLuint* indices;
+	LGLsize num_vertices, num_indices;
+	LGLuint draws; /* per frame */
+	LGLuint triangles; /* per frame */
+	LGLuint frame;
+	LGLtexel* texture;
+	const A3DS* monkey;
+	LGLdrawrecord records[A3DS_MAX_OBJECTS];
+	LGLsize num_records;
+};
+
+/*
+ *  Shaders
+ */
+
+static void vsScreen(LGLvsout* out, const LGLvsin* in) {
+	const LGLv2f* offset = &in->uniforms[UNI_OFFSET].v2;
+	out->position = in->vertex_stream[in->index];
+	out->position.x += offset->x;
+	out->position.y += offset->y;
+	out->varyings[ATR_TEXCOORD].v2 = in->attributes[ATR_TEXCOORD].v2[in->index];
+}
+
+/* perspective divide in the shader, the rasterizer takes normalized device coordinates */
+static void vsMonkey(LGLvsout* out, const LGLvsin* in) {
+	const LGLm4x4f* m = &in->uniforms[UNI_MVP_MATRIX].m4x4;
+	const LGLv3f* v = &in->vertex_stream[in->index];
+	const LGLfloat iw = 1.0f / (m->m41 * v->x + m->m42 * v->y + m->m43 * v->z + m->m44);
+
+	lgluTransform(&out->position, m, v);
+	out->position.x *= iw;
+	out->position.y *= iw;
+	out->position.z *= iw;
+	out->varyings[ATR_NORMAL].v3 = in->attributes[ATR_NORMAL].v3[in->index];
+}
+
+/* the interpolated texture coordinates as color, the same interpolation work as fsTextured */
+static void fsUntextured(LGLfsout* out, const LGLfsin* in) {
+	out->color.r = in->a * in->varyings[0][ATR_TEXCOORD].v2.x + in->b * in->varyings[1][ATR_TEXCOORD].v2.x
+			+ in->c * in->varyings[2][ATR_TEXCOORD].v2.x;
+	out->color.g = in->a * in->varyings[0][ATR_TEXCOORD].v2.y + in->b * in->varyings[1][ATR_TEXCOORD].v2.y
+			+ in->c * in->varyings[2][ATR_TEXCOORD].v2.y;
+	out->color.b = 0.5f;
+}
+
+/* nearest texel, wrapping */
+static void fsTextured(LGLfsout* out, const LGLfsin* in) {
+	const LGLtexture2d* t = &in->textures[0].t2d;
+	const LGLfloat u = in->a * in->varyings[0][ATR_TEXCOORD].v2.x + in->b * in->varyings[1][ATR_TEXCOORD].v2.x
+			+ in->c * in->varyings[2][ATR_TEXCOORD].v2.x;
+	const LGLfloat v = in->a * in->varyings[0][ATR_TEXCOORD].v2.y + in->b * in->varyings[1][ATR_TEXCOORD].v2.y
+			+ in->c * in->varyings[2][ATR_TEXCOORD].v2.y;
+	const LGLuint x = (LGLuint) (LGLint) floorf(u * t->width) & (t->width - 1);
+	const LGLuint y = (LGLuint) (LGLint) floorf(v * t->height) & (t->height - 1);
+	const LGLtexel texel = t->data[y * t->width + x];
+
+	out->color.r = (texel >> 16 & 0xff) * (1.0f / 255.0f);
+	out->color.g = (texel >> 8 & 0xff) * (1.0f / 255.0f);
+	out->color.b = (texel & 0xff) * (1.0f / 255.0f);
+}
+
+static void fsNormal(LGLfsout* out, const LGLfsin* in) {
+	LGLv3f n;
+	lgluInterpolatev3f(&n, in->a, &in->varyings[0][ATR_NORMAL].v3, in->b, &in->varyings[1][ATR_NORMAL].v3, in->c,
+			&in->varyings[2][ATR_NORMAL].v3);
+	lgluShaderNormalize(&n);
+	out->color.r = n.x * 0.5f + 0.5f;
+	out->color.g = n.y * 0.5f + 0.5f;
+	out->color.b = n.z * 0.5f + 0.5f;
+}
+
+/*
+ *  Geometry
+ */
+
+static LGLint benchAlloc(Bench* bench, LGLsize num_vertices, LGLsize num_indices) {
+	bench->vertices = malloc(sizeof(LGLv3f) * num_vertices);
+	bench->texcoords = malloc(sizeof(LGLv2f) * num_vertices);
+	bench->indices = malloc(sizeof(LGLuint) * num_indices);
+	bench->num_vertices = num_vertices;
+	bench->num_indices = num_indices;
+	bench->triangles = num_indices / 3;
+	bench->draws = 1;
+	return bench->vertices != NULL && bench->texcoords != NULL && bench->indices != NULL;
+}
+
+static void benchSetVertex(Bench* bench, LGLuint i, LGLfloat x, LGLfloat y, LGLfloat z, LGLfloat u, LGLfloat v) {
+	bench->vertices[i].x = x;
+	bench->vertices[i].y = y;
+	bench->vertices[i].z = z;
+	bench->texcoords[i].x = u;
+	bench->texcoords[i].y = v;
+}
+
+static void benchSetQuad(Bench* bench, LGLuint quad, LGLuint v00, LGLuint v10, LGLuint v01, LGLuint v11) {
+	LGLuint* i = &bench->indices[quad * 6];
+	i[0] = v00;
+	i[1] = v10;
+	i[2] = v11;
+	i[3] = v00;
+	i[4] = v11;
+	i[5] = v01;
+}
+
+static void benchBindStreams(Bench* bench, LGLfragmentshader fsproc) {
+	LGLvaryinglayout layout;
+	LGLv2f offset = { 0.0f, 0.0f };
+
+	layout.num_varyings = 1;
+	layout.components[ATR_TEXCOORD] = 2;
+	lglSetVaryingLayout(bench->context, &layout);
+	lglSetVertexShader(bench->context, vsScreen);
+	lglSetFragmentShader(bench->context, fsproc);
+	lglSetUniformv2f(bench->context, UNI_OFFSET, &offset);
+	lglSetVertexStream(bench->context, bench->vertices, bench->num_vertices);
+	lglSetIndexStream(bench->context, bench->indices, bench->num_indices);
+	lglSetVertexAttribsv2f(bench->context, ATR_TEXCOORD, bench->texcoords, bench->num_vertices);
+}
+
+/* cols x rows quads covering the screen, the texture repeats once per 64 pixels */
+static LGLint benchGrid(Bench* bench, LGLuint cols, LGLuint rows, LGLfragmentshader fsproc) {
+	LGLuint x, y;
+
+	if (!benchAlloc(bench, (cols + 1) * (rows + 1), cols * rows * 6)) {
+		return 0;
+	}
+	for (y = 0; y <= rows; y++) {
+		for (x = 0; x <= cols; x++) {
+			benchSetVertex(bench, y * (cols + 1) + x, x * 2.0f / cols - 1.0f, y * 2.0f / rows - 1.0f, 0.0f,
+					(LGLfloat) x * bench->width / cols / 64.0f, (LGLfloat) y * bench->height / rows / 64.0f);
+		}
+	}
+	for (y = 0; y < rows; y++) {
+		for (x = 0; x < cols; x++) {
+			const LGLuint v = y * (cols + 1) + x;
+			benchSetQuad(bench, y * cols + x, v, v + 1, v + cols + 1, v + cols + 2);
+		}
+	}
+	benchBindStreams(bench, fsproc);
+	return 1;
+}
+
+/*
+ *  Scenarios
+ */
+
+static void benchDraw(Bench* bench) {
+	lglDrawIndexed(bench->context, LGL_DRAW_TYPE_TRIANGLE_LIST);
+}
+
+/* triangles of one pixel, setup and binning dominate */
+static LGLint benchTinySetup(Bench* bench) {
+	return benchGrid(bench, bench->width / 2, bench->height / 2, fsUntextured);
+}
+
+/* 20 x 20 pixel quads with and without texturing, shading dominates */
+static LGLint benchUntexturedSetup(Bench* bench) {
+	return benchGrid(bench, bench->width / 20, bench->height / 20, fsUntextured);
+}
+
+static LGLint benchTexturedSetup(Bench* bench) {
+	if (!benchGrid(bench, bench->width / 20, bench->height / 20, fsTextured)) {
+		return 0;
+	}
+	lglSetTextureData2d(bench->context, 0, bench->texture, TEXTURE_SIZE, TEXTURE_SIZE);
+	return 1;
+}
+
+/* 16 screen sized layers without depth testing, every layer is shaded */
+static LGLint benchOverdrawSetup(Bench* bench) {
+	const LGLuint layers = 16;
+	LGLuint i;
+
+	if (!benchAlloc(bench, layers * 4, layers * 6)) {
+		return 0;
+	}
+	for (i = 0; i < layers; i++) {
+		const LGLfloat z = 0.9f - 1.8f * i / layers;
+		benchSetVertex(bench, i * 4 + 0, -1.0f, -1.0f, z, 0.0f, 0.0f);
+		benchSetVertex(bench, i * 4 + 1, 1.0f, -1.0f, z, 1.0f, 0.0f);
+		benchSetVertex(bench, i * 4 + 2, -1.0f, 1.0f, z, 0.0f, 1.0f);
+		benchSetVertex(bench, i * 4 + 3, 1.0f, 1.0f, z, 1.0f, 1.0f);
+		benchSetQuad(bench, i, i * 4 + 0, i * 4 + 1, i * 4 + 2, i * 4 + 3);
+	}
+	benchBindStreams(bench, fsUntextured);
+	lglDisable(bench->context, LGL_STATE_DEPTH_TEST | LGL_STATE_DEPTH_WRITE);
+	return 1;
+}
+
+/* slivers two pixels high crossing the screen diagonally, the bounding boxes are mostly empty */
+static LGLint benchThinSetup(Bench* bench) {
+	const LGLuint count = 512;
+	const LGLfloat h = 4.0f / bench->height;
+	LGLuint i;
+
+	if (!benchAlloc(bench, count * 3, count * 3)) {
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		const LGLfloat y = (LGLfloat) i / count * 2.0f - 1.0f;
+		benchSetVertex(bench, i * 3 + 0, -1.0f, y, 0.0f, 0.0f, 0.0f);
+		benchSetVertex(bench, i * 3 + 1, 1.0f, -y, 0.0f, 1.0f, 0.0f);
+		benchSetVertex(bench, i * 3 + 2, 1.0f, -y + h, 0.0f, 1.0f, 1.0f);
+		bench->indices[i * 3 + 0] = i * 3 + 0;
+		bench->indices[i * 3 + 1] = i * 3 + 1;
+		bench->indices[i * 3 + 2] = i * 3 + 2;
+	}
+	benchBindStreams(bench, fsUntextured);
+	lglDisable(bench->context, LGL_STATE_DEPTH_TEST | LGL_STATE_DEPTH_WRITE);
+	return 1;
+}
+
+/* one quad of 8 x 8 pixels drawn 4096 times with a new offset each, the per draw cost dominates */
+static LGLint benchManyDrawsSetup(Bench* bench) {
+	const LGLfloat w = 16.0f / bench->width;
+	const LGLfloat h = 16.0f / bench->height;
+
+	if (!benchAlloc(bench, 4, 6)) {
+		return 0;
+	}
+	benchSetVertex(bench, 0, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f);
+	benchSetVertex(bench, 1, -1.0f + w, -1.0f, 0.0f, 1.0f, 0.0f);
+	benchSetVertex(bench, 2, -1.0f, -1.0f + h, 0.0f, 0.0f, 1.0f);
+	benchSetVertex(bench, 3, -1.0f + w, -1.0f + h, 0.0f, 1.0f, 1.0f);
+	benchSetQuad(bench, 0, 0, 1, 2, 3);
+	benchBindStreams(bench, fsUntextured);
+	bench->draws = 4096;
+	bench->triangles = bench->draws * 2;
+	return 1;
+}
+
+static void benchManyDraws(Bench* bench) {
+	LGLuint i;
+	for (i = 0; i < bench->draws; i++) {
+		LGLv2f offset;
+		offset.x = (i % 64) * (2.0f - 16.0f / bench->width) / 63.0f;
+		offset.y = (i / 64) * (2.0f - 16.0f / bench->height) / 63.0f;
+		lglSetUniformv2f(bench->context, UNI_OFFSET, &offset);
+		lglDrawIndexed(bench->context, LGL_DRAW_TYPE_TRIANGLE_LIST);
+	}
+}
+
+static LGLint benchMonkeySetup(Bench* bench) {
+	const A3DS* monkey = bench->monkey;
+	LGLvaryinglayout layout;
+	LGLuint i;
+
+	if (monkey == NULL) {
+		return 0;
+	}
+	bench->num_records = 0;
+	bench->triangles = 0;
+	for (i = 0; i < monkey->num_objects; i++) {
+		LGLdrawrecord* draw = &bench->records[bench->num_records++];
+		memset(draw, 0, sizeof(LGLdrawrecord));
+		draw->type = LGL_DRAW_TYPE_TRIANGLE_LIST;
+		draw->vertex_shader = vsMonkey;
+		draw->fragment_shader = fsNormal;
+		draw->vertex_stream = (LGLv3f*) monkey->vertices[i];
+		draw->vertex_stream_elements = monkey->num_vertices[i];
+		draw->index_stream = monkey->indices[i];
+		draw->index_type = LGL_INDEX_TYPE_USHORT;
+		draw->index_count = monkey->num_indices[i];
+		draw->attributes[ATR_NORMAL].v3 = (LGLv3f*) monkey->normals[i];
+		draw->num_attributes[ATR_NORMAL] = monkey->num_vertices[i];
+		bench->triangles += monkey->num_indices[i] / 3;
+	}
+	bench->draws = bench->num_records;
+	layout.num_varyings = 2;
+	layout.components[ATR_TEXCOORD] = 2;
+	layout.components[ATR_NORMAL] = 3;
+	lglSetVaryingLayout(bench->context, &layout);
+	return 1;
+}
+
+/* turns around the first object's bounding sphere, which fills most of the screen */
+static void benchMonkey(Bench* bench) {
+	const float* sphere = bench->monkey->sphere[0];
+	const LGLfloat distance = sphere[3] * 2.5f;
+	const LGLfloat near = sphere[3] * 1.5f;
+	const LGLfloat far = sphere[3] * 3.5f;
+	const LGLfloat angle = bench->frame * 0.1f;
+	const LGLfloat aspect = (LGLfloat) bench->width / bench->height;
+	LGLm4x4f view, projection, mvp;
+	LGLv3f eye, center, up = { 0.0f, 1.0f, 0.0f };
+
+	center.x = sphere[0];
+	center.y = sphere[1];
+	center.z = sphere[2];
+	eye.x = center.x + sinf(angle) * distance;
+	eye.y = center.y;
+	eye.z = center.z + cosf(angle) * distance;
+	lgluMatrixSetLookAt(&view, &eye, &center, &up);
+	lgluMatrixSetFrustum(&projection, -0.5f * near * aspect, 0.5f * near * aspect, -0.5f * near, 0.5f * near, near,
+			far);
+	lgluMatrixMultiply(&mvp, &projection, &view);
+	mvp.m21 = -mvp.m21;
+	mvp.m22 = -mvp.m22;
+	mvp.m23 = -mvp.m23;
+	mvp.m24 = -mvp.m24;
+	lglSetUniformm4x4f(bench->context, UNI_MVP_MATRIX, &mvp);
+	lglMultiDrawIndexed(bench->context, bench->records, bench->num_records);
+}
+
+static const Scenario scenarios[] = {
+	{ "tiny_triangles", 640, 480, benchTinySetup, benchDraw },
+	{ "overdraw_quads", 640, 480, benchOverdrawSetup, benchDraw },
+	{ "thin_triangles", 640, 480, benchThinSetup, benchDraw },
+	{ "untextured", 640, 480, benchUntexturedSetup, benchDraw },
+	{ "textured", 640, 480, benchTexturedSetup, benchDraw },
+	{ "many_draws", 640, 480, benchManyDrawsSetup, benchManyDraws },
+	{ "monkey_320x240", 320, 240, benchMonkeySetup, benchMonkey },
+	{ "monkey_640x480", 640, 480, benchMonkeySetup, benchMonkey },
+	{ "monkey_1280x720", 1280, 720, benchMonkeySetup, benchMonkey },
+	{ "monkey_1920x1080", 1920, 1080, benchMonkeySetup, benchMonkey }
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/*
+ *  Measuring
+ */
+
+static double benchSeconds(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int benchCompare(const void* a, const void* b) {
+	const double x = *(const double*) a;
+	const double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/* nearest rank, times are sorted */
+static double benchPercentile(const double* times, LGLuint count, double p) {
+	LGLuint rank = (LGLuint) ceil(p * count);
+	return times[rank > 0 ? rank - 1 : 0];
+}
+
+static LGLint benchRun(const Scenario* scenario, LGLjobsystem* jobs, const A3DS* monkey, const LGLtexel* texture,
+		LGLuint frames, int first) {
+	LGLFramebufferinfo fbinfo;
+	LGLquery* query;
+	double* times;
+	double total = 0.0, fragments = 0.0;
+	LGLuint i;
+	Bench bench;
+
+	memset(&bench, 0, sizeof(Bench));
+	bench.width = scenario->width;
+	bench.height = scenario->height;
+	bench.monkey = monkey;
+	bench.texture = (LGLtexel*) texture;
+
+	fbinfo.framebuffer = NULL; /* allocated by the context */
+	fbinfo.zbuffer = NULL;
+	fbinfo.width = bench.width;
+	fbinfo.height = bench.height;
+	fbinfo.rshift = 16;
+	fbinfo.gshift = 8;
+	fbinfo.bshift = 0;
+	bench.context = lglCreateBufferedContext(&fbinfo, 1);
+	times = malloc(sizeof(double) * frames);
+	if (bench.context == NULL || times == NULL) {
+		fprintf(stderr, "%s: out of memory\n", scenario->name);
+		if (bench.context != NULL) {
+			lglDestroyContext(bench.context);
+		}
+		free(times);
+		return 0;
+	}
+	lglSetJobSystem(bench.context, jobs);
+	query = lglCreateQuery(bench.context);
+
+	if (query == NULL || !scenario->setup(&bench)) {
+		fprintf(stderr, "%s: setup failed\n", scenario->name);
+		if (query != NULL) {
+			lglDestroyQuery(bench.context, query);
+		}
+		lglDestroyContext(bench.context);
+		free(bench.vertices);
+		free(bench.texcoords);
+		free(bench.indices);
+		free(times);
+		return 0;
+	}
+
+	for (i = 0; i < WARMUP_FRAMES + frames; i++) {
+		const double start = benchSeconds();
+		lglClear(bench.context, LGL_CLEAR_FRAMEBUFFER | LGL_CLEAR_ZBUFFER);
+		lglBeginQuery(bench.context, query);
+		scenario->draw(&bench);
+		lglEndQuery(bench.context);
+		lglFinish(bench.context);
+		bench.frame++;
+		if (i >= WARMUP_FRAMES) {
+			times[i - WARMUP_FRAMES] = benchSeconds() - start;
+			total += times[i - WARMUP_FRAMES];
+			fragments += lglGetQueryResult(bench.context, query);
+		}
+	}
+	qsort(times, frames, sizeof(double), benchCompare);
+
+	printf("%s\t\t{\n", first ? "" : ",\n");
+	printf("\t\t\t\"name\": \"%s\",\n", scenario->name);
+	printf("\t\t\t\"width\": %u,\n", bench.width);
+	printf("\t\t\t\"height\": %u,\n", bench.height);
+	printf("\t\t\t\"frames\": %u,\n", frames);
+	printf("\t\t\t\"draws_per_frame\": %u,\n", bench.draws);
+	printf("\t\t\t\"triangles_per_frame\": %u,\n", bench.triangles);
+	printf("\t\t\t\"fragments_per_frame\": %.0f,\n", fragments / frames);
+	printf("\t\t\t\"triangles_per_second\": %.6g,\n", (double) bench.triangles * frames / total);
+	printf("\t\t\t\"fragments_per_second\": %.6g,\n", fragments / total);
+	printf("\t\t\t\"frame_ms\": { \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, "
+			"\"max\": %.4f },\n", times[0] * 1e3, total / frames * 1e3, benchPercentile(times, frames, 0.5) * 1e3,
+			benchPercentile(times, frames, 0.9) * 1e3, benchPercentile(times, frames, 0.99) * 1e3,
+			times[frames - 1] * 1e3);
+
+	lglDestroyQuery(bench.context, query);
+	lglDestroyContext(bench.context);
+	free(bench.vertices);
+	free(bench.texcoords);
+	free(bench.indices);
+	free(times);
+	return 1;
+}
+
+/* runs the scenario in a child, whose peak memory wait4 reports, and completes its results with it */
+static LGLint benchFork(const Scenario* scenario, unsigned int workers, const A3DS* monkey, const LGLtexel* texture,
+		LGLuint frames, int first) {
+	struct rusage usage;
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		/* the workers of the parent are not forked */
+		LGLjobsystem* jobs = lglCreateJobSystem(workers, LGL_JOB_AFFINITY_NONE, 0);
+		LGLint ok = 0;
+		if (jobs != NULL) {
+			ok = benchRun(scenario, jobs, monkey, texture, frames, first);
+			lglDestroyJobSystem(jobs);
+		} else {
+			fprintf(stderr, "%s: could not create job system\n", scenario->name);
+		}
+		fflush(stdout);
+		_exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (pid < 0) {
+		fprintf(stderr, "%s: could not fork\n", scenario->name);
+		return 0;
+	}
+	if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		return 0;
+	}
+	printf("\t\t\t\"peak_rss_kb\": %ld\n", usage.ru_maxrss);
+	printf("\t\t}");
+	return 1;
+}
+
+static int benchSelected(const char* name, int argc, char* argv[], int first) {
+	int a;
+	if (first == argc) {
+		return 1;
+	}
+	for (a = first; a < argc; a++) {
+		if (strcmp(argv[a], name) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const char* mesh = "data/monkey.3ds";
+	LGLtexel* texture;
+	LGLjobsystem* jobs;
+	A3DS* monkey = NULL;
+	unsigned int frames = 30, workers = 0, i;
+	int a, first, out, ran = 0, skipped = 0, ok = 1;
+
+	for (a = 1; a < argc && argv[a][0] == '-'; a++) {
+		if (strcmp(argv[a], "-f") == 0 && a + 1 < argc) {
+			frames = (unsigned int) atoi(argv[++a]);
+			ok = ok && frames > 0;
+		} else if (strcmp(argv[a], "-j") == 0 && a + 1 < argc) {
+			workers = (unsigned int) atoi(argv[++a]);
+		} else if (strcmp(argv[a], "-m") == 0 && a + 1 < argc) {
+			mesh = argv[++a];
+		} else {
+			ok = 0;
+		}
+	}
+	first = a;
+	for (; a < argc && ok; a++) {
+		for (i = 0; i < NUM_SCENARIOS && strcmp(argv[a], scenarios[i].name) != 0; i++) {
+		}
+		ok = i < NUM_SCENARIOS;
+	}
+	if (!ok) {
+		fprintf(stderr, "usage: %s [-f frames] [-j workers] [-m monkey.3ds] [scenario ...]\nscenarios:", argv[0]);
+		for (i = 0; i < NUM_SCENARIOS; i++) {
+			fprintf(stderr, " %s", scenarios[i].name);
+		}
+		fprintf(stderr, "\n");
+		return EXIT_FAILURE;
+	}
+
+	jobs = lglCreateJobSystem(workers, LGL_JOB_AFFINITY_NONE, 0);
+	texture = malloc(sizeof(LGLtexel) * TEXTURE_SIZE * TEXTURE_SIZE);
+	if (jobs == NULL || texture == NULL) {
+		fprintf(stderr, "Could not create job system.\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < TEXTURE_SIZE * TEXTURE_SIZE; i++) {
+		const LGLuint x = i % TEXTURE_SIZE, y = i / TEXTURE_SIZE;
+		texture[i] = ((x ^ y) & 32) ? 0xffe0c080 : 0xff204060;
+	}
+
+	/* the loader reports on stdout, keep the results clean */
+	fflush(stdout);
+	out = dup(STDOUT_FILENO);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+	monkey = a3dsLoad(mesh, A3DS_NORMALS_AREA, jobs);
+	fflush(stdout);
+	dup2(out, STDOUT_FILENO);
+	close(out);
+
+	printf("{\n\t\"workers\": %u,\n\t\"scenarios\": [\n", lglGetJobWorkers(jobs));
+	for (i = 0; i < NUM_SCENARIOS; i++) {
+		if (!benchSelected(scenarios[i].name, argc, argv, first)) {
+			continue;
+		}
+		if (scenarios[i].setup == benchMonkeySetup && monkey == NULL) {
+			ok = ok && first == argc; /* skipped unless asked for */
+			continue;
+		}
+		if (benchFork(&scenarios[i], workers, monkey, texture, frames, !ran)) {
+			ran++;
+		} else {
+			ok = 0;
+		}
+	}
+	/* the monkey ones when the mesh did not load */
+	printf("\n\t],\n\t\"skipped\": [");
+	for (i = 0; i < NUM_SCENARIOS; i++) {
+		if (benchSelected(scenarios[i].name, argc, argv, first) && scenarios[i].setup == benchMonkeySetup
+				&& monkey == NULL) {
+			printf("%s \"%s\"", skipped++ ? "," : "", scenarios[i].name);
+		}
+	}
+	printf("%s]\n}\n", skipped ? " " : "");
+	if (skipped) {
+		fprintf(stderr, "Skipped %d scenarios, %s did not load, pass its path with -m.\n", skipped, mesh);
+	}
+
+	if (monkey != NULL) {
+		a3dsUnload(monkey);
+	}
+	lglDestroyJobSystem(jobs);
+	free(texture);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
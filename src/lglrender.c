@@ -0,0 +1,427 @@
+/*
+ *
+ * lglrender - renders meshes over a list of camera poses without a window
+ *
+ * usage: lglrender scene.txt [-o frame%04d.ppm] [-c contexts] [-j workers]
+ *
+ * The scene file holds one command per line, # starts a comment:
+ *
+ *   size <width> <height>                             640 480 by default
+ *   fov <degrees>                                     vertical field of view, 60 by default
+ *   mesh <file.3ds | file.lmsh>                       drawn in every frame, in model space
+ *   camera <eye x y z> <center x y z> [<up x y z>]    one frame per line, up is +y by default
+ *
+ * Frames are named by the printf pattern of -o and written as TGA if it ends in .tga and as PPM otherwise,
+ * -o - streams raw RGB24 frames to stdout for a pipe. The frames are spread round robin over several buffered
+ * contexts sharing one job system, so that several frames are rasterized while the next ones are submitted,
+ * and written in order. Zero workers starts one per online processor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h> /* for dup and dup2 */
+#include "LGL/lgl.h"
+#include "LGL/lglu.h"
+#include "LGL/lgljob.h"
+#include "3ds/3ds.h"
+#include "lmsh/lmsh.h"
+#include "tga/tga.h"
+
+/* Uniforms */
+#define UNI_MVP_MATRIX  0 /* model * view * projection, y points down */
+#define UNI_EYE         1 /* camera position in model space */
+
+/* Attributes and varyings */
+#define ATR_POSITION  0 /* model space position */
+#define ATR_NORMAL    1 /* model space normal */
+
+#define MAX_LINE      512
+#define MAX_CONTEXTS  16
+
+typedef struct Camera_s {
+	LGLv3f eye, center, up;
+} Camera;
+
+typedef struct Scene_s {
+	LGLuint width, height;
+	LGLfloat fov;
+	A3DS* meshes[A3DS_MAX_OBJECTS];
+	LMSH* lmshes[A3DS_MAX_OBJECTS];
+	LGLuint num_meshes;
+	LGLdrawrecord* records;
+	LGLsize num_records;
+	LGLv3f bounds_min, bounds_max;
+	Camera* cameras;
+	LGLuint num_cameras;
+} Scene;
+
+/* perspective divide in the shader, the rasterizer takes normalized device coordinates */
+static void vsCamera(LGLvsout* out, const LGLvsin* in) {
+	const LGLm4x4f* m = &in->uniforms[UNI_MVP_MATRIX].m4x4;
+	const LGLv3f* v = &in->vertex_stream[in->index];
+	const LGLfloat iw = 1.0f / (m->m41 * v->x + m->m42 * v->y + m->m43 * v->z + m->m44);
+
+	lgluTransform(&out->position, m, v);
+	out->position.x *= iw;
+	out->position.y *= iw;
+	out->position.z *= iw;
+	out->varyings[ATR_POSITION].v3 = *v;
+	out->varyings[ATR_NORMAL].v3 = in->attributes[ATR_NORMAL].v3[in->index];
+}
+
+/* lit from the camera, both sides of a face */
+static void fsHeadlight(LGLfsout* out, const LGLfsin* in) {
+	const LGLv3f* eye = &in->uniforms[UNI_EYE].v3;
+	LGLv3f n, p, d;
+	LGLfloat di;
+
+	lgluInterpolatev3f(&n, in->a, &in->varyings[0][ATR_NORMAL].v3, in->b, &in->varyings[1][ATR_NORMAL].v3, in->c,
+			&in->varyings[2][ATR_NORMAL].v3);
+	lgluInterpolatev3f(&p, in->a, &in->varyings[0][ATR_POSITION].v3, in->b, &in->varyings[1][ATR_POSITION].v3,
+			in->c, &in->varyings[2][ATR_POSITION].v3);
+	lgluShaderNormalize(&n);
+	d.x = eye->x - p.x;
+	d.y = eye->y - p.y;
+	d.z = eye->z - p.z;
+	lgluShaderNormalize(&d);
+
+	di = fabsf(lgluVectorDot(&n, &d)) * 0.9f + 0.1f;
+	out->color.r = di;
+	out->color.g = di;
+	out->color.b = di;
+}
+
+static void sceneAddBounds(Scene* scene, const float* min, const float* max) {
+	if (scene->num_records == 0) {
+		memcpy(&scene->bounds_min, min, sizeof(LGLv3f));
+		memcpy(&scene->bounds_max, max, sizeof(LGLv3f));
+		return;
+	}
+	scene->bounds_min.x = fminf(scene->bounds_min.x, min[0]);
+	scene->bounds_min.y = fminf(scene->bounds_min.y, min[1]);
+	scene->bounds_min.z = fminf(scene->bounds_min.z, min[2]);
+	scene->bounds_max.x = fmaxf(scene->bounds_max.x, max[0]);
+	scene->bounds_max.y = fmaxf(scene->bounds_max.y, max[1]);
+	scene->bounds_max.z = fmaxf(scene->bounds_max.z, max[2]);
+}
+
+static int sceneAddRecord(Scene* scene, float* vertices, float* normals, LGLsize num_vertices, void* indices,
+		LGLindextype type, LGLsize num_indices, const float* min, const float* max) {
+	LGLdrawrecord* records;
+	LGLdrawrecord* draw;
+
+	if (num_indices == 0) {
+		return 1;
+	}
+	records = realloc(scene->records, sizeof(LGLdrawrecord) * (scene->num_records + 1));
+	if (records == NULL) {
+		return 0;
+	}
+	scene->records = records;
+	sceneAddBounds(scene, min, max);
+
+	draw = &scene->records[scene->num_records++];
+	memset(draw, 0, sizeof(LGLdrawrecord));
+	draw->type = LGL_DRAW_TYPE_TRIANGLE_LIST;
+	draw->vertex_shader = vsCamera;
+	draw->fragment_shader = fsHeadlight;
+	draw->vertex_stream = (LGLv3f*) vertices;
+	draw->vertex_stream_elements = num_vertices;
+	draw->index_stream = indices;
+	draw->index_type = type;
+	draw->index_count = num_indices;
+	draw->attributes[ATR_NORMAL].v3 = (LGLv3f*) normals;
+	draw->num_attributes[ATR_NORMAL] = num_vertices;
+	return 1;
+}
+
+static int sceneLoadMesh(Scene* scene, const char* file, LGLjobsystem* jobs) {
+	const size_t length = strlen(file);
+	unsigned int i;
+	int ok = 1;
+
+	if (scene->num_meshes == A3DS_MAX_OBJECTS) {
+		fprintf(stderr, "Too many meshes: '%s'\n", file);
+		return 0;
+	}
+	if (length > 5 && strcmp(file + length - 5, ".lmsh") == 0) {
+		LMSH* lmsh = lmshLoad(file);
+		if (lmsh == NULL) {
+			return 0;
+		}
+		scene->lmshes[scene->num_meshes++] = lmsh;
+		for (i = 0; i < lmsh->num_objects && ok; i++) {
+			LMSHobject* o = &lmsh->objects[i];
+			ok = sceneAddRecord(scene, o->vertices, o->normals, o->num_vertices, o->indices,
+					o->index_size == 4 ? LGL_INDEX_TYPE_UINT : LGL_INDEX_TYPE_USHORT, o->num_indices, o->bbox_min,
+					o->bbox_max);
+		}
+	} else {
+		A3DS* a3ds = a3dsLoad(file, A3DS_NORMALS_FACE, jobs);
+		if (a3ds == NULL) {
+			return 0;
+		}
+		scene->meshes[scene->num_meshes++] = a3ds;
+		for (i = 0; i < a3ds->num_objects && ok; i++) {
+			ok = sceneAddRecord(scene, a3ds->vertices[i], a3ds->normals[i], a3ds->num_vertices[i],
+					a3ds->indices[i], LGL_INDEX_TYPE_USHORT, a3ds->num_indices[i], a3ds->bbox_min[i],
+					a3ds->bbox_max[i]);
+		}
+	}
+	return ok;
+}
+
+static int sceneAddCamera(Scene* scene, const Camera* camera) {
+	Camera* cameras = realloc(scene->cameras, sizeof(Camera) * (scene->num_cameras + 1));
+	if (cameras == NULL) {
+		return 0;
+	}
+	scene->cameras = cameras;
+	scene->cameras[scene->num_cameras++] = *camera;
+	return 1;
+}
+
+static int sceneLoad(Scene* scene, const char* filename, LGLjobsystem* jobs) {
+	char line[MAX_LINE], arg[MAX_LINE];
+	unsigned int number = 0;
+	FILE* file;
+	int ok = 1;
+
+	memset(scene, 0, sizeof(Scene));
+	scene->width = 640;
+	scene->height = 480;
+	scene->fov = 60.0f;
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to load scene file: '%s'\n", filename);
+		return 0;
+	}
+	while (ok && fgets(line, sizeof(line), file) != NULL) {
+		char* comment = strchr(line, '#');
+		Camera c;
+		int n;
+
+		number++;
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+		if (sscanf(line, "%s", arg) != 1) {
+			continue;
+		}
+		if (strcmp(arg, "size") == 0) {
+			ok = sscanf(line, "%*s %u %u", &scene->width, &scene->height) == 2 && scene->width > 0
+					&& scene->height > 0 && scene->width <= 0xffff && scene->height <= 0xffff;
+		} else if (strcmp(arg, "fov") == 0) {
+			ok = sscanf(line, "%*s %f", &scene->fov) == 1 && scene->fov > 0.0f && scene->fov < 180.0f;
+		} else if (strcmp(arg, "mesh") == 0) {
+			ok = sscanf(line, "%*s %s", arg) == 1 && sceneLoadMesh(scene, arg, jobs);
+		} else if (strcmp(arg, "camera") == 0) {
+			c.up.x = 0.0f;
+			c.up.y = 1.0f;
+			c.up.z = 0.0f;
+			n = sscanf(line, "%*s %f %f %f %f %f %f %f %f %f", &c.eye.x, &c.eye.y, &c.eye.z, &c.center.x,
+					&c.center.y, &c.center.z, &c.up.x, &c.up.y, &c.up.z);
+			ok = (n == 6 || n == 9) && sceneAddCamera(scene, &c);
+		} else {
+			ok = 0;
+		}
+		if (!ok) {
+			fprintf(stderr, "%s:%u: invalid line\n", filename, number);
+		}
+	}
+	fclose(file);
+	return ok;
+}
+
+static void sceneFree(Scene* scene) {
+	unsigned int i;
+	for (i = 0; i < scene->num_meshes; i++) {
+		if (scene->meshes[i] != NULL) {
+			a3dsUnload(scene->meshes[i]);
+		}
+		if (scene->lmshes[i] != NULL) {
+			lmshUnload(scene->lmshes[i]);
+		}
+	}
+	free(scene->records);
+	free(scene->cameras);
+}
+
+/* the clip planes hug the scene's bounding sphere */
+static void sceneSetCamera(LGLcontext* context, const Scene* scene, const Camera* camera) {
+	LGLv3f center, d;
+	LGLm4x4f view, projection, mvp;
+	LGLfloat radius, distance, near, far, top, right;
+
+	center.x = (scene->bounds_min.x + scene->bounds_max.x) * 0.5f;
+	center.y = (scene->bounds_min.y + scene->bounds_max.y) * 0.5f;
+	center.z = (scene->bounds_min.z + scene->bounds_max.z) * 0.5f;
+	d.x = scene->bounds_max.x - center.x;
+	d.y = scene->bounds_max.y - center.y;
+	d.z = scene->bounds_max.z - center.z;
+	radius = sqrtf(lgluVectorDot(&d, &d));
+	d.x = camera->eye.x - center.x;
+	d.y = camera->eye.y - center.y;
+	d.z = camera->eye.z - center.z;
+	distance = sqrtf(lgluVectorDot(&d, &d));
+	near = fmaxf(distance - radius, radius * 0.01f + 1e-6f);
+	far = distance + radius + near;
+	top = near * tanf(scene->fov * 0.5f * (float) M_PI / 180.0f);
+	right = top * scene->width / scene->height;
+
+	lgluMatrixSetLookAt(&view, &camera->eye, &camera->center, &camera->up);
+	lgluMatrixSetFrustum(&projection, -right, right, -top, top, near, far);
+	lgluMatrixMultiply(&mvp, &projection, &view);
+	mvp.m21 = -mvp.m21;
+	mvp.m22 = -mvp.m22;
+	mvp.m23 = -mvp.m23;
+	mvp.m24 = -mvp.m24;
+
+	lglSetUniformm4x4f(context, UNI_MVP_MATRIX, &mvp);
+	lglSetUniformv3f(context, UNI_EYE, &camera->eye);
+}
+
+static int writeFrame(const LGLFramebufferinfo* front, const char* pattern, LGLuint frame, unsigned char* rgb) {
+	const unsigned int* pixels = front->framebuffer;
+	const size_t count = (size_t) front->width * front->height;
+	char name[MAX_LINE];
+	size_t i, length;
+	FILE* file;
+	int ok;
+
+	if (strcmp(pattern, "-") != 0) {
+		snprintf(name, sizeof(name), pattern, frame);
+		length = strlen(name);
+		if (length > 4 && strcmp(name + length - 4, ".tga") == 0) {
+			return tgaSave(name, pixels, front->width, front->height);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		rgb[i * 3 + 0] = pixels[i] >> 16 & 0xff;
+		rgb[i * 3 + 1] = pixels[i] >> 8 & 0xff;
+		rgb[i * 3 + 2] = pixels[i] & 0xff;
+	}
+	if (strcmp(pattern, "-") == 0) {
+		return fwrite(rgb, 3, count, stdout) == count;
+	}
+
+	file = fopen(name, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to write frame: '%s'\n", name);
+		return 0;
+	}
+	fprintf(file, "P6\n%u %u\n255\n", front->width, front->height);
+	ok = fwrite(rgb, 3, count, file) == count;
+	return fclose(file) == 0 && ok;
+}
+
+int main(int argc, char* argv[]) {
+	const char* pattern = "frame%04d.ppm";
+	LGLcontext* contexts[MAX_CONTEXTS];
+	LGLvaryinglayout layout;
+	LGLFramebufferinfo fbinfo;
+	LGLjobsystem* jobs;
+	unsigned int num_contexts = 2, workers = 0;
+	unsigned char* rgb;
+	LGLuint i, k;
+	Scene scene;
+	int a, out = -1, ok = 1;
+
+	for (a = 2; a < argc && ok; a++) {
+		if (strcmp(argv[a], "-o") == 0 && a + 1 < argc) {
+			pattern = argv[++a];
+		} else if (strcmp(argv[a], "-c") == 0 && a + 1 < argc) {
+			num_contexts = (unsigned int) atoi(argv[++a]);
+			ok = num_contexts > 0 && num_contexts <= MAX_CONTEXTS;
+		} else if (strcmp(argv[a], "-j") == 0 && a + 1 < argc) {
+			workers = (unsigned int) atoi(argv[++a]);
+		} else {
+			ok = 0;
+		}
+	}
+	if (argc < 2 || !ok) {
+		fprintf(stderr, "usage: %s scene.txt [-o frame%%04d.ppm | -o -] [-c contexts] [-j workers]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	jobs = lglCreateJobSystem(workers, LGL_JOB_AFFINITY_NONE, 0);
+	if (jobs == NULL) {
+		fprintf(stderr, "Could not create job system.\n");
+		return EXIT_FAILURE;
+	}
+	/* the loaders report on stdout, keep the frame stream clean */
+	if (strcmp(pattern, "-") == 0) {
+		fflush(stdout);
+		out = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+	ok = sceneLoad(&scene, argv[1], jobs);
+	if (out >= 0) {
+		fflush(stdout);
+		dup2(out, STDOUT_FILENO);
+		close(out);
+	}
+	if (!ok) {
+		sceneFree(&scene);
+		lglDestroyJobSystem(jobs);
+		return EXIT_FAILURE;
+	}
+
+	fbinfo.framebuffer = NULL; /* allocated by the contexts */
+	fbinfo.zbuffer = NULL;
+	fbinfo.width = scene.width;
+	fbinfo.height = scene.height;
+	fbinfo.rshift = 16;
+	fbinfo.gshift = 8;
+	fbinfo.bshift = 0;
+	layout.num_varyings = 2;
+	layout.components[ATR_POSITION] = 3;
+	layout.components[ATR_NORMAL] = 3;
+
+	rgb = malloc((size_t) scene.width * scene.height * 3);
+	for (k = 0; k < num_contexts; k++) {
+		contexts[k] = lglCreateBufferedContext(&fbinfo, 2);
+		if (contexts[k] == NULL) {
+			break;
+		}
+		lglSetJobSystem(contexts[k], jobs);
+		lglSetVaryingLayout(contexts[k], &layout);
+	}
+	ok = k == num_contexts && rgb != NULL;
+	if (!ok) {
+		fprintf(stderr, "Could not create rendering contexts.\n");
+		num_contexts = k;
+	}
+
+	/*
+	 * Frame i renders on context i modulo the context count. A context's front buffer is the frame of the swap
+	 * before the last one, so frame i is read just before frame i + 2 * count reuses its buffer. Empty swaps
+	 * after the last camera move the final frames to the front.
+	 */
+	for (i = 0; ok && i < scene.num_cameras + 2 * num_contexts; i++) {
+		LGLcontext* context = contexts[i % num_contexts];
+		if (i >= 2 * num_contexts && i - 2 * num_contexts < scene.num_cameras) {
+			ok = writeFrame(lglGetFrontBuffer(context), pattern, i - 2 * num_contexts, rgb);
+		}
+		if (ok && i < scene.num_cameras) {
+			lglClear(context, LGL_CLEAR_FRAMEBUFFER | LGL_CLEAR_ZBUFFER);
+			sceneSetCamera(context, &scene, &scene.cameras[i]);
+			lglMultiDrawIndexed(context, scene.records, scene.num_records);
+			lglSwapBuffers(context);
+		} else if (ok && i < scene.num_cameras + num_contexts) {
+			lglSwapBuffers(context);
+		}
+	}
+
+	for (k = 0; k < num_contexts; k++) {
+		lglDestroyContext(contexts[k]);
+	}
+	lglDestroyJobSystem(jobs);
+	sceneFree(&scene);
+	free(rgb);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,234 @@
+/*
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <fcntl.h> /* for open */
+#include <unistd.h> /* for close */
+#include <sys/mman.h> /* for mmap and munmap */
+#include <sys/stat.h> /* for fstat */
+#include "lmsh.h"
+
+#define LMSH_OUT "lmsh: "
+
+#define LMSH_HEADER_SIZE 16
+#define LMSH_OBJECT_SIZE 96
+#define LMSH_ALIGN(X) (((X) + 15) & ~(uint64_t) 15)
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LMSH_BIG_ENDIAN 1
+#endif
+
+/* the table is packed, fields are copied out instead of cast */
+static uint32_t lmshGet32(const unsigned char* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t lmshGet64(const unsigned char* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* the array of count elements of size bytes at offset, NULL if absent or not within the file */
+static void* lmshGetArray(const LMSH* lmsh, uint64_t offset, uint64_t count, uint64_t size, int* valid) {
+	if (offset == 0) {
+		return NULL;
+	}
+	if (offset % 16 != 0 || offset > lmsh->size || count * size > lmsh->size - offset) {
+		*valid = 0;
+		return NULL;
+	}
+	return (unsigned char*) lmsh->data + offset;
+}
+
+LMSH* lmshLoad(const char* filename) {
+	LMSH* lmsh;
+	struct stat info;
+	const unsigned char* p;
+	int fd, valid = 1;
+	unsigned int i;
+
+#if LMSH_BIG_ENDIAN
+	fprintf(stderr, LMSH_OUT "Unable to load LMSH file on a big endian host: '%s'\n", filename);
+	return NULL;
+#endif
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, LMSH_OUT "Unable to load LMSH file: '%s'\n", filename);
+		return NULL;
+	}
+	lmsh = calloc(1, sizeof(LMSH));
+	if (lmsh == NULL || fstat(fd, &info) != 0 || info.st_size < LMSH_HEADER_SIZE) {
+		fprintf(stderr, LMSH_OUT "Unable to read LMSH file: '%s'\n", filename);
+		free(lmsh);
+		close(fd);
+		return NULL;
+	}
+	lmsh->size = info.st_size;
+	lmsh->data = mmap(NULL, lmsh->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd); /* the mapping stays valid */
+	if (lmsh->data == MAP_FAILED) {
+		fprintf(stderr, LMSH_OUT "Unable to read LMSH file: '%s'\n", filename);
+		free(lmsh);
+		return NULL;
+	}
+
+	p = lmsh->data;
+	if (memcmp(p, "LMSH", 4) != 0 || lmshGet32(p + 4) != LMSH_VERSION
+			|| lmshGet32(p + 8) > (lmsh->size - LMSH_HEADER_SIZE) / LMSH_OBJECT_SIZE) {
+		fprintf(stderr, LMSH_OUT "Invalid LMSH file: '%s'\n", filename);
+		lmshUnload(lmsh);
+		return NULL;
+	}
+	lmsh->num_objects = lmshGet32(p + 8);
+	lmsh->objects = calloc(lmsh->num_objects ? lmsh->num_objects : 1, sizeof(LMSHobject));
+	if (lmsh->objects == NULL) {
+		lmshUnload(lmsh);
+		return NULL;
+	}
+
+	for (i = 0; i < lmsh->num_objects && valid; i++) {
+		LMSHobject* object = &lmsh->objects[i];
+		const unsigned char* entry = p + LMSH_HEADER_SIZE + i * LMSH_OBJECT_SIZE;
+
+		object->num_vertices = lmshGet32(entry + 0);
+		object->num_indices = lmshGet32(entry + 4);
+		object->index_size = lmshGet32(entry + 8);
+		memcpy(object->bbox_min, entry + 16, sizeof(float) * 3);
+		memcpy(object->bbox_max, entry + 28, sizeof(float) * 3);
+		memcpy(object->sphere, entry + 40, sizeof(float) * 4);
+		object->vertices = lmshGetArray(lmsh, lmshGet64(entry + 64), object->num_vertices, 12, &valid);
+		object->normals = lmshGetArray(lmsh, lmshGet64(entry + 72), object->num_vertices, 12, &valid);
+		object->texcoords = lmshGetArray(lmsh, lmshGet64(entry + 80), object->num_vertices, 8, &valid);
+		object->indices = lmshGetArray(lmsh, lmshGet64(entry + 88), object->num_indices, object->index_size, &valid);
+		if (object->index_size != 2 && object->index_size != 4) {
+			valid = 0;
+		}
+		if ((object->num_vertices > 0 && (object->vertices == NULL || object->normals == NULL))
+				|| (object->num_indices > 0 && object->indices == NULL)) {
+			valid = 0;
+		}
+	}
+	if (!valid) {
+		fprintf(stderr, LMSH_OUT "Invalid object %u in: '%s'\n", i - 1, filename);
+		lmshUnload(lmsh);
+		return NULL;
+	}
+
+	printf(LMSH_OUT "Loaded %s, %u objects\n", filename, lmsh->num_objects);
+	return lmsh;
+}
+
+void lmshUnload(LMSH* lmsh) {
+	assert(lmsh != NULL);
+	if (lmsh->data != NULL) {
+		munmap(lmsh->data, lmsh->size);
+	}
+	free(lmsh->objects);
+	free(lmsh);
+}
+
+static int lmshPad(FILE* f, uint64_t* offset) {
+	static const unsigned char zero[16];
+	const uint64_t aligned = LMSH_ALIGN(*offset);
+	const size_t count = (size_t) (aligned - *offset);
+	*offset = aligned;
+	return fwrite(zero, 1, count, f) == count;
+}
+
+static int lmshWriteArray(FILE* f, uint64_t* offset, const void* data, uint64_t size) {
+	if (data == NULL || size == 0) {
+		return 1;
+	}
+	*offset += size;
+	return fwrite(data, 1, (size_t) size, f) == size && lmshPad(f, offset);
+}
+
+int lmshSave(const char* filename, const LMSHobject* objects, unsigned int num_objects) {
+	unsigned char header[LMSH_HEADER_SIZE] = { 'L', 'M', 'S', 'H' };
+	const uint32_t version = LMSH_VERSION;
+	uint64_t offset;
+	unsigned int i;
+	FILE* file;
+	int ok;
+
+	assert(objects != NULL || num_objects == 0);
+
+#if LMSH_BIG_ENDIAN
+	fprintf(stderr, LMSH_OUT "Unable to save LMSH file on a big endian host: '%s'\n", filename);
+	return 0;
+#endif
+
+	file = fopen(filename, "wb");
+	if (file == NULL) {
+		fprintf(stderr, LMSH_OUT "Unable to save LMSH file: '%s'\n", filename);
+		return 0;
+	}
+	memcpy(header + 4, &version, 4);
+	memcpy(header + 8, &num_objects, 4);
+	ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+	/* the arrays follow the table in object order: positions, normals, texcoords, indices */
+	offset = LMSH_ALIGN(LMSH_HEADER_SIZE + (uint64_t) num_objects * LMSH_OBJECT_SIZE);
+	for (i = 0; i < num_objects && ok; i++) {
+		const LMSHobject* object = &objects[i];
+		const uint64_t vertices = (uint64_t) object->num_vertices;
+		const uint64_t indices = (uint64_t) object->num_indices * object->index_size;
+		unsigned char entry[LMSH_OBJECT_SIZE];
+		uint64_t offsets[4] = { 0, 0, 0, 0 };
+
+		assert(object->index_size == 2 || object->index_size == 4);
+
+		if (object->vertices != NULL && vertices > 0) {
+			offsets[0] = offset;
+			offset = LMSH_ALIGN(offset + vertices * 12);
+		}
+		if (object->normals != NULL && vertices > 0) {
+			offsets[1] = offset;
+			offset = LMSH_ALIGN(offset + vertices * 12);
+		}
+		if (object->texcoords != NULL && vertices > 0) {
+			offsets[2] = offset;
+			offset = LMSH_ALIGN(offset + vertices * 8);
+		}
+		if (object->indices != NULL && indices > 0) {
+			offsets[3] = offset;
+			offset = LMSH_ALIGN(offset + indices);
+		}
+
+		memset(entry, 0, sizeof(entry));
+		memcpy(entry + 0, &object->num_vertices, 4);
+		memcpy(entry + 4, &object->num_indices, 4);
+		memcpy(entry + 8, &object->index_size, 4);
+		memcpy(entry + 16, object->bbox_min, sizeof(float) * 3);
+		memcpy(entry + 28, object->bbox_max, sizeof(float) * 3);
+		memcpy(entry + 40, object->sphere, sizeof(float) * 4);
+		memcpy(entry + 64, offsets, sizeof(offsets));
+		ok = fwrite(entry, 1, sizeof(entry), file) == sizeof(entry);
+	}
+
+	offset = LMSH_HEADER_SIZE + (uint64_t) num_objects * LMSH_OBJECT_SIZE;
+	ok = ok && lmshPad(file, &offset);
+	for (i = 0; i < num_objects && ok; i++) {
+		const LMSHobject* object = &objects[i];
+		const uint64_t vertices = (uint64_t) object->num_vertices;
+		ok = lmshWriteArray(file, &offset, object->vertices, vertices * 12)
+				&& lmshWriteArray(file, &offset, object->normals, vertices * 12)
+				&& lmshWriteArray(file, &offset, object->texcoords, vertices * 8)
+				&& lmshWriteArray(file, &offset, object->indices, (uint64_t) object->num_indices * object->index_size);
+	}
+
+	if (fclose(file) != 0 || !ok) {
+		fprintf(stderr, LMSH_OUT "Unable to write LMSH file: '%s'\n", filename);
+		return 0;
+	}
+	return 1;
+}
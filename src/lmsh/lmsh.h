@@ -0,0 +1,45 @@
+/*
+ *
+ */
+
+#ifndef LMSH_H_INCLUDED
+#define LMSH_H_INCLUDED
+
+/*
+ * LightGL mesh files hold ready to bind arrays: a header, one object table entry per object and the arrays,
+ * each starting on a 16 byte boundary. lmshLoad maps the file copy on write, the object pointers point into the
+ * mapping and may be modified, nothing is parsed or computed. Files are little endian, other hosts are refused.
+ *
+ *   header   "LMSH", version, number of objects, zero           4 x 4 bytes
+ *   object   vertices, indices, index size (2 or 4), zero      4 x 4 bytes
+ *            bbox min, bbox max, sphere center and radius       10 floats, 2 x 4 bytes zero
+ *            positions, normals, texcoords, indices offsets   4 x 8 bytes, zero if absent
+ */
+
+#define LMSH_VERSION 1
+
+typedef struct LMSHobject_s {
+	float*        vertices;  /* 3 per vertex */
+	float*        normals;   /* 3 per vertex */
+	float*        texcoords; /* 2 per vertex, NULL if absent */
+	void*         indices;
+	unsigned int  index_size; /* bytes, 2 for unsigned short and 4 for unsigned int indices */
+	unsigned int  num_vertices;
+	unsigned int  num_indices;
+	float         bbox_min[3];
+	float         bbox_max[3];
+	float         sphere[4]; /* center and radius, contains all vertices */
+} LMSHobject;
+
+typedef struct LMSH_s {
+	unsigned int  num_objects;
+	LMSHobject*   objects;
+	void*         data; /* the mapping */
+	unsigned long size;
+} LMSH;
+
+LMSH* lmshLoad(const char* file);
+void  lmshUnload(LMSH* lmsh);
+int   lmshSave(const char* file, const LMSHobject* objects, unsigned int num_objects);
+
+#endif
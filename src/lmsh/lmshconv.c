@@ -0,0 +1,161 @@
+/*
+ *
+ * lmshconv - converts 3DS files to LightGL mesh files
+ *
+ * usage: lmshconv input.3ds output.lmsh [-32] [-area | -angle]
+ *
+ * The triangles of every object are reordered for the vertex cache and overdraw, the vertices in fetch order,
+ * the same way the demo prepares its meshes after loading. -32 stores unsigned int indices, -area and -angle
+ * weight the face normals around a vertex by area or angle instead of equally.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../LGL/lglu.h"
+#include "../LGL/lgljob.h"
+#include "../3ds/3ds.h"
+#include "lmsh.h"
+
+/* copies the array v with num_vertices elements of size bytes in the vertex order of remap, NULL if absent */
+static void* remapArray(const void* v, LGLsize size, LGLsize num_vertices, const LGLuint* remap) {
+	void* d;
+	if (v == NULL) {
+		return NULL;
+	}
+	d = malloc(size * num_vertices);
+	if (d != NULL) {
+		lgluRemapVertices(d, v, size, num_vertices, remap);
+	}
+	return d;
+}
+
+static int convertObject(LMSHobject* object, const A3DS* a3ds, unsigned int i, int wide) {
+	const LGLsize num_vertices = a3ds->num_vertices[i];
+	const LGLsize num_indices = a3ds->num_indices[i];
+	unsigned short* indices;
+	LGLuint* remap;
+	LGLsize j;
+
+	memset(object, 0, sizeof(LMSHobject));
+	object->num_vertices = num_vertices;
+	object->num_indices = num_indices;
+	memcpy(object->bbox_min, a3ds->bbox_min[i], sizeof(object->bbox_min));
+	memcpy(object->bbox_max, a3ds->bbox_max[i], sizeof(object->bbox_max));
+	memcpy(object->sphere, a3ds->sphere[i], sizeof(object->sphere));
+
+	indices = malloc(sizeof(unsigned short) * (num_indices + 1));
+	remap = malloc(sizeof(LGLuint) * (num_vertices + 1));
+	if (indices == NULL || remap == NULL) {
+		free(indices);
+		free(remap);
+		return 0;
+	}
+	memcpy(indices, a3ds->indices[i], sizeof(unsigned short) * num_indices);
+	lgluOptimizeVertexCache(indices, LGL_INDEX_TYPE_USHORT, num_indices, num_vertices);
+	lgluOptimizeOverdraw(indices, LGL_INDEX_TYPE_USHORT, num_indices, (const LGLv3f*) a3ds->vertices[i],
+			num_vertices, 1.2f);
+	lgluOptimizeVertexFetch(remap, indices, LGL_INDEX_TYPE_USHORT, num_indices, num_vertices);
+
+	object->vertices = remapArray(a3ds->vertices[i], sizeof(LGLv3f), num_vertices, remap);
+	object->normals = remapArray(a3ds->normals[i], sizeof(LGLv3f), num_vertices, remap);
+	object->texcoords = remapArray(a3ds->texcoords[i], sizeof(LGLv2f), num_vertices, remap);
+	free(remap);
+
+	if (wide) {
+		unsigned int* indices32 = malloc(sizeof(unsigned int) * (num_indices + 1));
+		if (indices32 != NULL) {
+			for (j = 0; j < num_indices; j++) {
+				indices32[j] = indices[j];
+			}
+		}
+		free(indices);
+		object->indices = indices32;
+		object->index_size = sizeof(unsigned int);
+	} else {
+		object->indices = indices;
+		object->index_size = sizeof(unsigned short);
+	}
+
+	return object->vertices != NULL && object->normals != NULL && object->indices != NULL
+			&& (a3ds->texcoords[i] == NULL || object->texcoords != NULL);
+}
+
+/* loads the written file and compares it with the converted objects */
+static int verifyFile(const char* file, const LMSHobject* objects, unsigned int num_objects) {
+	LMSH* lmsh = lmshLoad(file);
+	unsigned int i;
+	int ok;
+
+	if (lmsh == NULL) {
+		return 0;
+	}
+	ok = lmsh->num_objects == num_objects;
+	for (i = 0; i < num_objects && ok; i++) {
+		const LMSHobject* a = &objects[i];
+		const LMSHobject* b = &lmsh->objects[i];
+		ok = a->num_vertices == b->num_vertices && a->num_indices == b->num_indices
+				&& a->index_size == b->index_size && (a->texcoords == NULL) == (b->texcoords == NULL)
+				&& memcmp(a->vertices, b->vertices, sizeof(float) * 3 * a->num_vertices) == 0
+				&& memcmp(a->normals, b->normals, sizeof(float) * 3 * a->num_vertices) == 0
+				&& (a->texcoords == NULL || memcmp(a->texcoords, b->texcoords, sizeof(float) * 2 * a->num_vertices) == 0)
+				&& memcmp(a->indices, b->indices, (size_t) a->index_size * a->num_indices) == 0;
+	}
+	lmshUnload(lmsh);
+	return ok;
+}
+
+int main(int argc, char* argv[]) {
+	LMSHobject objects[A3DS_MAX_OBJECTS];
+	A3DSnormals normals = A3DS_NORMALS_FACE;
+	LGLjobsystem* jobs;
+	unsigned int i, num_objects = 0;
+	int wide = 0, ok = 1;
+	A3DS* a3ds;
+
+	for (i = 3; i < (unsigned int) argc && ok; i++) {
+		if (strcmp(argv[i], "-32") == 0) {
+			wide = 1;
+		} else if (strcmp(argv[i], "-area") == 0) {
+			normals = A3DS_NORMALS_AREA;
+		} else if (strcmp(argv[i], "-angle") == 0) {
+			normals = A3DS_NORMALS_ANGLE;
+		} else {
+			ok = 0;
+		}
+	}
+	if (argc < 3 || !ok) {
+		fprintf(stderr, "usage: %s input.3ds output.lmsh [-32] [-area | -angle]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* without a job system everything runs on this thread */
+	jobs = lglCreateJobSystem(0, LGL_JOB_AFFINITY_NONE, 0);
+	a3ds = a3dsLoad(argv[1], normals, jobs);
+	if (jobs != NULL) {
+		lglDestroyJobSystem(jobs);
+	}
+	if (a3ds == NULL) {
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < a3ds->num_objects && ok; i++) {
+		ok = convertObject(&objects[i], a3ds, i, wide);
+		num_objects++;
+	}
+	a3dsUnload(a3ds);
+
+	if (!ok) {
+		fprintf(stderr, "Out of memory converting '%s'\n", argv[1]);
+	} else if (!lmshSave(argv[2], objects, num_objects) || !verifyFile(argv[2], objects, num_objects)) {
+		fprintf(stderr, "Unable to write '%s'\n", argv[2]);
+		ok = 0;
+	}
+
+	for (i = 0; i < num_objects; i++) {
+		free(objects[i].vertices);
+		free(objects[i].normals);
+		free(objects[i].texcoords);
+		free(objects[i].indices);
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
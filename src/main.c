@@ -34,7 +34,7 @@ int main(int argc, char* argv[]) {
 
 	SDL_WM_SetCaption("LightGL Software Rasterizer", NULL);
 
-	if (sceneInit(framebuffer->pixels, framebuffer->w, framebuffer->h,
+	if (sceneInit(framebuffer->w, framebuffer->h,
 			framebuffer->format->Rshift, framebuffer->format->Gshift,
 			framebuffer->format->Bshift) == -1) {
 		printf("Could not initialize scene.\n");
@@ -48,13 +48,16 @@ int main(int argc, char* argv[]) {
 	while (loop) {
 		sceneUpdate(dtime / 1000.0f);
 
+		/* submits the frame, it is rasterized while the next one is updated */
+		sceneRender();
+
 		if (SDL_LockSurface(framebuffer) == -1) {
 			printf("Could not lock framebuffer: %s.\n", SDL_GetError());
 			sceneClose();
 			SDL_Quit();
 			return EXIT_FAILURE;
 		}
-		sceneRender();
+		scenePresent(framebuffer->pixels, framebuffer->pitch);
 		SDL_UnlockSurface(framebuffer);
 
 		if (SDL_Flip(framebuffer) == -1) {
@@ -4,11 +4,14 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "LGL/lgl.h"
 #include "LGL/lglu.h"
+#include "LGL/lgljob.h"
 #include "3ds/3ds.h"
 #include "tga/tga.h"
+#include "asset/asset.h"
 #include "scene.h"
 
 /* Uniforms */
@@ -25,10 +28,26 @@
 /* Textures */
 #define TEX_DIFFUSE 0
 
+/* levels of detail per object, each with half the triangles of the previous one */
+#define MAX_LODS 6
+
 LGLcontext* context;
+LGLjobsystem* jobs;
+ASSETloader* loader;
+ASSET* ast_stone;
+ASSET* ast_wood;
+ASSET* ast_monkey;
 TGA* tex_stone;
 TGA* tex_wood;
-A3DS* msh_monkey;
+A3DS* msh_monkey; /* set by scenePrepareMonkey, read once ast_monkey is ready */
+LGLdrawrecord drw_monkey[A3DS_MAX_OBJECTS];
+LGLm4x4f mvp; /* bounds transform of the monkey records, read while they are issued */
+LGLushort* lod_monkey[A3DS_MAX_OBJECTS]; /* index buffers of the levels, NULL draws the loaded indices */
+LGLUlod lods_monkey[A3DS_MAX_OBJECTS][MAX_LODS];
+LGLuint num_lods_monkey[A3DS_MAX_OBJECTS];
+LGLUmeshlet* meshlets_monkey[A3DS_MAX_OBJECTS]; /* of level 0, NULL draws the whole level */
+LGLsize num_meshlets_monkey[A3DS_MAX_OBJECTS];
+LGLdrawrecord* drw_visible; /* the records issued per frame, one per object or visible run of meshlets */
 LGLfloat global_time = 0.0f;
 
 LGLv3f vertices[6];
@@ -36,6 +55,15 @@ LGLuint indices[6];
 
 LGLv3f light_pos;
 
+/* rows copied by one present job */
+#define PRESENT_ROWS 32
+
+typedef struct Present_s {
+	const LGLFramebufferinfo* front;
+	unsigned int* pixels;
+	int pitch;
+} Present;
+
 void vsTransform(LGLvsout* out, const LGLvsin* in) {
 	lgluTransform(&out->position, &in->uniforms[UNI_MVP_MATRIX].m4x4, &in->vertex_stream[in->index]);
 	//out->varyings[ATR_NORMAL].v3 = in->attributes[ATR_NORMAL].v3[in->index];
@@ -57,7 +85,7 @@ void fsDiffuse(LGLfsout* out, const LGLfsin* in) {
 
 	lgluInterpolatev3f(&n, in->a, &in->varyings[0][ATR_NORMAL].v3, in->b, &in->varyings[1][ATR_NORMAL].v3, in->c,
 			&in->varyings[2][ATR_NORMAL].v3);
-	lgluVectorNormalize(&n);
+	lgluShaderNormalize(&n);
 
 	l.x = -10;
 	l.y = 10;
@@ -66,7 +94,7 @@ void fsDiffuse(LGLfsout* out, const LGLfsin* in) {
 	d.x = l.x - in->varyings[0][ATR_POSITION].v3.x;
 	d.y = l.y - in->varyings[1][ATR_POSITION].v3.y;
 	d.z = l.z - in->varyings[2][ATR_POSITION].v3.z;
-	lgluVectorNormalize(&d);
+	lgluShaderNormalize(&d);
 
 	LGLfloat di = lgluVectorDot(&n, &d);
 	if (di <= 0)
@@ -77,33 +105,167 @@ void fsDiffuse(LGLfsout* out, const LGLfsin* in) {
 	out->color.b = di; //n.z * 0.5 + 0.5;
 }
 
-int sceneInit(unsigned int* pixels, int w, int h, int rshift, int gshift, int bshift) {
+/* reorders the triangles for the vertex cache, then for overdraw, then the vertices in first use order */
+static void sceneOptimizeMesh(A3DS* a3ds, unsigned int i) {
+	const LGLsize num_vertices = a3ds->num_vertices[i];
+	LGLuint* remap;
+	float *vertices, *normals;
+
+	if (!lgluOptimizeVertexCache(a3ds->indices[i], LGL_INDEX_TYPE_USHORT, a3ds->num_indices[i], num_vertices)) {
+		return;
+	}
+	lgluOptimizeOverdraw(a3ds->indices[i], LGL_INDEX_TYPE_USHORT, a3ds->num_indices[i],
+			(const LGLv3f*) a3ds->vertices[i], num_vertices, 1.2f);
+
+	remap = malloc(sizeof(LGLuint) * num_vertices);
+	vertices = malloc(sizeof(LGLv3f) * num_vertices);
+	normals = malloc(sizeof(LGLv3f) * num_vertices);
+	if (remap != NULL && vertices != NULL && normals != NULL) {
+		lgluOptimizeVertexFetch(remap, a3ds->indices[i], LGL_INDEX_TYPE_USHORT, a3ds->num_indices[i], num_vertices);
+		lgluRemapVertices(vertices, a3ds->vertices[i], sizeof(LGLv3f), num_vertices, remap);
+		lgluRemapVertices(normals, a3ds->normals[i], sizeof(LGLv3f), num_vertices, remap);
+		free(a3ds->vertices[i]);
+		free(a3ds->normals[i]);
+		a3ds->vertices[i] = vertices;
+		a3ds->normals[i] = normals;
+		vertices = normals = NULL;
+	}
+	free(remap);
+	free(vertices);
+	free(normals);
+}
+
+/* reorders the triangles into meshlets, level 0 of the LODs keeps their order */
+static void sceneBuildMeshlets(A3DS* a3ds, unsigned int i) {
+	meshlets_monkey[i] = malloc(sizeof(LGLUmeshlet) * (a3ds->num_indices[i] / 24 + 1));
+	if (meshlets_monkey[i] == NULL) {
+		return;
+	}
+	num_meshlets_monkey[i] = lgluBuildMeshlets(meshlets_monkey[i], a3ds->indices[i], LGL_INDEX_TYPE_USHORT,
+			a3ds->num_indices[i], (const LGLv3f*) a3ds->vertices[i], a3ds->num_vertices[i], 0.5f);
+	if (num_meshlets_monkey[i] == 0) {
+		free(meshlets_monkey[i]);
+		meshlets_monkey[i] = NULL;
+	}
+}
+
+/* the levels share the vertices of the object, without memory the full mesh is drawn */
+static void sceneBuildLods(A3DS* a3ds, unsigned int i) {
+	const LGLsize capacity = a3ds->num_indices[i] * 3;
+
+	lod_monkey[i] = malloc(sizeof(LGLushort) * capacity);
+	if (lod_monkey[i] == NULL) {
+		return;
+	}
+	num_lods_monkey[i] = lgluBuildLods(lods_monkey[i], MAX_LODS, lod_monkey[i], capacity, a3ds->indices[i],
+			LGL_INDEX_TYPE_USHORT, a3ds->num_indices[i], (const LGLv3f*) a3ds->vertices[i], a3ds->num_vertices[i],
+			0.5f);
+	if (num_lods_monkey[i] == 0) {
+		free(lod_monkey[i]);
+		lod_monkey[i] = NULL;
+	}
+}
+
+/* runs on a loader thread, the records are used once ast_monkey is ready */
+static int scenePrepareMonkey(ASSET* asset, void* data, void* user) {
+	A3DS* a3ds = data;
+	unsigned int i;
+	LGLsize num_records = 0;
+
+	(void) asset;
+	(void) user;
+	if (a3ds == NULL) {
+		return 0;
+	}
+
+	/* one draw record per object, textures, uniforms and varying layout come from the context */
+	for (i = 0; i < a3ds->num_objects; i++) {
+		LGLdrawrecord* draw = &drw_monkey[i];
+		sceneOptimizeMesh(a3ds, i);
+		sceneBuildMeshlets(a3ds, i);
+		sceneBuildLods(a3ds, i);
+		num_records += num_meshlets_monkey[i] > 0 ? num_meshlets_monkey[i] : 1;
+		memset(draw, 0, sizeof(LGLdrawrecord));
+		draw->type = LGL_DRAW_TYPE_TRIANGLE_LIST;
+		draw->vertex_shader = vsTransform;
+		draw->fragment_shader = fsDiffuse;
+		draw->vertex_stream = (LGLv3f*) a3ds->vertices[i];
+		draw->vertex_stream_elements = a3ds->num_vertices[i];
+		draw->index_stream = a3ds->indices[i];
+		draw->index_type = LGL_INDEX_TYPE_USHORT;
+		draw->index_count = a3ds->num_indices[i];
+		draw->attributes[ATR_NORMAL].v3 = (LGLv3f*) a3ds->normals[i];
+		draw->num_attributes[ATR_NORMAL] = a3ds->num_vertices[i];
+		draw->bounds_transform = &mvp;
+		memcpy(&draw->bounds_min, a3ds->bbox_min[i], sizeof(LGLv3f));
+		memcpy(&draw->bounds_max, a3ds->bbox_max[i], sizeof(LGLv3f));
+		if (lod_monkey[i] != NULL) {
+			draw->index_stream = lod_monkey[i];
+		}
+	}
+
+	drw_visible = malloc(sizeof(LGLdrawrecord) * num_records);
+	if (drw_visible == NULL) {
+		return 0;
+	}
+
+	msh_monkey = a3ds;
+	return 1;
+}
+
+int sceneInit(int w, int h, int rshift, int gshift, int bshift) {
 	LGLFramebufferinfo fbinfo;
+	LGLvaryinglayout layout;
 
-	fbinfo.framebuffer = pixels;
-	fbinfo.zbuffer = malloc(sizeof(unsigned short) * w * h); /* always 16 bit! */
+	fbinfo.framebuffer = NULL; /* allocated by the context */
+	fbinfo.zbuffer = NULL;
 	fbinfo.width = w;
 	fbinfo.height = h;
 	fbinfo.rshift = rshift;
 	fbinfo.gshift = gshift;
 	fbinfo.bshift = bshift;
 
-	context = lglCreateContext(&fbinfo);
+	/* double buffered: frame N renders while frame N + 1 is updated */
+	context = lglCreateBufferedContext(&fbinfo, 2);
 	if (context == NULL) {
 		fprintf(stderr, "Could not create rendering context.\n");
 		return -1;
 	}
 
-	tex_stone = tgaLoad("data/stone.tga");
-	tex_wood = tgaLoad("data/wood.tga");
+	/* one worker per processor, shared by the context and scenePresent */
+	jobs = lglCreateJobSystem(0, LGL_JOB_AFFINITY_NONE, 0);
+	if (jobs == NULL) {
+		fprintf(stderr, "Could not create job system.\n");
+		return -1;
+	}
+	lglSetJobSystem(context, jobs);
+
+	/* vsTransform writes the world space position and normal */
+	layout.num_varyings = 2;
+	layout.components[ATR_POSITION] = 3;
+	layout.components[ATR_NORMAL] = 3;
+	lglSetVaryingLayout(context, &layout);
+
+	/* the files load in parallel on the loader's threads, the monkey is prepared for rendering there too */
+	loader = assetCreateLoader(0);
+	if (loader == NULL) {
+		fprintf(stderr, "Could not create asset loader.\n");
+		return -1;
+	}
+	ast_stone = assetLoad(loader, ASSET_TYPE_TGA, "data/stone.tga", NULL, NULL);
+	ast_wood = assetLoad(loader, ASSET_TYPE_TGA, "data/wood.tga", NULL, NULL);
+	ast_monkey = assetLoad(loader, ASSET_TYPE_3DS, "data/monkey.3ds", scenePrepareMonkey, NULL);
 
-	if (tex_stone == NULL || tex_wood == NULL) {
+	if (ast_stone == NULL || ast_wood == NULL || ast_monkey == NULL) {
 		return -1;
 	}
 
-	msh_monkey = a3dsLoad("data/monkey.3ds");
+	/* the first frame shows the whole scene, assets loaded later join sceneRender once they are ready */
+	assetWaitAll(loader);
+	tex_stone = assetGetData(ast_stone);
+	tex_wood = assetGetData(ast_wood);
 
-	if (msh_monkey == NULL) {
+	if (tex_stone == NULL || tex_wood == NULL || assetGetState(ast_monkey) != ASSET_STATE_READY) {
 		return -1;
 	}
 
@@ -143,7 +305,7 @@ int sceneInit(unsigned int* pixels, int w, int h, int rshift, int gshift, int bs
 }
 
 void sceneUpdate(float dtime) {
-	LGLm4x4f mvp, mit, m, v, p, s, r, t;
+	LGLm4x4f mit, m, v, p, s, r, t;
 
 	global_time += dtime * 0.5f;
 
@@ -170,6 +332,9 @@ void sceneUpdate(float dtime) {
 }
 
 void sceneRender() {
+	unsigned int i;
+	LGLsize num_visible = 0;
+
 	lglClear(context, LGL_CLEAR_FRAMEBUFFER | LGL_CLEAR_ZBUFFER);
 
 	lglSetFragmentShader(context, fsDiffuse);
@@ -178,20 +343,64 @@ void sceneRender() {
 	lglSetVertexStream(context, vertices, 6);
 	lglSetIndexStream(context, indices, 6);
 
-	lglSetVertexStream(context, (LGLv3f*) msh_monkey->vertices[0], msh_monkey->num_vertices[0]);
-	lglSetVertexAttribsv3f(context, ATR_NORMAL, (LGLv3f*) msh_monkey->normals[0], msh_monkey->num_vertices[0]);
-	//	lglSetVertexAttribsv2f(context, ATR_TEXCOORD, (LGLv2f*) (msh_monkey->texcoords[0]), msh_monkey->num_vertices[0]);
-	lglSetIndexStream(context, msh_monkey->indices[0], msh_monkey->num_indices[0]);
-
 	//lglSetTextureData2d(context, TEX_DIFFUSE, tex_stone->pixels, tex_stone->width, tex_stone->height);
 
-	lglDrawIndexed(context, LGL_DRAW_TYPE_TRIANGLE_LIST);
+	/* the level whose error stays below a pixel, level 0 is drawn by its visible meshlets */
+	for (i = 0; assetGetState(ast_monkey) == ASSET_STATE_READY && i < msh_monkey->num_objects; i++) {
+		LGLuint level = 0;
+		if (lod_monkey[i] != NULL) {
+			level = lgluSelectLod(&drw_monkey[i], lods_monkey[i], num_lods_monkey[i], lglGetFBInfo(context)->height,
+					1.0f);
+		}
+		if (level == 0 && meshlets_monkey[i] != NULL) {
+			num_visible += lgluCullMeshlets(&drw_visible[num_visible], &drw_monkey[i], meshlets_monkey[i],
+					num_meshlets_monkey[i], &mvp);
+		} else {
+			drw_visible[num_visible++] = drw_monkey[i];
+		}
+	}
+	/* recorded commands copy the records */
+	lglMultiDrawIndexed(context, drw_visible, num_visible);
+
+	lglSwapBuffers(context);
+}
+
+void presentRows(void* data, LGLuint index) {
+	const Present* present = data;
+	const LGLFramebufferinfo* front = present->front;
+	unsigned int y;
+
+	for (y = index * PRESENT_ROWS; y < front->height && y < (index + 1) * PRESENT_ROWS; y++) {
+		memcpy((char*) present->pixels + y * present->pitch, (unsigned int*) front->framebuffer + y * front->width,
+				front->width * sizeof(unsigned int));
+	}
+}
+
+void scenePresent(unsigned int* pixels, int pitch) {
+	LGLjobgroup group = { 0 };
+	Present present;
+
+	present.front = lglGetFrontBuffer(context);
+	present.pixels = pixels;
+	present.pitch = pitch;
+
+	/* the copy runs on the workers, next to the render thread's jobs */
+	lglRunJobs(jobs, &group, presentRows, &present, (present.front->height + PRESENT_ROWS - 1) / PRESENT_ROWS);
+	lglWaitJobs(jobs, &group);
 }
 
 void sceneClose() {
-	tgaUnload(tex_stone);
-	tgaUnload(tex_wood);
-	a3dsUnload(msh_monkey);
-	free(lglGetFBInfo(context)->zbuffer);
+	unsigned int i;
+
+	assetUnload(ast_stone);
+	assetUnload(ast_wood);
 	lglDestroyContext(context);
+	lglDestroyJobSystem(jobs);
+	for (i = 0; i < A3DS_MAX_OBJECTS; i++) {
+		free(lod_monkey[i]);
+		free(meshlets_monkey[i]);
+	}
+	free(drw_visible);
+	assetUnload(ast_monkey);
+	assetDestroyLoader(loader);
 }
@@ -5,9 +5,10 @@
 #ifndef SCENE_H_INCLUDED
 #define SCENE_H_INCLUDED
 
-int sceneInit(unsigned int* pixels, int w, int h, int rshift, int gshift, int bshift);
+int sceneInit(int w, int h, int rshift, int gshift, int bshift);
 void sceneUpdate(float delta);
 void sceneRender();
+void scenePresent(unsigned int* pixels, int pitch);
 void sceneKeyboardEvent();
 void sceneClose();
 
@@ -6,106 +6,235 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h> /* for open */
+#include <unistd.h> /* for close */
+#include <sys/mman.h> /* for mmap and munmap */
+#include <sys/stat.h> /* for fstat */
 #include "tga.h"
 
+#if defined(__SSSE3__) && !defined(TGA_NO_SIMD)
+#include <tmmintrin.h>
+#define TGA_SSSE3 1
+#elif defined(__SSE2__) && !defined(TGA_NO_SIMD)
+#include <emmintrin.h>
+#define TGA_SSE2 1
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TGA_LITTLE_ENDIAN 1
+#endif
+
 #define TGA_OUT "tga: "
 
-static int tgaReadUChar(FILE* f, unsigned char* c) {
-	return fread(c, 1, 1, f) == 1;
+#define TGA_HEADER_SIZE      18
+#define TGA_TYPE_RGB         2
+#define TGA_TYPE_RGB_RLE     10
+#define TGA_ATTR_RIGHT_LEFT  0x10
+#define TGA_ATTR_TOP_BOTTOM  0x20
+
+static unsigned short tgaGetShort(const unsigned char* p) {
+	return (unsigned short) (p[0] | p[1] << 8);
+}
+
+/* converts count BGR or BGRA pixels to XRGB or ARGB */
+static void tgaConvert(unsigned int* d, const unsigned char* s, unsigned int count, unsigned int bpp) {
+	unsigned int i = 0;
+
+	if (bpp == 32) {
+#if TGA_LITTLE_ENDIAN
+		memcpy(d, s, sizeof(unsigned int) * count);
+		return;
+#else
+		for (; i < count; i++, s += 4) {
+			d[i] = (unsigned int) s[3] << 24 | s[2] << 16 | s[1] << 8 | s[0];
+		}
+		return;
+#endif
+	}
+
+#if TGA_SSSE3
+	/* four pixels from 12 of the 16 loaded bytes, the loads stay within the 3 * count source bytes */
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	for (; i * 3 + 16 <= count * 3; i += 4) {
+		const __m128i bgr = _mm_loadu_si128((const __m128i*) (s + i * 3));
+		_mm_storeu_si128((__m128i*) (d + i), _mm_shuffle_epi8(bgr, shuffle));
+	}
+#elif TGA_SSE2
+	/* without a byte shuffle, pixel k is shifted k bytes up into its lane and masked */
+	const __m128i mask = _mm_setr_epi32(0x00ffffff, 0, 0, 0);
+	for (; i * 3 + 16 <= count * 3; i += 4) {
+		const __m128i bgr = _mm_loadu_si128((const __m128i*) (s + i * 3));
+		__m128i xrgb = _mm_and_si128(bgr, mask);
+		xrgb = _mm_or_si128(xrgb, _mm_and_si128(_mm_slli_si128(bgr, 1), _mm_slli_si128(mask, 4)));
+		xrgb = _mm_or_si128(xrgb, _mm_and_si128(_mm_slli_si128(bgr, 2), _mm_slli_si128(mask, 8)));
+		xrgb = _mm_or_si128(xrgb, _mm_and_si128(_mm_slli_si128(bgr, 3), _mm_slli_si128(mask, 12)));
+		_mm_storeu_si128((__m128i*) (d + i), xrgb);
+	}
+#endif
+	for (; i < count; i++) {
+		d[i] = s[i * 3 + 2] << 16 | s[i * 3 + 1] << 8 | s[i * 3 + 0];
+	}
 }
 
-static int tgaReadUShort(FILE* f, unsigned short* us) {
-	unsigned char b[2];
-	size_t read = fread(b, 2, 1, f);
-	*us = b[1] << 8 | b[0];
-	return read;
+/* runs of up to 128 pixels, a header byte with the high bit set repeats one pixel, otherwise pixels follow */
+static int tgaDecodeRle(unsigned int* d, unsigned int count, const unsigned char* s, const unsigned char* end,
+		unsigned int bpp) {
+	const unsigned int size = bpp / 8;
+	unsigned int i = 0, j, n;
+
+	while (i < count) {
+		if (s >= end) {
+			return 0;
+		}
+		n = (*s & 0x7f) + 1;
+		if (n > count - i) {
+			return 0;
+		}
+		if (*s++ & 0x80) {
+			if ((size_t) (end - s) < size) {
+				return 0;
+			}
+			tgaConvert(&d[i], s, 1, bpp);
+			for (j = 1; j < n; j++) {
+				d[i + j] = d[i];
+			}
+			s += size;
+		} else {
+			if ((size_t) (end - s) < (size_t) n * size) {
+				return 0;
+			}
+			tgaConvert(&d[i], s, n, bpp);
+			s += n * size;
+		}
+		i += n;
+	}
+	return 1;
 }
 
-static int tgaReadColor(FILE* f, unsigned int* col) {
-	unsigned char b[3];
-	size_t read = fread(b, 3, 1, f);
-	*col = (b[2] << 16) | (b[1] << 8) | b[0];
-	return read;
+/* swaps the rows top to bottom */
+static int tgaFlip(TGA* tga) {
+	const size_t pitch = sizeof(unsigned int) * tga->width;
+	unsigned int* row = malloc(pitch);
+	unsigned int y;
+
+	if (row == NULL) {
+		return 0;
+	}
+	for (y = 0; y < tga->height / 2; y++) {
+		unsigned int* a = &tga->pixels[y * tga->width];
+		unsigned int* b = &tga->pixels[(tga->height - 1 - y) * tga->width];
+		memcpy(row, a, pitch);
+		memcpy(a, b, pitch);
+		memcpy(b, row, pitch);
+	}
+	free(row);
+	return 1;
 }
 
 TGA* tgaLoad(const char* filename) {
 	TGA* tga;
-	FILE* file;
-	unsigned char lenid;
-	unsigned char paltype;
-	unsigned char imgtype;
-	unsigned short palstart, pallen;
-	unsigned char palitmsize;
-	unsigned short startx, starty, width, height;
-	unsigned char bpp, attr;
-	unsigned int col;
-	int i, j;
-
-	file = fopen(filename, "rb");
-	if (file == NULL) {
+	struct stat info;
+	const unsigned char *data, *p, *end;
+	unsigned char lenid, paltype, imgtype, palitmsize, bpp, attr;
+	unsigned short palstart, pallen, width, height;
+	unsigned int y;
+	int fd, ok;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
 		fprintf(stderr, TGA_OUT "Unable to load TGA file: %s\n", filename);
 		return NULL;
 	}
+	if (fstat(fd, &info) != 0 || info.st_size < TGA_HEADER_SIZE) {
+		fprintf(stderr, TGA_OUT "Unable to read TGA file: %s\n", filename);
+		close(fd);
+		return NULL;
+	}
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); /* the mapping stays valid */
+	if (data == MAP_FAILED) {
+		fprintf(stderr, TGA_OUT "Unable to read TGA file: %s\n", filename);
+		return NULL;
+	}
+	end = data + info.st_size;
 
-	tga = malloc(sizeof(TGA));
+	tga = calloc(1, sizeof(TGA));
 	if (tga == NULL) {
 		fprintf(stderr, TGA_OUT "Unable to allocate TGA struct: %s\n", filename);
-		fclose(file);
+		munmap((void*) data, info.st_size);
 		return NULL;
 	}
 
-	memset(tga, 0, sizeof(TGA));
-
 	printf(TGA_OUT "Loading %s ...\n", filename);
 
-	tgaReadUChar(file, &lenid);
-	tgaReadUChar(file, &paltype);
-	tgaReadUChar(file, &imgtype);
-	tgaReadUShort(file, &palstart);
-	tgaReadUShort(file, &pallen);
-	tgaReadUChar(file, &palitmsize);
-	tgaReadUShort(file, &startx);
-	tgaReadUShort(file, &starty);
-	tgaReadUShort(file, &width);
-	tgaReadUShort(file, &height);
-	tgaReadUChar(file, &bpp);
-	tgaReadUChar(file, &attr);
+	lenid = data[0];
+	paltype = data[1];
+	imgtype = data[2];
+	palstart = tgaGetShort(data + 3);
+	pallen = tgaGetShort(data + 5);
+	palitmsize = data[7];
+	width = tgaGetShort(data + 12);
+	height = tgaGetShort(data + 14);
+	bpp = data[16];
+	attr = data[17];
 
 #ifndef NDEBUG
 	printf(TGA_OUT " Image header:\n");
 	printf(TGA_OUT " lenid:%d paltype:%d imgtype:%d\n", (int) lenid, (int) paltype, (int) imgtype);
 	printf(TGA_OUT " palstart:%d pallen:%d palitmsize:%d\n", (int) palstart, (int) pallen, (int) palitmsize);
-	printf(TGA_OUT " sx:%d sy:%d w:%d h:%d\n", (int) startx, (int) startx, (int) width, (int) height);
+	printf(TGA_OUT " sx:%d sy:%d w:%d h:%d\n", (int) tgaGetShort(data + 8), (int) tgaGetShort(data + 10),
+			(int) width, (int) height);
 	printf(TGA_OUT " bpp:%d attr:%d\n", (int) bpp, (int) attr);
 #endif
 
-	if (lenid != 0 || paltype != 0 || imgtype != 2 || palstart != 0 || pallen != 0 || palitmsize != 0 || bpp != 24
-			|| attr != 32) {
+	/* the image id and a color map of a true color image are skipped */
+	p = data + TGA_HEADER_SIZE + lenid + (size_t) pallen * ((palitmsize + 7) / 8);
+	if (paltype != 0 || (imgtype != TGA_TYPE_RGB && imgtype != TGA_TYPE_RGB_RLE) || (bpp != 24 && bpp != 32)
+			|| (attr & TGA_ATTR_RIGHT_LEFT) || width == 0 || height == 0 || p > end) {
 		fprintf(stderr,
-				TGA_OUT  "Unable to load TGA file: %s."
-				" Must be an uncompressed RGB (24bit) image in top left format.\n",
+				TGA_OUT "Unable to load TGA file: %s."
+				" Must be a RGB (24bit) or RGBA (32bit) image, uncompressed or RLE, stored left to right.\n",
 				filename);
 		free(tga);
-		fclose(file);
+		munmap((void*) data, info.st_size);
 		return NULL;
 	}
+	(void) palstart;
 
+	tga->width = width;
+	tga->height = height;
 	tga->pixels = malloc(sizeof(unsigned int) * width * height);
-	if(tga->pixels == NULL) {
+	if (tga->pixels == NULL) {
 		fprintf(stderr, TGA_OUT "Unable to allocate image data for file: %s\n", filename);
 		free(tga);
-		fclose(file);
+		munmap((void*) data, info.st_size);
 		return NULL;
 	}
 
-	for (i = 0; i < height; i++) {
-		for (j = 0; j < width; j++) {
-			tgaReadColor(file, &col);
-			tga->pixels[i * width + j] = col;
+	if (imgtype == TGA_TYPE_RGB) {
+		const size_t pitch = (size_t) width * (bpp / 8);
+		ok = (size_t) (end - p) >= pitch * height;
+		if (ok && (attr & TGA_ATTR_TOP_BOTTOM)) {
+			tgaConvert(tga->pixels, p, (unsigned int) width * height, bpp);
+		} else if (ok) {
+			/* bottom up, every row is converted into its flipped place */
+			for (y = 0; y < height; y++) {
+				tgaConvert(&tga->pixels[(height - 1 - y) * width], p + y * pitch, width, bpp);
+			}
+		}
+	} else {
+		ok = tgaDecodeRle(tga->pixels, (unsigned int) width * height, p, end, bpp);
+		if (ok && !(attr & TGA_ATTR_TOP_BOTTOM)) {
+			ok = tgaFlip(tga);
 		}
 	}
+	munmap((void*) data, info.st_size);
 
-	fclose(file);
+	if (!ok) {
+		fprintf(stderr, TGA_OUT "Invalid TGA file: %s\n", filename);
+		tgaUnload(tga);
+		return NULL;
+	}
 	return tga;
 }
 
@@ -113,3 +242,48 @@ void tgaUnload(TGA* data) {
 	free(data->pixels);
 	free(data);
 }
+
+int tgaSave(const char* filename, const unsigned int* pixels, unsigned int width, unsigned int height) {
+	unsigned char header[TGA_HEADER_SIZE] = { 0 };
+	unsigned char* data;
+	unsigned int i;
+	FILE* file;
+	int ok;
+
+	assert(pixels != NULL);
+	assert(width > 0 && width <= 0xffff && height > 0 && height <= 0xffff);
+
+	/* the whole image is converted first and written at once */
+	data = malloc((size_t) width * height * 3);
+	if (data == NULL) {
+		return 0;
+	}
+	for (i = 0; i < width * height; i++) {
+		data[i * 3 + 0] = pixels[i] & 0xff;
+		data[i * 3 + 1] = pixels[i] >> 8 & 0xff;
+		data[i * 3 + 2] = pixels[i] >> 16 & 0xff;
+	}
+
+	header[2] = TGA_TYPE_RGB;
+	header[12] = width & 0xff;
+	header[13] = width >> 8;
+	header[14] = height & 0xff;
+	header[15] = height >> 8;
+	header[16] = 24;
+	header[17] = TGA_ATTR_TOP_BOTTOM;
+
+	file = fopen(filename, "wb");
+	if (file == NULL) {
+		fprintf(stderr, TGA_OUT "Unable to save TGA file: %s\n", filename);
+		free(data);
+		return 0;
+	}
+	ok = fwrite(header, 1, sizeof(header), file) == sizeof(header)
+			&& fwrite(data, 3, (size_t) width * height, file) == (size_t) width * height;
+	ok = fclose(file) == 0 && ok;
+	free(data);
+	if (!ok) {
+		fprintf(stderr, TGA_OUT "Unable to write TGA file: %s\n", filename);
+	}
+	return ok;
+}
@@ -5,6 +5,7 @@
 #ifndef TGA_H_INCLUDED
 #define TGA_H_INCLUDED
 
+/* top row first, 0xAARRGGBB, alpha is 0 for 24 bit images */
 typedef struct TGA_s {
 	unsigned int* pixels;
 	unsigned int  width;
@@ -14,4 +15,7 @@ typedef struct TGA_s {
 TGA* tgaLoad(const char* file);
 void tgaUnload(TGA* data);
 
+/* writes an uncompressed 24 bit top-left image, the alpha byte is dropped */
+int  tgaSave(const char* file, const unsigned int* pixels, unsigned int width, unsigned int height);
+
 #endif
@@ -0,0 +1,171 @@
+/*
+ *
+ * LightGL - Draw Bounds Test
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ * Draws a triangle inside its draw bounds through a perspective transform and fails when the draw is dropped
+ * although lgluFrustumTestBox finds the box visible, or kept although it finds it outside. Then queries
+ * lglDrawBoundingBox proxies through the same transform, in front of and behind an occluder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/LGL/lgl.h"
+#include "../src/LGL/lglu.h"
+
+#define TEST_SIZE 32
+
+typedef struct Box_s {
+	const char* name;
+	LGLv3f min, max;
+} Box;
+
+static Box boxes[] = {
+	{ "off center, visible", { 2.0f, 2.0f, -10.0f }, { 4.0f, 4.0f, -10.0f } },
+	{ "beside the frustum", { 20.0f, 2.0f, -10.0f }, { 24.0f, 4.0f, -10.0f } },
+	{ "behind the eye", { -1.0f, -1.0f, 5.0f }, { 1.0f, 1.0f, 6.0f } },
+	{ "crossing the eye plane", { 2.0f, 2.0f, -5.0f }, { 4.0f, 4.0f, 5.0f } },
+	{ "beyond the far plane", { -1.0f, -1.0f, -300.0f }, { 1.0f, 1.0f, -200.0f } }
+};
+
+typedef struct Proxy_s {
+	const char* name;
+	LGLv3f min, max;
+	LGLint visible;
+} Proxy;
+
+static Proxy proxies[] = {
+	{ "off center", { 2.0f, 2.0f, -12.0f }, { 4.0f, 4.0f, -8.0f }, 1 },
+	{ "beside the frustum", { 20.0f, 2.0f, -12.0f }, { 24.0f, 4.0f, -8.0f }, 0 },
+	{ "behind the occluder", { -2.0f, -1.0f, -12.0f }, { -1.0f, 1.0f, -8.0f }, 0 },
+	{ "crossing the eye plane", { -1.0f, -1.0f, -5.0f }, { 1.0f, 1.0f, 5.0f }, 1 }
+};
+
+static LGLm4x4f projection;
+static LGLuint shaded;
+static int failed;
+
+static void fail(const char* name, const char* message) {
+	printf("%s: %s\n", name, message);
+	failed = 1;
+}
+
+/* the perspective divide is left to the vertex shader */
+static void vsProject(LGLvsout* out, const LGLvsin* in) {
+	const LGLv3f* v = &in->vertex_stream[in->index];
+	const LGLfloat w = projection.m41 * v->x + projection.m42 * v->y + projection.m43 * v->z + projection.m44;
+
+	lgluTransform(&out->position, &projection, v);
+	out->position.x /= w;
+	out->position.y /= w;
+	out->position.z /= w;
+	shaded++;
+}
+
+static void fsWhite(LGLfsout* out, const LGLfsin* in) {
+	(void) in;
+	out->color.r = 1.0f;
+	out->color.g = 1.0f;
+	out->color.b = 1.0f;
+}
+
+static void testBounds(LGLcontext* context) {
+	const LGLuint num_boxes = sizeof(boxes) / sizeof(boxes[0]);
+	LGLuint indices[3] = { 0, 1, 2 };
+	LGLUfrustum frustum;
+	LGLuint i;
+
+	lgluFrustumFromMatrix(&frustum, &projection);
+	lglSetIndexStream(context, indices, 3);
+	for (i = 0; i < num_boxes; i++) {
+		const Box* box = &boxes[i];
+		const LGLUvisibility visibility = lgluFrustumTestBox(&frustum, &box->min, &box->max);
+		/* a triangle spanning the box, its vertices lie inside it */
+		LGLv3f vertices[3] = { { box->min.x, box->min.y, box->min.z }, { box->max.x, box->min.y, box->max.z },
+				{ box->min.x, box->max.y, box->max.z } };
+
+		lglSetVertexStream(context, vertices, 3);
+		lglSetDrawBounds(context, &projection, &box->min, &box->max);
+		shaded = 0;
+		lglDrawIndexed(context, LGL_DRAW_TYPE_TRIANGLE_LIST);
+		lglFinish(context);
+		if (visibility != LGLU_OUTSIDE && shaded == 0) {
+			fail(box->name, "dropped although the frustum test finds it visible");
+		}
+		if (visibility == LGLU_OUTSIDE && shaded != 0) {
+			fail(box->name, "drawn although the frustum test finds it outside");
+		}
+	}
+	lglSetDrawBounds(context, NULL, NULL, NULL);
+	printf("%u draw bounds through a perspective transform\n", num_boxes);
+}
+
+static void testProxies(LGLcontext* context) {
+	const LGLuint num_proxies = sizeof(proxies) / sizeof(proxies[0]);
+	/* a quad covering the left half of the view at z = -4, it hides the boxes behind it */
+	LGLv3f vertices[4] = { { -3.0f, -3.0f, -4.0f }, { 0.0f, -3.0f, -4.0f }, { 0.0f, 3.0f, -4.0f },
+			{ -3.0f, 3.0f, -4.0f } };
+	LGLuint indices[6] = { 0, 1, 2, 0, 2, 3 };
+	LGLquery* query = lglCreateQuery(context);
+	LGLuint i;
+
+	if (query == NULL) {
+		fail("query", "out of memory");
+		return;
+	}
+	lglClear(context, LGL_CLEAR_FRAMEBUFFER | LGL_CLEAR_ZBUFFER);
+	lglSetVertexStream(context, vertices, 4);
+	lglSetIndexStream(context, indices, 6);
+	lglDrawIndexed(context, LGL_DRAW_TYPE_TRIANGLE_LIST);
+	for (i = 0; i < num_proxies; i++) {
+		const Proxy* proxy = &proxies[i];
+		LGLuint samples;
+
+		lglBeginQuery(context, query);
+		lglDrawBoundingBox(context, &projection, &proxy->min, &proxy->max);
+		lglEndQuery(context);
+		samples = lglGetQueryResult(context, query);
+		if (proxy->visible && samples == 0) {
+			fail(proxy->name, "proxy counted no samples although it is visible");
+		}
+		if (!proxy->visible && samples != 0) {
+			fail(proxy->name, "proxy counted samples although it is hidden");
+		}
+	}
+	lglDestroyQuery(context, query);
+	printf("%u bounding box proxies through a perspective transform\n", num_proxies);
+}
+
+int main(void) {
+	LGLuint* framebuffer = calloc(TEST_SIZE * TEST_SIZE, sizeof(LGLuint));
+	LGLushort* zbuffer = calloc(TEST_SIZE * TEST_SIZE, sizeof(LGLushort));
+	LGLFramebufferinfo fbinfo;
+	LGLcontext* context;
+
+	memset(&fbinfo, 0, sizeof(fbinfo));
+	fbinfo.framebuffer = framebuffer;
+	fbinfo.zbuffer = zbuffer;
+	fbinfo.width = TEST_SIZE;
+	fbinfo.height = TEST_SIZE;
+	fbinfo.rshift = 16;
+	fbinfo.gshift = 8;
+	fbinfo.bshift = 0;
+	context = framebuffer != NULL && zbuffer != NULL ? lglCreateContext(&fbinfo) : NULL;
+	if (context == NULL) {
+		printf("out of memory\n");
+		return EXIT_FAILURE;
+	}
+	lgluMatrixSetFrustum(&projection, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f);
+	lglSetVertexShader(context, vsProject);
+	lglSetFragmentShader(context, fsWhite);
+	testBounds(context);
+	testProxies(context);
+
+	printf("%s\n", failed ? "FAILED" : "ok");
+	lglDestroyContext(context);
+	free(framebuffer);
+	free(zbuffer);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
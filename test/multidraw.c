@@ -0,0 +1,111 @@
+/*
+ *
+ * LightGL - Multi Draw Test
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ * Draws two records covering the framebuffer with the depth test disabled, the one submitted later must win
+ * whatever order the addresses of their shaders have. Runs without and with a job system.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/LGL/lgl.h"
+#include "../src/LGL/lgljob.h"
+
+#define TEST_SIZE 32
+
+static LGLv3f vertices[4] = { { -1.0f, -1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f },
+		{ -1.0f, 1.0f, 0.0f } };
+static LGLuint indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+static void vsPass(LGLvsout* out, const LGLvsin* in) {
+	out->position = in->vertex_stream[in->index];
+}
+
+static void fsRed(LGLfsout* out, const LGLfsin* in) {
+	(void) in;
+	out->color.r = 1.0f;
+	out->color.g = 0.0f;
+	out->color.b = 0.0f;
+}
+
+static void fsGreen(LGLfsout* out, const LGLfsin* in) {
+	(void) in;
+	out->color.r = 0.0f;
+	out->color.g = 1.0f;
+	out->color.b = 0.0f;
+}
+
+static int testOrder(LGLjobsystem* jobs) {
+	LGLuint* framebuffer = calloc(TEST_SIZE * TEST_SIZE, sizeof(LGLuint));
+	LGLushort* zbuffer = calloc(TEST_SIZE * TEST_SIZE, sizeof(LGLushort));
+	LGLfragmentshader shaders[2] = { fsRed, fsGreen };
+	LGLFramebufferinfo fbinfo;
+	LGLdrawrecord records[2];
+	LGLcontext* context;
+	LGLuint expected;
+	int i, wrong = 0;
+
+	/* the record with the smaller shader address last, sorting by address would move it first */
+	if ((size_t) shaders[0] < (size_t) shaders[1]) {
+		shaders[0] = fsGreen;
+		shaders[1] = fsRed;
+	}
+	memset(&fbinfo, 0, sizeof(fbinfo));
+	fbinfo.framebuffer = framebuffer;
+	fbinfo.zbuffer = zbuffer;
+	fbinfo.width = TEST_SIZE;
+	fbinfo.height = TEST_SIZE;
+	fbinfo.rshift = 16;
+	fbinfo.gshift = 8;
+	fbinfo.bshift = 0;
+	context = framebuffer != NULL && zbuffer != NULL ? lglCreateContext(&fbinfo) : NULL;
+	if (context == NULL) {
+		printf("out of memory\n");
+		free(framebuffer);
+		free(zbuffer);
+		return 0;
+	}
+	lglSetJobSystem(context, jobs);
+	lglDisable(context, LGL_STATE_DEPTH_TEST);
+
+	memset(records, 0, sizeof(records));
+	for (i = 0; i < 2; i++) {
+		records[i].type = LGL_DRAW_TYPE_TRIANGLE_LIST;
+		records[i].vertex_shader = vsPass;
+		records[i].fragment_shader = shaders[i];
+		records[i].vertex_stream = vertices;
+		records[i].vertex_stream_elements = 4;
+		records[i].index_stream = indices;
+		records[i].index_type = LGL_INDEX_TYPE_UINT;
+		records[i].index_count = 6;
+	}
+	lglMultiDrawIndexed(context, records, 2);
+	lglFinish(context);
+
+	expected = shaders[1] == fsRed ? 0xff0000 : 0x00ff00;
+	for (i = 0; i < TEST_SIZE * TEST_SIZE; i++) {
+		wrong += (framebuffer[i] & 0xffffff) != expected;
+	}
+	printf("%s job system: %d of %d pixels not of the record submitted last: %s\n", jobs != NULL ? "with" : "without",
+			wrong, TEST_SIZE * TEST_SIZE, wrong ? "FAILED" : "ok");
+	lglDestroyContext(context);
+	free(framebuffer);
+	free(zbuffer);
+	return wrong == 0;
+}
+
+int main(void) {
+	LGLjobsystem* jobs = lglCreateJobSystem(2, LGL_JOB_AFFINITY_NONE, 0);
+	int ok = testOrder(NULL);
+
+	if (jobs == NULL) {
+		printf("could not create job system\n");
+		return EXIT_FAILURE;
+	}
+	ok = testOrder(jobs) && ok;
+	lglDestroyJobSystem(jobs);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
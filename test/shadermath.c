@@ -0,0 +1,227 @@
+/*
+ *
+ * LightGL - Shader Math Test
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ * Sweeps the ranges documented in lglu.h and fails when a shader math function exceeds its error bound. Built
+ * once per mode, it checks the bounds of the mode lglu.c is compiled with: precise, fast with SSE and fast
+ * without SIMD. Results are compared with the double precision functions of the C library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "../src/LGL/lglu.h"
+
+#if defined(__SSE2__) && !defined(LGLU_NO_SIMD)
+#define TEST_SSE 1
+#endif
+
+/* 0.5 ulp relative, the precise mode rounds once */
+#define TEST_ROUNDED (1.0 / 16777216.0)
+
+typedef struct Result_s {
+	const char* name;
+	double worst; /* error divided by bound */
+	double error, x, y;
+	unsigned long samples;
+} Result;
+
+static int failed;
+
+static void resultInit(Result* r, const char* name) {
+	memset(r, 0, sizeof(Result));
+	r->name = name;
+}
+
+static void resultAdd(Result* r, double error, double bound, double x, double y) {
+	const double ratio = error / bound;
+	r->samples++;
+	if (ratio > r->worst || ratio != ratio) {
+		r->worst = ratio != ratio ? INFINITY : ratio;
+		r->error = error;
+		r->x = x;
+		r->y = y;
+	}
+}
+
+static void resultReport(const Result* r) {
+	const int ok = r->worst <= 1.0;
+	printf("%-22s %10lu samples, worst %.3g of the bound, error %.3g at x = %.9g, y = %.9g: %s\n", r->name,
+			r->samples, r->worst, r->error, r->x, r->y, ok ? "ok" : "FAILED");
+	if (!ok) {
+		failed = 1;
+	}
+}
+
+static float fromBits(unsigned int i) {
+	float f;
+	memcpy(&f, &i, sizeof(f));
+	return f;
+}
+
+static unsigned int toBits(float f) {
+	unsigned int i;
+	memcpy(&i, &f, sizeof(i));
+	return i;
+}
+
+static double relative(double value, double reference) {
+	return fabs(value - reference) / fabs(reference);
+}
+
+/* x >= FLT_MIN, every 61st float */
+static void testRsqrt(void) {
+#if !LGLU_FAST_MATH
+	const double bound = TEST_ROUNDED;
+#elif TEST_SSE
+	const double bound = 3e-7;
+#else
+	const double bound = 1.8e-3;
+#endif
+	unsigned int i;
+	Result r;
+
+	resultInit(&r, "lgluShaderRsqrt");
+	for (i = toBits(FLT_MIN); i < toBits(FLT_MAX); i += 61) {
+		const float x = fromBits(i);
+		resultAdd(&r, relative(lgluShaderRsqrt(x), 1.0 / sqrt((double) x)), bound, x, 0.0);
+	}
+	resultReport(&r);
+}
+
+/* random directions of length 1e-18 to 1e18 */
+static void testNormalize(void) {
+#if !LGLU_FAST_MATH || TEST_SSE
+	const double bound = 3e-7;
+#else
+	const double bound = 1.8e-3;
+#endif
+	unsigned int i;
+	Result r;
+
+	srand(1);
+	resultInit(&r, "lgluShaderNormalize");
+	for (i = 0; i < 4000000; i++) {
+		const double scale = pow(10.0, (double) (i % 37) - 18.0);
+		LGLv3f v;
+		double length;
+
+		v.x = (float) ((rand() / (double) RAND_MAX * 2.0 - 1.0) * scale);
+		v.y = (float) ((rand() / (double) RAND_MAX * 2.0 - 1.0) * scale);
+		v.z = (float) ((rand() / (double) RAND_MAX * 2.0 - 1.0) * scale);
+		length = sqrt((double) v.x * v.x + (double) v.y * v.y + (double) v.z * v.z);
+		if (length < 1e-18 || length > 1e18) {
+			continue;
+		}
+		lgluShaderNormalize(&v);
+		length = sqrt((double) v.x * v.x + (double) v.y * v.y + (double) v.z * v.z);
+		resultAdd(&r, fabs(length - 1.0), bound, scale, 0.0);
+	}
+	resultReport(&r);
+}
+
+/* x in [-87, 88], every 61st float */
+static void testExp(void) {
+	unsigned int i;
+	Result r;
+
+	resultInit(&r, "lgluShaderExp");
+	for (i = 0; i <= toBits(88.0f); i += 61) {
+		const float x = fromBits(i);
+#if LGLU_FAST_MATH
+		const double bound = 2e-7;
+#else
+		const double bound = TEST_ROUNDED;
+#endif
+		resultAdd(&r, relative(lgluShaderExp(x), exp((double) x)), bound, x, 0.0);
+		if (x <= 87.0f) {
+			resultAdd(&r, relative(lgluShaderExp(-x), exp((double) -x)), bound, -x, 0.0);
+		}
+	}
+	resultReport(&r);
+}
+
+/* x >= FLT_MIN, every 4093rd float, with results in the normal float range */
+static void testPow(void) {
+	static const float ys[] = { -100.0f, -7.3f, -2.0f, -1.0f, -0.5f, -0.01f, 0.0f, 0.001f, 0.25f, 0.5f, 1.0f, 1.5f,
+			2.0f, 3.0f, 8.0f, 17.7f, 64.0f, 1000.0f };
+	unsigned int i, k;
+	Result r;
+
+	resultInit(&r, "lgluShaderPow");
+	for (i = toBits(FLT_MIN); i < toBits(FLT_MAX); i += 4093) {
+		const float x = fromBits(i);
+		for (k = 0; k < sizeof(ys) / sizeof(ys[0]); k++) {
+			const double reference = pow((double) x, (double) ys[k]);
+#if LGLU_FAST_MATH
+			const double bound = 2e-7 * (1.0 + fabs(ys[k] * log2((double) x)));
+#else
+			const double bound = TEST_ROUNDED;
+#endif
+			if (reference < FLT_MIN || reference > FLT_MAX) {
+				continue;
+			}
+			resultAdd(&r, relative(lgluShaderPow(x, ys[k]), reference), bound, x, ys[k]);
+		}
+	}
+	/* x <= 0 returns 0 in both modes */
+	resultAdd(&r, lgluShaderPow(0.0f, 2.0f) != 0.0f, 1.0, 0.0, 2.0);
+	resultAdd(&r, lgluShaderPow(-1.0f, 2.0f) != 0.0f, 1.0, -1.0, 2.0);
+	resultAdd(&r, lgluShaderPow(-INFINITY, 2.0f) != 0.0f, 1.0, -INFINITY, 2.0);
+	resultAdd(&r, lgluShaderPow(NAN, 2.0f) != 0.0f, 1.0, NAN, 2.0);
+	resultReport(&r);
+}
+
+/*
+ * x in [-1, 2], every 7th float, and NaN. The float product x * 255 is rounded, off by more than half a step or a
+ * tie rounded the wrong way fails.
+ */
+static void testUnorm8(void) {
+	unsigned int i;
+	Result r;
+
+	resultInit(&r, "lgluShaderUnorm8");
+	for (i = 0; i <= toBits(2.0f); i += 7) {
+		const float xs[2] = { fromBits(i), -fromBits(i) };
+		int s;
+		for (s = 0; s < 2; s++) {
+			const float x = xs[s];
+			const float c = x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+			const volatile float exact = c * 255.0f; /* rounded to float, not kept in a wider register */
+			const LGLuint value = lgluShaderUnorm8(x);
+			double error = fabs(value - exact);
+			if (error == 0.5) {
+#if LGLU_FAST_MATH
+				error = (value & 1) ? 1.0 : 0.0;
+#else
+				error = value > exact ? 0.0 : 1.0;
+#endif
+			} else {
+				error = error < 0.5 ? 0.0 : 1.0;
+			}
+			resultAdd(&r, error, 0.5, x, 0.0);
+		}
+	}
+	resultAdd(&r, lgluShaderUnorm8(NAN) != 0, 0.5, NAN, 0.0);
+	resultReport(&r);
+}
+
+int main(void) {
+#if LGLU_FAST_MATH && TEST_SSE
+	printf("fast mode, SSE\n");
+#elif LGLU_FAST_MATH
+	printf("fast mode, no SIMD\n");
+#else
+	printf("precise mode\n");
+#endif
+	testRsqrt();
+	testNormalize();
+	testExp();
+	testPow();
+	testUnorm8();
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
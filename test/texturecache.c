@@ -0,0 +1,121 @@
+/*
+ *
+ * LightGL - Texture Cache Test
+ * A small and simple software rasterization library with vertex and fragment shader support.
+ * Copyright(c) 2010 by Christoph Schunk. All rights reserved.
+ *
+ * Thrashes a texture cache whose budget holds a few of its textures and fails when the resident levels exceed
+ * the budget, when a reload from the source does not fit beside them, or when a level finer than needed is bound.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/LGL/lgl.h"
+#include "../src/LGL/lglu.h"
+
+#define TEST_BUDGET (64 * 1024)
+#define TEST_FRAMES 2000
+#define TEST_BINDS 2 /* per frame */
+
+typedef struct Texture_s {
+	LGLuint width, height;
+	LGLuint loads;
+} Texture;
+
+static Texture textures[] = { { 32, 32, 0 }, { 64, 64, 0 }, { 64, 64, 0 }, { 128, 64, 0 }, { 16, 128, 0 },
+		{ 100, 60, 0 }, { 33, 17, 0 }, { 64, 64, 0 }, { 256, 256, 0 } };
+
+static LGLUtexturecache* cache;
+static LGLuint frame;
+static LGLuint first_bind; /* nothing is bound in the frame yet */
+static int failed;
+
+static void fail(const char* message, LGLuint texture) {
+	printf("frame %u, texture %u: %s\n", frame, texture, message);
+	failed = 1;
+}
+
+static LGLint load(void* user, LGLtexel* data, LGLuint width, LGLuint height) {
+	Texture* texture = user;
+	LGLuint i;
+
+	if (width != texture->width || height != texture->height) {
+		fail("loader asked for the wrong size", (LGLuint) (texture - textures));
+		return 0;
+	}
+	/* the full resolution source must fit beside the resident levels when it fits the budget at all */
+	if (first_bind && sizeof(LGLtexel) * width * height <= TEST_BUDGET
+			&& lgluTextureCacheResident(cache) + sizeof(LGLtexel) * width * height > TEST_BUDGET) {
+		fail("reloaded source exceeds the budget", (LGLuint) (texture - textures));
+	}
+	for (i = 0; i < width * height; i++) {
+		data[i] = 0xff000000 | i;
+	}
+	texture->loads++;
+	return 1;
+}
+
+int main(void) {
+	const LGLuint num_textures = sizeof(textures) / sizeof(textures[0]);
+	LGLFramebufferinfo fbinfo;
+	LGLcontext* context;
+	LGLuint i, loads = 0;
+
+	memset(&fbinfo, 0, sizeof(fbinfo));
+	fbinfo.width = 16;
+	fbinfo.height = 16;
+	context = lglCreateBufferedContext(&fbinfo, 2);
+	cache = context != NULL ? lgluCreateTextureCache(context, TEST_BUDGET) : NULL;
+	if (cache == NULL) {
+		printf("out of memory\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < num_textures; i++) {
+		if (lgluAddTexture(cache, textures[i].width, textures[i].height, load, &textures[i]) != (LGLint) i) {
+			printf("lgluAddTexture failed\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	srand(1);
+	for (frame = 0; frame < TEST_FRAMES && !failed; frame++) {
+		LGLsize slack = 0;
+		first_bind = 1;
+		for (i = 0; i < TEST_BINDS; i++) {
+			const LGLuint t = (LGLuint) rand() % num_textures;
+			const LGLfloat size = (LGLfloat) (rand() % 300);
+			LGLint level = lgluBindTexture(cache, t, i, size);
+			LGLuint w, h;
+
+			first_bind = 0;
+			if (level < 0) {
+				fail("lgluBindTexture failed", t);
+				break;
+			}
+			/* the next coarser level must not cover size anymore */
+			w = textures[t].width >> (level + 1);
+			h = textures[t].height >> (level + 1);
+			if ((w > 0 || h > 0) && (LGLfloat) (w > 0 ? w : 1) >= size && (LGLfloat) (h > 0 ? h : 1) >= size) {
+				fail("a level finer than needed", t);
+			}
+			if (w == 0 && h == 0) {
+				slack += sizeof(LGLtexel); /* the coarsest level is loaded even when nothing can be evicted */
+			}
+			if (lgluTextureCacheResident(cache) > TEST_BUDGET + slack) {
+				fail("resident levels exceed the budget", t);
+			}
+		}
+		lgluTextureCacheFence(cache, lglSwapBuffers(context));
+	}
+
+	for (i = 0; i < num_textures; i++) {
+		loads += textures[i].loads;
+	}
+	printf("%u frames, %u binds, %u loads from the source, %lu bytes resident of %u: %s\n", frame,
+			frame * TEST_BINDS, loads, (unsigned long) lgluTextureCacheResident(cache), TEST_BUDGET,
+			failed ? "FAILED" : "ok");
+	lgluDestroyTextureCache(cache);
+	lglDestroyContext(context);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}